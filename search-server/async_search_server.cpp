@@ -0,0 +1,113 @@
+#include "async_search_server.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "process_queries.h"
+
+AsyncSearchServer::AsyncSearchServer(const SearchServer& search_server, AsyncSearchOptions options)
+    : search_server_(search_server),
+    options_(CheckOptions(options)),
+    dispatcher_([this] { RunDispatcher(); })
+{}
+
+AsyncSearchServer::~AsyncSearchServer() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    has_requests_.notify_one();
+    has_space_.notify_all();
+    dispatcher_.join();
+}
+
+std::future<std::vector<Document>> AsyncSearchServer::FindTopDocumentsAsync(std::string raw_query) {
+    auto promise = std::make_shared<std::promise<std::vector<Document>>>();
+    auto future = promise->get_future();
+    Submit(std::move(raw_query), [promise](std::vector<Document> result, std::exception_ptr error) {
+        if (error) {
+            promise->set_exception(error);
+        } else {
+            promise->set_value(std::move(result));
+        }
+    });
+    return future;
+}
+
+std::vector<size_t> AsyncSearchServer::GetBatchSizes() const {
+    std::lock_guard lock(mutex_);
+    return batch_sizes_;
+}
+
+#ifdef SEARCH_SERVER_COROUTINES
+AsyncSearchServer::FindTopDocumentsAwaitable AsyncSearchServer::FindTopDocumentsCo(std::string raw_query) {
+    return FindTopDocumentsAwaitable(*this, std::move(raw_query));
+}
+#endif
+
+AsyncSearchOptions AsyncSearchServer::CheckOptions(AsyncSearchOptions options) {
+    if (options.max_queue_depth == 0 || options.max_batch_size == 0)
+        throw std::invalid_argument("AsyncSearchServer: queue depth and batch size must be positive");
+    return options;
+}
+
+void AsyncSearchServer::Submit(std::string raw_query, Completion completion) {
+    {
+        std::unique_lock lock(mutex_);
+        if (queue_.size() >= options_.max_queue_depth) {
+            if (options_.overflow == OverflowPolicy::REJECT) {
+                throw QueueOverflowError("AsyncSearchServer: queue is full");
+            }
+            has_space_.wait(lock, [this] { return queue_.size() < options_.max_queue_depth || stopping_; });
+        }
+        if (stopping_) {
+            throw std::logic_error("AsyncSearchServer: server is stopping");
+        }
+        queue_.push_back({std::move(raw_query), std::move(completion)});
+    }
+    has_requests_.notify_one();
+}
+
+void AsyncSearchServer::RunDispatcher() {
+    std::vector<Request> batch;
+    while (true) {
+        {
+            std::unique_lock lock(mutex_);
+            has_requests_.wait(lock, [this] { return !queue_.empty() || stopping_; });
+            if (queue_.empty()) {
+                return;
+            }
+            // Первый запрос пришёл - даём пакету немного набраться
+            if (queue_.size() < options_.max_batch_size && !stopping_) {
+                has_requests_.wait_for(lock, options_.batch_window, [this] {
+                    return queue_.size() >= options_.max_batch_size || stopping_;
+                });
+            }
+
+            const size_t batch_size = std::min(queue_.size(), options_.max_batch_size);
+            for (size_t i = 0; i < batch_size; ++i) {
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+            batch_sizes_.push_back(batch_size);
+        }
+        has_space_.notify_all();
+
+        ExecuteBatch(batch);
+        batch.clear();
+    }
+}
+
+void AsyncSearchServer::ExecuteBatch(std::vector<Request>& batch) const {
+    std::vector<std::string> queries;
+    queries.reserve(batch.size());
+    for (const Request& request : batch) {
+        queries.push_back(request.raw_query);
+    }
+
+    std::vector<std::exception_ptr> errors;
+    std::vector<std::vector<Document>> results = ProcessQueries(search_server_, queries, errors);
+    for (size_t i = 0; i < batch.size(); ++i) {
+        batch[i].completion(std::move(results[i]), errors[i]);
+    }
+}
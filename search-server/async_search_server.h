@@ -0,0 +1,130 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef SEARCH_SERVER_COROUTINES
+#include <coroutine>
+#endif
+
+#include "document.h"
+#include "search_server.h"
+
+// Что делать с запросом, если очередь заполнена
+enum class OverflowPolicy {
+    BLOCK,  // ждать, пока освободится место
+    REJECT, // бросить QueueOverflowError
+};
+
+struct AsyncSearchOptions {
+    // Сколько запросов может ждать в очереди
+    size_t max_queue_depth = 1024;
+    size_t max_batch_size = 64;
+    // Сколько ждать, пока пакет наберётся, после прихода первого запроса
+    std::chrono::microseconds batch_window{200};
+    OverflowPolicy overflow = OverflowPolicy::BLOCK;
+};
+
+class QueueOverflowError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Асинхронный фронтенд SearchServer: запросы копятся в ограниченной очереди,
+// поток-диспетчер собирает из них пакеты и выполняет через ProcessQueries.
+// Сервер должен пережить этот объект и не меняться, пока тот работает.
+// Деструктор дожидается выполнения всех принятых запросов.
+class AsyncSearchServer {
+public:
+    explicit AsyncSearchServer(const SearchServer& search_server, AsyncSearchOptions options = {});
+
+    AsyncSearchServer(const AsyncSearchServer&) = delete;
+    AsyncSearchServer& operator=(const AsyncSearchServer&) = delete;
+
+    ~AsyncSearchServer();
+
+    // Результат совпадает с search_server.FindTopDocuments(raw_query)
+    std::future<std::vector<Document>> FindTopDocumentsAsync(std::string raw_query);
+
+    // Размер каждого выполненного пакета, для статистики
+    std::vector<size_t> GetBatchSizes() const;
+
+#ifdef SEARCH_SERVER_COROUTINES
+    class FindTopDocumentsAwaitable;
+
+    // co_await server.FindTopDocumentsCo(query): корутина продолжится
+    // в потоке-диспетчере после выполнения пакета
+    FindTopDocumentsAwaitable FindTopDocumentsCo(std::string raw_query);
+#endif
+
+private:
+    using Completion = std::function<void(std::vector<Document>, std::exception_ptr)>;
+
+    struct Request {
+        std::string raw_query;
+        Completion completion;
+    };
+
+    const SearchServer& search_server_;
+    const AsyncSearchOptions options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable has_requests_;
+    std::condition_variable has_space_;
+    std::deque<Request> queue_;
+    std::vector<size_t> batch_sizes_;
+    bool stopping_ = false;
+    // Объявлен последним: поток стартует, когда остальные поля уже созданы
+    std::thread dispatcher_;
+
+    static AsyncSearchOptions CheckOptions(AsyncSearchOptions options);
+
+    void Submit(std::string raw_query, Completion completion);
+
+    void RunDispatcher();
+
+    void ExecuteBatch(std::vector<Request>& batch) const;
+};
+
+#ifdef SEARCH_SERVER_COROUTINES
+class AsyncSearchServer::FindTopDocumentsAwaitable {
+public:
+    FindTopDocumentsAwaitable(AsyncSearchServer& server, std::string raw_query)
+        : server_(server), raw_query_(std::move(raw_query))
+    {}
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        server_.Submit(std::move(raw_query_), [this, handle](std::vector<Document> result, std::exception_ptr error) {
+            result_ = std::move(result);
+            error_ = error;
+            handle.resume();
+        });
+    }
+
+    std::vector<Document> await_resume() {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+        return std::move(result_);
+    }
+
+private:
+    AsyncSearchServer& server_;
+    std::string raw_query_;
+    std::vector<Document> result_;
+    std::exception_ptr error_;
+};
+#endif
@@ -0,0 +1,115 @@
+#include "attribute_index.h"
+
+#include <algorithm>
+
+AttributeIndex::AttributeIndex(MemoryCounter& counter)
+    : ids_(Column<int>::allocator_type(counter)),
+      ratings_(Column<int>::allocator_type(counter)),
+      status_bits_(Column<uint8_t>::allocator_type(counter)),
+      blocks_(Column<BlockSummary>::allocator_type(counter)),
+      id_to_ordinal_(OrdinalMap::allocator_type(counter))
+{}
+
+void AttributeIndex::Add(int document_id, DocumentStatus status, int rating) {
+    const size_t ordinal = ids_.size();
+    if (ordinal % BLOCK_SIZE == 0) {
+        blocks_.emplace_back();
+    }
+    ids_.push_back(document_id);
+    ratings_.push_back(rating);
+    status_bits_.push_back(static_cast<uint8_t>(1u << static_cast<int>(status)));
+    id_to_ordinal_[document_id] = ordinal;
+
+    BlockSummary& block = blocks_.back();
+    block.min_rating = std::min(block.min_rating, rating);
+    block.max_rating = std::max(block.max_rating, rating);
+    block.status_mask |= status_bits_.back();
+}
+
+void AttributeIndex::Remove(int document_id) {
+    const auto it = id_to_ordinal_.find(document_id);
+    if (it == id_to_ordinal_.end()) {
+        return;
+    }
+    status_bits_[it->second] = 0;
+    id_to_ordinal_.erase(it);
+    if (++removed_count_ * 2 > ids_.size()) {
+        Compact();
+    }
+}
+
+void AttributeIndex::Compact() {
+    Column<int> ids = std::move(ids_);
+    Column<int> ratings = std::move(ratings_);
+    Column<uint8_t> status_bits = std::move(status_bits_);
+    ids_.clear();
+    ratings_.clear();
+    status_bits_.clear();
+    blocks_.clear();
+    id_to_ordinal_.clear();
+    removed_count_ = 0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (status_bits[i] != 0) {
+            const int status = __builtin_ctz(status_bits[i]);
+            Add(ids[i], static_cast<DocumentStatus>(status), ratings[i]);
+        }
+    }
+}
+
+DocumentBitset AttributeIndex::Select(const AttributeFilter& filter) const {
+    DocumentBitset documents;
+    const uint8_t status_mask = static_cast<uint8_t>(filter.status_mask);
+    uint8_t matches[BLOCK_SIZE];
+
+    for (size_t block_index = 0; block_index < blocks_.size(); ++block_index) {
+        const BlockSummary& block = blocks_[block_index];
+        if (block.max_rating < filter.min_rating || filter.max_rating < block.min_rating
+            || (block.status_mask & status_mask) == 0) {
+            continue;
+        }
+
+        const size_t begin = block_index * BLOCK_SIZE;
+        const size_t size = std::min(BLOCK_SIZE, ids_.size() - begin);
+        const int* ratings = ratings_.data() + begin;
+        const uint8_t* status_bits = status_bits_.data() + begin;
+        const bool ratings_inside = filter.min_rating <= block.min_rating && block.max_rating <= filter.max_rating;
+        const bool statuses_inside = (block.status_mask & ~status_mask) == 0;
+
+        if (ratings_inside && statuses_inside) {
+            // Сравнивать нечего, отсеиваются только удалённые документы
+            for (size_t i = 0; i < size; ++i) {
+                if (status_bits[i] != 0) {
+                    documents.Set(ids_[begin + i]);
+                }
+            }
+            continue;
+        }
+
+        // Цикл без ветвлений, компилятор разворачивает его в векторные сравнения
+        for (size_t i = 0; i < size; ++i) {
+            matches[i] = static_cast<uint8_t>((filter.min_rating <= ratings[i])
+                                              & (ratings[i] <= filter.max_rating)
+                                              & ((status_bits[i] & status_mask) != 0));
+        }
+        for (size_t i = 0; i < size; ++i) {
+            if (matches[i]) {
+                documents.Set(ids_[begin + i]);
+            }
+        }
+    }
+    return documents;
+}
+
+bool AttributeIndex::Matches(const AttributeFilter& filter, int document_id) const {
+    const auto it = id_to_ordinal_.find(document_id);
+    if (it == id_to_ordinal_.end()) {
+        return false;
+    }
+    const int rating = ratings_[it->second];
+    return filter.min_rating <= rating && rating <= filter.max_rating
+           && (status_bits_[it->second] & filter.status_mask) != 0;
+}
+
+size_t AttributeIndex::GetBlockCount() const {
+    return blocks_.size();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+#include "document_bitset.h"
+#include "memory_stats.h"
+
+// Декларативный фильтр: рейтинг в [min_rating, max_rating] и статус из множества.
+// FindTopDocuments распознаёт его по типу и выбирает подходящие документы из
+// колоночного индекса атрибутов до обхода постингов.
+struct AttributeFilter {
+    static constexpr uint32_t ALL_STATUSES = (1u << DOCUMENT_STATUS_COUNT) - 1;
+
+    int min_rating = std::numeric_limits<int>::min();
+    int max_rating = std::numeric_limits<int>::max();
+    // Бит 1 << static_cast<int>(status) для каждого допустимого статуса
+    uint32_t status_mask = ALL_STATUSES;
+
+    AttributeFilter& RatingBetween(int min, int max) {
+        min_rating = min;
+        max_rating = max;
+        return *this;
+    }
+
+    AttributeFilter& StatusIn(std::initializer_list<DocumentStatus> statuses) {
+        status_mask = 0;
+        for (const DocumentStatus status : statuses) {
+            status_mask |= 1u << static_cast<int>(status);
+        }
+        return *this;
+    }
+
+    bool operator()(int document_id, DocumentStatus status, int rating) const {
+        return min_rating <= rating && rating <= max_rating
+               && (status_mask >> static_cast<int>(status) & 1) != 0;
+    }
+};
+
+// Рейтинг и статус документов в отдельных непрерывных массивах по порядковому
+// номеру добавления. Для каждого блока из BLOCK_SIZE документов хранятся
+// минимальный и максимальный рейтинг и объединение статусов: блок целиком вне
+// фильтра пропускается, целиком внутри - берётся без сравнений.
+class AttributeIndex {
+public:
+    static constexpr size_t BLOCK_SIZE = 1024;
+
+    // Колонки, сводки и отображение id в номер учитываются в counter
+    explicit AttributeIndex(MemoryCounter& counter);
+
+    void Add(int document_id, DocumentStatus status, int rating);
+
+    void Remove(int document_id);
+
+    DocumentBitset Select(const AttributeFilter& filter) const;
+
+    // Проверка одного документа по колонкам, без обхода блоков
+    bool Matches(const AttributeFilter& filter, int document_id) const;
+
+    size_t GetBlockCount() const;
+
+private:
+    struct BlockSummary {
+        int min_rating = std::numeric_limits<int>::max();
+        int max_rating = std::numeric_limits<int>::min();
+        uint32_t status_mask = 0;
+    };
+
+    template <typename T>
+    using Column = std::vector<T, CountingAllocator<T>>;
+    using OrdinalMap = std::unordered_map<int, size_t, std::hash<int>, std::equal_to<int>,
+                                          CountingAllocator<std::pair<const int, size_t>>>;
+
+    Column<int> ids_;
+    Column<int> ratings_;
+    // Статус в виде бита 1 << status; 0 - документ удалён
+    Column<uint8_t> status_bits_;
+    // Сводки не сужаются при удалении, только при уплотнении
+    Column<BlockSummary> blocks_;
+    OrdinalMap id_to_ordinal_;
+    size_t removed_count_ = 0;
+
+    // Выбрасывает удалённые документы, когда их больше половины
+    void Compact();
+};
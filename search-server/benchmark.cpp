@@ -0,0 +1,175 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <ctime>
+#include <iomanip>
+#include <thread>
+
+namespace {
+
+struct RegisteredBenchmark {
+    std::string name;
+    BenchmarkFunction function;
+};
+
+std::vector<RegisteredBenchmark>& GetRegistry() {
+    static std::vector<RegisteredBenchmark> registry;
+    return registry;
+}
+
+std::string EscapeJson(const std::string& text) {
+    std::string result;
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            result.push_back('\\');
+        }
+        result.push_back(c);
+    }
+    return result;
+}
+
+} // namespace
+
+BenchmarkState::BenchmarkState(size_t iterations)
+    : iterations_(iterations)
+{}
+
+BenchmarkState::Iterator BenchmarkState::begin() {
+    return {this, iterations_};
+}
+
+BenchmarkState::Iterator BenchmarkState::end() {
+    return {this, 0};
+}
+
+size_t BenchmarkState::GetIterations() const {
+    return iterations_;
+}
+
+void BenchmarkState::PauseTiming() {
+    pause_start_ = Clock::now();
+}
+
+void BenchmarkState::ResumeTiming() {
+    paused_ += Clock::now() - pause_start_;
+}
+
+void BenchmarkState::SetItemsProcessed(size_t items) {
+    items_processed_ = items;
+}
+
+void BenchmarkState::SetCounter(const std::string& name, double value) {
+    counters_[name] = value;
+}
+
+void BenchmarkState::SkipWithMessage(const std::string& message) {
+    skip_message_ = message;
+}
+
+const HistogramSnapshot& BenchmarkState::GetLatencies() const {
+    return latencies_;
+}
+
+BenchmarkState::Clock::duration BenchmarkState::GetTotalTime() const {
+    return total_time_;
+}
+
+size_t BenchmarkState::GetItemsProcessed() const {
+    return items_processed_;
+}
+
+const std::map<std::string, double>& BenchmarkState::GetCounters() const {
+    return counters_;
+}
+
+const std::string& BenchmarkState::GetSkipMessage() const {
+    return skip_message_;
+}
+
+void BenchmarkState::StartIteration() {
+    paused_ = Clock::duration::zero();
+    iteration_start_ = Clock::now();
+}
+
+void BenchmarkState::FinishIteration() {
+    const auto elapsed = Clock::now() - iteration_start_ - paused_;
+    total_time_ += elapsed;
+    latencies_.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+}
+
+void RegisterBenchmark(std::string name, BenchmarkFunction function) {
+    GetRegistry().push_back({std::move(name), std::move(function)});
+}
+
+void RunBenchmarks(const BenchmarkOptions& options, std::ostream& json_output, std::ostream& log) {
+    using namespace std::literals;
+    using namespace std::chrono;
+
+    const std::time_t now = std::time(nullptr);
+    json_output << "{\n"s;
+    json_output << "  \"context\": {\n"s;
+    json_output << "    \"date\": \""s << std::put_time(std::gmtime(&now), "%Y-%m-%dT%H:%M:%SZ") << "\",\n"s;
+    json_output << "    \"num_cpus\": "s << std::thread::hardware_concurrency() << ",\n"s;
+#ifdef NDEBUG
+    json_output << "    \"library_build_type\": \"release\"\n"s;
+#else
+    json_output << "    \"library_build_type\": \"debug\"\n"s;
+#endif
+    json_output << "  },\n"s;
+    json_output << "  \"benchmarks\": ["s;
+
+    bool first = true;
+    for (const auto& [name, function] : GetRegistry()) {
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+
+        // Подбор числа итераций, как в Google Benchmark: увеличиваем, пока не наберём min_time
+        size_t iterations = 1;
+        while (true) {
+            BenchmarkState state(iterations);
+            function(state);
+            const double seconds = duration<double>(state.GetTotalTime()).count();
+            const bool done = !state.GetSkipMessage().empty()
+                              || seconds >= options.min_time_seconds
+                              || iterations >= options.max_iterations;
+            if (!done) {
+                const double multiplier = seconds <= 0.0 ? 10.0 : std::clamp(1.4 * options.min_time_seconds / seconds, 2.0, 10.0);
+                iterations = std::min(options.max_iterations, static_cast<size_t>(iterations * multiplier));
+                continue;
+            }
+
+            json_output << (first ? "\n"s : ",\n"s);
+            first = false;
+            json_output << "    {\n"s;
+            json_output << "      \"name\": \""s << EscapeJson(name) << "\",\n"s;
+            if (!state.GetSkipMessage().empty()) {
+                json_output << "      \"error_occurred\": true,\n"s;
+                json_output << "      \"error_message\": \""s << EscapeJson(state.GetSkipMessage()) << "\"\n"s;
+                json_output << "    }"s;
+                log << name << ": skipped ("s << state.GetSkipMessage() << ")"s << std::endl;
+                break;
+            }
+
+            const HistogramSnapshot& latencies = state.GetLatencies();
+            const double mean_ns = duration<double, std::nano>(state.GetTotalTime()).count() / iterations;
+            json_output << "      \"iterations\": "s << iterations << ",\n"s;
+            json_output << "      \"real_time\": "s << mean_ns << ",\n"s;
+            json_output << "      \"time_unit\": \"ns\",\n"s;
+            json_output << "      \"p50\": "s << latencies.GetPercentile(0.5) << ",\n"s;
+            json_output << "      \"p99\": "s << latencies.GetPercentile(0.99) << ",\n"s;
+            json_output << "      \"p999\": "s << latencies.GetPercentile(0.999) << ",\n"s;
+            if (state.GetItemsProcessed() > 0) {
+                json_output << "      \"items_per_second\": "s << state.GetItemsProcessed() / seconds << ",\n"s;
+            }
+            for (const auto& [counter, value] : state.GetCounters()) {
+                json_output << "      \""s << EscapeJson(counter) << "\": "s << value << ",\n"s;
+            }
+            json_output << "      \"max\": "s << latencies.GetMax() << "\n"s;
+            json_output << "    }"s;
+            log << name << ": "s << iterations << " iterations, "s << static_cast<uint64_t>(mean_ns) << " ns/iter"s << std::endl;
+            break;
+        }
+    }
+    json_output << "\n  ]\n}"s << std::endl;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "query_trace.h"
+
+// Минимальная обвязка в духе Google Benchmark:
+//
+//     RegisterBenchmark("BM_Find/1000", [](BenchmarkState& state) {
+//         for (auto _ : state) {
+//             ...
+//         }
+//     });
+//
+// Число итераций подбирается так, чтобы замер шёл не меньше min_time,
+// время каждой итерации попадает в гистограмму для перцентилей.
+class BenchmarkState {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    class Iterator {
+    public:
+        Iterator(BenchmarkState* state, size_t remaining)
+            : state_(state), remaining_(remaining)
+        {}
+
+        int operator*() const {
+            return 0;
+        }
+
+        Iterator& operator++() {
+            state_->FinishIteration();
+            --remaining_;
+            return *this;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            if (remaining_ != other.remaining_) {
+                state_->StartIteration();
+                return true;
+            }
+            return false;
+        }
+
+    private:
+        BenchmarkState* state_;
+        size_t remaining_;
+    };
+
+    explicit BenchmarkState(size_t iterations);
+
+    Iterator begin();
+
+    Iterator end();
+
+    size_t GetIterations() const;
+
+    // Исключает из замера подготовку данных внутри итерации
+    void PauseTiming();
+
+    void ResumeTiming();
+
+    void SetItemsProcessed(size_t items);
+
+    void SetCounter(const std::string& name, double value);
+
+    // Пропустить бенчмарк с пояснением, например если он не применим к размеру корпуса
+    void SkipWithMessage(const std::string& message);
+
+    const HistogramSnapshot& GetLatencies() const;
+
+    Clock::duration GetTotalTime() const;
+
+    size_t GetItemsProcessed() const;
+
+    const std::map<std::string, double>& GetCounters() const;
+
+    const std::string& GetSkipMessage() const;
+
+private:
+    size_t iterations_;
+    HistogramSnapshot latencies_;
+    Clock::duration total_time_{};
+    Clock::time_point iteration_start_;
+    Clock::time_point pause_start_;
+    Clock::duration paused_{};
+    size_t items_processed_ = 0;
+    std::map<std::string, double> counters_;
+    std::string skip_message_;
+
+    void StartIteration();
+
+    void FinishIteration();
+};
+
+using BenchmarkFunction = std::function<void(BenchmarkState&)>;
+
+void RegisterBenchmark(std::string name, BenchmarkFunction function);
+
+struct BenchmarkOptions {
+    double min_time_seconds = 0.2;
+    size_t max_iterations = 1'000'000;
+    // Подстрока имени; пустая строка - запускать все
+    std::string filter;
+};
+
+// Запускает все зарегистрированные бенчмарки и печатает отчёт в JSON
+void RunBenchmarks(const BenchmarkOptions& options, std::ostream& json_output, std::ostream& log = std::cerr);
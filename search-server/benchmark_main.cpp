@@ -0,0 +1,895 @@
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include "async_search_server.h"
+#include "benchmark.h"
+#include "concurrent_map.h"
+#include "corpus_loader.h"
+#include "corpus_generator.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "search_server.h"
+
+using namespace std;
+
+namespace {
+
+const size_t QUERY_COUNT = 1000;
+const size_t WORDS_PER_QUERY = 4;
+const double MINUS_WORD_RATIO = 0.1;
+// Длина префикса в запросах вида "wab*"
+const size_t PREFIX_LENGTH = 3;
+// Минус-слова запросов с частыми исключениями выбираются из стольких самых частых слов
+const size_t FREQUENT_MINUS_WORDS = 20;
+
+struct Corpus {
+    string stop_words;
+    vector<GeneratedDocument> documents;
+    vector<string> queries;
+    vector<string> prefix_queries;
+    vector<string> typo_queries;
+    vector<string> frequent_minus_queries;
+    vector<string> required_queries;
+};
+
+// Обрезает каждое слово запроса до префикса со звёздочкой
+vector<string> MakePrefixQueries(const vector<string>& queries) {
+    vector<string> prefix_queries;
+    prefix_queries.reserve(queries.size());
+    for (const string& query : queries) {
+        string prefix_query;
+        for (const string_view word : SplitIntoWords(query)) {
+            if (!prefix_query.empty()) {
+                prefix_query.push_back(' ');
+            }
+            const size_t length = PREFIX_LENGTH + (word[0] == '-' ? 1 : 0);
+            prefix_query += word.substr(0, length);
+            prefix_query.push_back('*');
+        }
+        prefix_queries.push_back(move(prefix_query));
+    }
+    return prefix_queries;
+}
+
+// Заменяет в каждом слове длиннее трёх символов один символ, так что слова из запроса
+// обычно нет в словаре и его ищет исправление опечаток
+vector<string> MakeTypoQueries(const vector<string>& queries) {
+    vector<string> typo_queries = queries;
+    size_t seed = 0;
+    for (string& query : typo_queries) {
+        size_t word_begin = 0;
+        for (size_t i = 0; i <= query.size(); ++i) {
+            if (i < query.size() && query[i] != ' ') {
+                continue;
+            }
+            if (i - word_begin > 3) {
+                char& c = query[i - 1 - seed++ % 2];
+                c = static_cast<char>('a' + (c - 'a' + 13) % 26);
+            }
+            word_begin = i + 1;
+        }
+    }
+    return typo_queries;
+}
+
+// Делает все plus-слова запроса обязательными: "+cat +dog -bird"
+vector<string> MakeRequiredQueries(const vector<string>& queries) {
+    vector<string> required_queries;
+    required_queries.reserve(queries.size());
+    for (const string& query : queries) {
+        string required_query;
+        for (const string_view word : SplitIntoWords(query)) {
+            if (!required_query.empty()) {
+                required_query.push_back(' ');
+            }
+            if (word[0] != '-') {
+                required_query.push_back('+');
+            }
+            required_query += word;
+        }
+        required_queries.push_back(move(required_query));
+    }
+    return required_queries;
+}
+
+// Добавляет к каждому запросу два минус-слова из самых частых слов корпуса:
+// их списки постингов длинные, а битовые карты переиспользуются между запросами
+vector<string> MakeFrequentMinusQueries(const Corpus& corpus) {
+    const vector<string_view> stop_words = SplitIntoWords(string_view(corpus.stop_words));
+    const set<string_view> stop_word_set(stop_words.begin(), stop_words.end());
+    map<string_view, size_t> document_freqs;
+    for (const GeneratedDocument& document : corpus.documents) {
+        const vector<string_view> words = SplitIntoWords(string_view(document.text));
+        for (const string_view word : set<string_view>(words.begin(), words.end())) {
+            if (stop_word_set.count(word) == 0) {
+                ++document_freqs[word];
+            }
+        }
+    }
+    vector<pair<size_t, string_view>> frequent_words;
+    for (const auto [word, freq] : document_freqs) {
+        frequent_words.emplace_back(freq, word);
+    }
+    const size_t count = min(FREQUENT_MINUS_WORDS, frequent_words.size());
+    partial_sort(frequent_words.begin(), frequent_words.begin() + count, frequent_words.end(), greater<>());
+
+    vector<string> queries = corpus.queries;
+    for (size_t i = 0; i < queries.size() && count > 0; ++i) {
+        for (const size_t index : {i % count, (i * 7 + 3) % count}) {
+            queries[i] += " -"s;
+            queries[i] += frequent_words[index].second;
+        }
+    }
+    return queries;
+}
+
+const Corpus& GetCorpus(size_t document_count) {
+    static map<size_t, unique_ptr<Corpus>> corpora;
+    auto& corpus = corpora[document_count];
+    if (!corpus) {
+        CorpusOptions options;
+        options.document_count = document_count;
+        CorpusGenerator generator(options);
+
+        corpus = make_unique<Corpus>();
+        corpus->stop_words = generator.GetStopWordsText();
+        corpus->documents = generator.GenerateDocuments();
+        corpus->queries = generator.GenerateQueries(QUERY_COUNT, WORDS_PER_QUERY, MINUS_WORD_RATIO);
+        corpus->prefix_queries = MakePrefixQueries(corpus->queries);
+        corpus->typo_queries = MakeTypoQueries(corpus->queries);
+        corpus->frequent_minus_queries = MakeFrequentMinusQueries(*corpus);
+        corpus->required_queries = MakeRequiredQueries(corpus->queries);
+    }
+    return *corpus;
+}
+
+unique_ptr<SearchServer> BuildServer(const Corpus& corpus) {
+    auto server = make_unique<SearchServer>(corpus.stop_words);
+    for (const auto& document : corpus.documents) {
+        server->AddDocument(document.id, document.text, document.status, document.ratings);
+    }
+    return server;
+}
+
+// Сервер строится один раз на размер корпуса и не меняется в бенчмарках поиска
+const SearchServer& GetServer(size_t document_count) {
+    static map<size_t, unique_ptr<SearchServer>> servers;
+    auto& server = servers[document_count];
+    if (!server) {
+        server = BuildServer(GetCorpus(document_count));
+    }
+    return *server;
+}
+
+const SearchServer& GetFuzzyServer(size_t document_count) {
+    static map<size_t, unique_ptr<SearchServer>> servers;
+    auto& server = servers[document_count];
+    if (!server) {
+        server = BuildServer(GetCorpus(document_count));
+        server->SetFuzzyOptions({2, 8, 0.5});
+    }
+    return *server;
+}
+
+const SearchServer& GetCompactStorageServer(size_t document_count) {
+    static map<size_t, unique_ptr<SearchServer>> servers;
+    auto& server = servers[document_count];
+    if (!server) {
+        server = BuildServer(GetCorpus(document_count));
+        server->SetPostingStorage(PostingStorage::COMPACT);
+    }
+    return *server;
+}
+
+bool EvenRatingPredicate(int document_id, DocumentStatus status, int rating) {
+    return status == DocumentStatus::ACTUAL && rating % 2 == 0;
+}
+
+// Рейтинги корпуса - средние из [-10, 10]; диапазон отсекает большую часть документов
+const int MIN_FILTER_RATING = 4;
+const int MAX_FILTER_RATING = 10;
+
+bool RatingRangePredicate(int document_id, DocumentStatus status, int rating) {
+    return status == DocumentStatus::ACTUAL && rating >= MIN_FILTER_RATING && rating <= MAX_FILTER_RATING;
+}
+
+AttributeFilter MakeRatingRangeFilter() {
+    return AttributeFilter().RatingBetween(MIN_FILTER_RATING, MAX_FILTER_RATING).StatusIn({DocumentStatus::ACTUAL});
+}
+
+void RegisterAddDocument(size_t size) {
+    RegisterBenchmark("BM_AddDocument/"s + to_string(size), [size](BenchmarkState& state) {
+        const Corpus& corpus = GetCorpus(size);
+        auto server = make_unique<SearchServer>(corpus.stop_words);
+        size_t next = 0;
+        for (auto _ : state) {
+            if (next == corpus.documents.size()) {
+                state.PauseTiming();
+                server = make_unique<SearchServer>(corpus.stop_words);
+                next = 0;
+                state.ResumeTiming();
+            }
+            const auto& document = corpus.documents[next++];
+            server->AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+        state.SetItemsProcessed(state.GetIterations());
+    });
+}
+
+// Записывает корпус в TSV-файл формата LoadCorpus, возвращает путь
+filesystem::path WriteCorpusFile(const Corpus& corpus, size_t size) {
+    const auto path = filesystem::temp_directory_path() / ("search_server_benchmark_corpus_"s + to_string(size) + ".tsv"s);
+    ofstream output(path, ios::binary);
+    for (const GeneratedDocument& document : corpus.documents) {
+        output << document.id << '\t' << GetDocumentStatusName(document.status) << '\t';
+        for (size_t i = 0; i < document.ratings.size(); ++i) {
+            output << (i > 0 ? ","s : ""s) << document.ratings[i];
+        }
+        output << '\t' << document.text << '\n';
+    }
+    return path;
+}
+
+// Построчное чтение через getline и AddDocument против LoadCorpus с mmap
+void RegisterLoadCorpus(size_t size) {
+    RegisterBenchmark("BM_LoadCorpus/getline/"s + to_string(size), [size](BenchmarkState& state) {
+        const Corpus& corpus = GetCorpus(size);
+        const auto path = WriteCorpusFile(corpus, size);
+        for (auto _ : state) {
+            SearchServer server(corpus.stop_words);
+            ifstream input(path, ios::binary);
+            string line;
+            while (getline(input, line)) {
+                const size_t status_begin = line.find('\t') + 1;
+                const size_t ratings_begin = line.find('\t', status_begin) + 1;
+                const size_t text_begin = line.find('\t', ratings_begin) + 1;
+                vector<int> ratings;
+                istringstream ratings_input(line.substr(ratings_begin, text_begin - 1 - ratings_begin));
+                string rating;
+                while (getline(ratings_input, rating, ',')) {
+                    ratings.push_back(stoi(rating));
+                }
+                const auto status = ParseDocumentStatus(string_view(line).substr(status_begin, ratings_begin - 1 - status_begin));
+                server.AddDocument(stoi(line.substr(0, status_begin - 1)), string_view(line).substr(text_begin), status, ratings);
+            }
+        }
+        state.SetItemsProcessed(state.GetIterations() * corpus.documents.size());
+        state.SetCounter("file_bytes"s, static_cast<double>(filesystem::file_size(path)));
+        filesystem::remove(path);
+    });
+    RegisterBenchmark("BM_LoadCorpus/mmap/"s + to_string(size), [size](BenchmarkState& state) {
+        const Corpus& corpus = GetCorpus(size);
+        const auto path = WriteCorpusFile(corpus, size);
+        for (auto _ : state) {
+            SearchServer server(corpus.stop_words);
+            LoadCorpus(server, path.string());
+        }
+        state.SetItemsProcessed(state.GetIterations() * corpus.documents.size());
+        state.SetCounter("file_bytes"s, static_cast<double>(filesystem::file_size(path)));
+        filesystem::remove(path);
+    });
+}
+
+// Прежняя реализация ConcurrentMap - корзины из std::map под std::mutex, для сравнения
+template <typename Key, typename Value>
+class MutexTreeMap {
+public:
+    explicit MutexTreeMap(size_t bucket_count)
+        : buckets_(bucket_count)
+    {}
+
+    void Add(const Key& key, const Value& value) {
+        Bucket& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
+        lock_guard guard(bucket.guard);
+        bucket.values[key] += value;
+    }
+
+    Value Get(const Key& key) {
+        Bucket& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
+        lock_guard guard(bucket.guard);
+        return bucket.values[key];
+    }
+
+private:
+    struct Bucket {
+        mutex guard;
+        map<Key, Value> values;
+    };
+    vector<Bucket> buckets_;
+};
+
+struct StripedMapAdapter {
+    ConcurrentMap<int, long long> map;
+
+    explicit StripedMapAdapter(size_t bucket_count)
+        : map(bucket_count)
+    {}
+
+    void Add(int key, long long value) {
+        map[key].ref_to_value += value;
+    }
+
+    long long Get(int key) {
+        return map.Find(key).value_or(0);
+    }
+};
+
+// Потоки читают и увеличивают счётчики общих ключей: каждая десятая операция - запись
+template <typename Map>
+void RegisterConcurrentMapContention(const string& name, size_t thread_count) {
+    RegisterBenchmark("BM_ConcurrentMapContention/"s + name + "/"s + to_string(thread_count),
+                      [thread_count](BenchmarkState& state) {
+        const int key_count = 10000;
+        const size_t operations_per_thread = 100000;
+        Map map(64);
+        for (int key = 0; key < key_count; ++key) {
+            map.Add(key, 0);
+        }
+        long long checksum = 0;
+        for (auto _ : state) {
+            vector<thread> threads;
+            vector<long long> sums(thread_count);
+            for (size_t t = 0; t < thread_count; ++t) {
+                threads.emplace_back([&map, &sums, t] {
+                    uint64_t state = t + 1;
+                    for (size_t i = 0; i < operations_per_thread; ++i) {
+                        state = state * 6364136223846793005ull + 1442695040888963407ull;
+                        const int key = static_cast<int>((state >> 33) % key_count);
+                        if (i % 10 == 0) {
+                            map.Add(key, 1);
+                        } else {
+                            sums[t] += map.Get(key);
+                        }
+                    }
+                });
+            }
+            for (thread& thread : threads) {
+                thread.join();
+            }
+            for (const long long sum : sums) {
+                checksum += sum;
+            }
+        }
+        state.SetItemsProcessed(state.GetIterations() * thread_count * operations_per_thread);
+        state.SetCounter("checksum"s, static_cast<double>(checksum));
+    });
+}
+
+template <typename Search>
+void RegisterSearch(const string& name, size_t size, Search search,
+                    vector<string> Corpus::*query_set = &Corpus::queries,
+                    const SearchServer& (*get_server)(size_t) = GetServer) {
+    RegisterBenchmark(name + "/"s + to_string(size), [size, search, query_set, get_server](BenchmarkState& state) {
+        const Corpus& corpus = GetCorpus(size);
+        const SearchServer& server = get_server(size);
+        const vector<string>& queries = corpus.*query_set;
+        size_t next = 0;
+        size_t found = 0;
+        for (auto _ : state) {
+            found += search(server, queries[next], corpus.documents[next % corpus.documents.size()].id);
+            next = (next + 1) % queries.size();
+        }
+        state.SetItemsProcessed(state.GetIterations());
+        state.SetCounter("results_per_query"s, static_cast<double>(found) / state.GetIterations());
+    });
+}
+
+// Индекс по вкладам строится по тому же серверу, что и в остальных бенчмарках поиска
+const ImpactIndex& GetImpactIndex(size_t document_count) {
+    static map<size_t, unique_ptr<ImpactIndex>> indexes;
+    auto& index = indexes[document_count];
+    if (!index) {
+        index = make_unique<ImpactIndex>(GetServer(document_count).BuildImpactIndex());
+    }
+    return *index;
+}
+
+// Id точной выдачи FindTopDocuments для каждого запроса лога
+const vector<set<int>>& GetExactResults(size_t document_count) {
+    static map<size_t, vector<set<int>>> results;
+    auto& exact = results[document_count];
+    if (exact.empty()) {
+        const SearchServer& server = GetServer(document_count);
+        for (const string& query : GetCorpus(document_count).queries) {
+            set<int>& ids = exact.emplace_back();
+            for (const Document& document : server.FindTopDocuments(query)) {
+                ids.insert(document.id);
+            }
+        }
+    }
+    return exact;
+}
+
+void RegisterBuildImpactIndex(size_t size) {
+    RegisterBenchmark("BM_BuildImpactIndex/"s + to_string(size), [size](BenchmarkState& state) {
+        const SearchServer& server = GetServer(size);
+        size_t postings = 0;
+        for (auto _ : state) {
+            postings = server.BuildImpactIndex().GetPostingCount();
+        }
+        state.SetItemsProcessed(state.GetIterations());
+        state.SetCounter("postings"s, static_cast<double>(postings));
+    });
+}
+
+// Точность и задержка поиска по вкладам: recall - доля документов точной выдачи,
+// найденных приближённым поиском, truncated - доля запросов, оборванных бюджетом
+void RegisterImpactSearch(const string& name, size_t size, size_t max_postings) {
+    RegisterBenchmark("BM_FindTopDocumentsByImpact/"s + name + "/"s + to_string(size),
+                      [size, max_postings](BenchmarkState& state) {
+        const Corpus& corpus = GetCorpus(size);
+        const SearchServer& server = GetServer(size);
+        const ImpactIndex& index = GetImpactIndex(size);
+        const vector<set<int>>& exact = GetExactResults(size);
+        SearchBudget budget;
+        budget.max_postings = max_postings;
+
+        size_t next = 0;
+        size_t expected = 0;
+        size_t found = 0;
+        size_t truncated = 0;
+        for (auto _ : state) {
+            const SearchResult result = server.FindTopDocumentsByImpact(index, corpus.queries[next], budget);
+            expected += exact[next].size();
+            for (const Document& document : result.documents) {
+                found += exact[next].count(document.id);
+            }
+            truncated += result.truncated ? 1 : 0;
+            next = (next + 1) % corpus.queries.size();
+        }
+        state.SetItemsProcessed(state.GetIterations());
+        state.SetCounter("recall"s, expected > 0 ? static_cast<double>(found) / expected : 1.0);
+        state.SetCounter("truncated"s, static_cast<double>(truncated) / state.GetIterations());
+    });
+}
+
+const CompactIndex& GetCompactIndex(size_t document_count) {
+    static map<size_t, unique_ptr<CompactIndex>> indexes;
+    auto& index = indexes[document_count];
+    if (!index) {
+        index = make_unique<CompactIndex>(GetServer(document_count).BuildCompactIndex());
+    }
+    return *index;
+}
+
+// Компактный поиск с заданным ядром: recall - как у поиска по вкладам,
+// posting_bytes_ratio - память постингов относительно индекса сервера
+void RegisterCompactSearch(const string& name, size_t size, CompactIndex::Kernel kernel) {
+    RegisterBenchmark("BM_FindTopDocumentsCompact/"s + name + "/"s + to_string(size), [size, kernel](BenchmarkState& state) {
+        const Corpus& corpus = GetCorpus(size);
+        const SearchServer& server = GetServer(size);
+        const CompactIndex& index = GetCompactIndex(size);
+        const vector<set<int>>& exact = GetExactResults(size);
+
+        size_t next = 0;
+        size_t expected = 0;
+        size_t found = 0;
+        for (auto _ : state) {
+            const vector<Document> documents = server.FindTopDocumentsCompact(index, corpus.queries[next], kernel);
+            expected += exact[next].size();
+            for (const Document& document : documents) {
+                found += exact[next].count(document.id);
+            }
+            next = (next + 1) % corpus.queries.size();
+        }
+        state.SetItemsProcessed(state.GetIterations());
+        state.SetCounter("recall"s, expected > 0 ? static_cast<double>(found) / expected : 1.0);
+        state.SetCounter("posting_bytes_ratio"s, static_cast<double>(index.GetPostingBytes())
+                                                 / server.GetMemoryStats().posting_bytes);
+    });
+}
+
+template <typename ExecutionPolicy>
+void RegisterRemoveDocument(const string& name, size_t size, ExecutionPolicy policy) {
+    RegisterBenchmark("BM_RemoveDocument/"s + name + "/"s + to_string(size), [size, policy](BenchmarkState& state) {
+        const Corpus& corpus = GetCorpus(size);
+        unique_ptr<SearchServer> server;
+        size_t next = corpus.documents.size();
+        for (auto _ : state) {
+            if (next == corpus.documents.size()) {
+                state.PauseTiming();
+                server = BuildServer(corpus);
+                next = 0;
+                state.ResumeTiming();
+            }
+            server->RemoveDocument(policy, corpus.documents[next++].id);
+        }
+        state.SetItemsProcessed(state.GetIterations());
+    });
+}
+
+void RegisterRemoveDuplicates(size_t size) {
+    RegisterBenchmark("BM_RemoveDuplicates/"s + to_string(size), [size](BenchmarkState& state) {
+        const Corpus& corpus = GetCorpus(size);
+        // Каждый десятый документ повторяет набор слов предыдущего
+        Corpus with_duplicates = corpus;
+        for (size_t i = 1; i < with_duplicates.documents.size(); i += 10) {
+            with_duplicates.documents[i].text = with_duplicates.documents[i - 1].text;
+        }
+
+        ostringstream sink;
+        for (auto _ : state) {
+            state.PauseTiming();
+            auto server = BuildServer(with_duplicates);
+            auto* cout_buffer = cout.rdbuf(sink.rdbuf());
+            state.ResumeTiming();
+
+            RemoveDuplicates(*server);
+
+            state.PauseTiming();
+            cout.rdbuf(cout_buffer);
+            sink.str({});
+            server.reset();
+            state.ResumeTiming();
+        }
+        state.SetItemsProcessed(state.GetIterations() * with_duplicates.documents.size());
+    });
+}
+
+void RegisterProcessQueries(size_t size) {
+    RegisterBenchmark("BM_ProcessQueries/"s + to_string(size), [size](BenchmarkState& state) {
+        const Corpus& corpus = GetCorpus(size);
+        const SearchServer& server = GetServer(size);
+        for (auto _ : state) {
+            const auto results = ProcessQueries(server, corpus.queries);
+        }
+        state.SetItemsProcessed(state.GetIterations() * corpus.queries.size());
+    });
+}
+
+// Сколько постингов читает лог пакетами по batch_size запросов: каждый запрос
+// отдельно и с общим обходом слов пакета. Стоп-слова корпуса в запросы не попадают.
+pair<size_t, size_t> CountPostingReads(const SearchServer& server, const vector<string>& queries, size_t batch_size) {
+    size_t independent = 0;
+    size_t shared = 0;
+    for (size_t begin = 0; begin < queries.size(); begin += batch_size) {
+        set<pair<string_view, bool>> batch_words;
+        for (size_t i = begin; i < min(queries.size(), begin + batch_size); ++i) {
+            set<pair<string_view, bool>> query_words;
+            for (string_view word : SplitIntoWords(queries[i])) {
+                const bool is_minus = word[0] == '-';
+                if (is_minus) {
+                    word.remove_prefix(1);
+                }
+                query_words.emplace(word, is_minus);
+            }
+            for (const auto& [word, is_minus] : query_words) {
+                independent += server.GetDocumentFrequency(word);
+            }
+            batch_words.insert(query_words.begin(), query_words.end());
+        }
+        for (const auto& [word, is_minus] : batch_words) {
+            shared += server.GetDocumentFrequency(word);
+        }
+    }
+    return {independent, shared};
+}
+
+// Пакетное выполнение против FindTopDocuments по одному запросу
+void RegisterFindTopDocumentsBatch(size_t size, size_t batch_size) {
+    const string name = "BM_FindTopDocumentsBatch/"s + to_string(batch_size) + "/"s + to_string(size);
+    RegisterBenchmark(name, [size, batch_size](BenchmarkState& state) {
+        const Corpus& corpus = GetCorpus(size);
+        const SearchServer& server = GetServer(size);
+        vector<vector<string>> batches;
+        for (size_t begin = 0; begin < corpus.queries.size(); begin += batch_size) {
+            const auto end = corpus.queries.begin() + min(corpus.queries.size(), begin + batch_size);
+            batches.emplace_back(corpus.queries.begin() + begin, end);
+        }
+
+        const auto first_batch = server.FindTopDocumentsBatch(batches[0]);
+        for (size_t i = 0; i < batches[0].size(); ++i) {
+            const auto expected = server.FindTopDocuments(batches[0][i]);
+            const bool same = equal(expected.begin(), expected.end(), first_batch[i].begin(), first_batch[i].end(),
+                                    [](const Document& lhs, const Document& rhs) {
+                                        return lhs.id == rhs.id && lhs.relevance == rhs.relevance;
+                                    });
+            if (!same) {
+                state.SkipWithMessage("batch results differ from FindTopDocuments for: "s + batches[0][i]);
+                return;
+            }
+        }
+
+        for (auto _ : state) {
+            for (const auto& batch : batches) {
+                const auto results = server.FindTopDocumentsBatch(batch);
+            }
+        }
+        const auto [independent, shared] = CountPostingReads(server, corpus.queries, batch_size);
+        state.SetItemsProcessed(state.GetIterations() * corpus.queries.size());
+        state.SetCounter("postings_per_query_independent"s, static_cast<double>(independent) / corpus.queries.size());
+        state.SetCounter("postings_per_query_shared"s, static_cast<double>(shared) / corpus.queries.size());
+    });
+}
+
+// Все запросы лога отправляются разом и собираются через future
+void RegisterAsyncFindTopDocuments(size_t size) {
+    RegisterBenchmark("BM_AsyncFindTopDocuments/"s + to_string(size), [size](BenchmarkState& state) {
+        const Corpus& corpus = GetCorpus(size);
+        AsyncSearchServer async_server(GetServer(size));
+        vector<future<vector<Document>>> futures;
+        futures.reserve(corpus.queries.size());
+        for (auto _ : state) {
+            for (const string& query : corpus.queries) {
+                futures.push_back(async_server.FindTopDocumentsAsync(query));
+            }
+            for (auto& result : futures) {
+                result.get();
+            }
+            futures.clear();
+        }
+        const vector<size_t> batch_sizes = async_server.GetBatchSizes();
+        state.SetItemsProcessed(state.GetIterations() * corpus.queries.size());
+        state.SetCounter("mean_batch_size"s,
+                         static_cast<double>(state.GetIterations() * corpus.queries.size()) / batch_sizes.size());
+    });
+}
+
+void RegisterMatchDocuments(size_t size) {
+    RegisterBenchmark("BM_MatchDocuments/par/"s + to_string(size), [size](BenchmarkState& state) {
+        const Corpus& corpus = GetCorpus(size);
+        const SearchServer& server = GetServer(size);
+        vector<int> document_ids;
+        for (size_t i = 0; i < corpus.documents.size() && document_ids.size() < 100; ++i) {
+            document_ids.push_back(corpus.documents[i].id);
+        }
+        size_t next = 0;
+        for (auto _ : state) {
+            const auto results = server.MatchDocuments(execution::par, corpus.queries[next], document_ids);
+            next = (next + 1) % corpus.queries.size();
+        }
+        state.SetItemsProcessed(state.GetIterations() * document_ids.size());
+    });
+}
+
+// Проверка слов документов по стоп-словам: дерево строк против совершенного хеша
+template <typename StopWords>
+void RegisterStopWordLookup(const string& name, size_t size) {
+    RegisterBenchmark("BM_StopWordLookup/"s + name + "/"s + to_string(size), [size](BenchmarkState& state) {
+        const Corpus& corpus = GetCorpus(size);
+        const auto unique_stop_words = MakeUniqueNonEmptyStrings(SplitIntoWords(corpus.stop_words));
+        const StopWords stop_words(unique_stop_words);
+        vector<string_view> words;
+        for (const auto& document : corpus.documents) {
+            ForEachWord(document.text, [&words](string_view word) {
+                words.push_back(word);
+            });
+        }
+
+        size_t found = 0;
+        for (auto _ : state) {
+            for (const string_view word : words) {
+                if constexpr (is_same_v<StopWords, StopWordSet>) {
+                    found += stop_words.Contains(word) ? 1 : 0;
+                } else {
+                    found += stop_words.count(word);
+                }
+            }
+        }
+        const double checked = static_cast<double>(state.GetIterations()) * words.size();
+        state.SetItemsProcessed(static_cast<size_t>(checked));
+        state.SetCounter("stop_word_share"s, found / checked);
+    });
+}
+
+// Кандидаты широкого запроса: релевантность с шагом 1e-4, чтобы были совпадения
+const vector<Document>& GetCandidates(size_t count) {
+    static map<size_t, vector<Document>> candidates;
+    auto& documents = candidates[count];
+    if (documents.empty()) {
+        mt19937 generator(42);
+        uniform_int_distribution<int> relevance(0, 20000);
+        uniform_int_distribution<int> rating(-10, 10);
+        for (size_t i = 0; i < count; ++i) {
+            documents.push_back({static_cast<int>(i), relevance(generator) * 1e-4, rating(generator)});
+        }
+    }
+    return documents;
+}
+
+// Упорядочивание выдачи: сортировка сравнением с допуском ACCURACY против
+// поразрядной по упакованным ключам, для всей выдачи и для первых документов
+void RegisterOrderResults(const string& name, size_t size, function<void(vector<Document>&)> order) {
+    RegisterBenchmark("BM_OrderResults/"s + name + "/"s + to_string(size), [size, order](BenchmarkState& state) {
+        const vector<Document>& candidates = GetCandidates(size);
+        vector<Document> documents;
+        for (auto _ : state) {
+            documents = candidates;
+            order(documents);
+        }
+        state.SetItemsProcessed(state.GetIterations() * size);
+    });
+}
+
+void SortByComparator(vector<Document>& documents) {
+    sort(documents.begin(), documents.end(), [](const Document& lhs, const Document& rhs) {
+        if (abs(lhs.relevance - rhs.relevance) < ACCURACY) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.relevance > rhs.relevance;
+    });
+}
+
+void RegisterAll(const vector<size_t>& sizes) {
+    for (const size_t size : sizes) {
+        RegisterAddDocument(size);
+        RegisterLoadCorpus(size);
+
+        RegisterSearch("BM_FindTopDocuments/seq"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(query).size();
+        });
+        RegisterSearch("BM_FindTopDocuments/par"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(execution::par, query).size();
+        });
+        RegisterSearch("BM_FindTopDocuments/seq_predicate"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(query, EvenRatingPredicate).size();
+        });
+        RegisterSearch("BM_FindTopDocuments/par_predicate"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(execution::par, query, EvenRatingPredicate).size();
+        });
+        RegisterSearch("BM_FindTopDocuments/required_seq"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(query).size();
+        }, &Corpus::required_queries);
+        RegisterSearch("BM_FindTopDocuments/required_par"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(execution::par, query).size();
+        }, &Corpus::required_queries);
+        // Бюджет без ограничений показывает цену проверок, остальные - усечённый обход
+        RegisterSearch("BM_FindTopDocuments/budget_unlimited"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(query, SearchBudget{}).documents.size();
+        });
+        RegisterSearch("BM_FindTopDocuments/budget_10k_postings"s, size, [](const SearchServer& server, const string& query, int) {
+            SearchBudget budget;
+            budget.max_postings = 10000;
+            return server.FindTopDocuments(query, budget).documents.size();
+        });
+        RegisterSearch("BM_FindTopDocuments/budget_1ms"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(query, SearchBudget::WithTimeout(chrono::milliseconds(1))).documents.size();
+        });
+        RegisterBuildImpactIndex(size);
+        RegisterImpactSearch("unlimited"s, size, numeric_limits<size_t>::max());
+        RegisterImpactSearch("10k_postings"s, size, 10000);
+        RegisterImpactSearch("2k_postings"s, size, 2000);
+        RegisterImpactSearch("500_postings"s, size, 500);
+        RegisterCompactSearch("scalar"s, size, CompactIndex::Kernel::SCALAR);
+        if (CompactIndex::GetBestKernel() == CompactIndex::Kernel::AVX2) {
+            RegisterCompactSearch("avx2"s, size, CompactIndex::Kernel::AVX2);
+        }
+        RegisterOrderResults("comparator_sort"s, size, SortByComparator);
+        RegisterOrderResults("radix_sort"s, size, [](vector<Document>& documents) {
+            SortResults(documents);
+        });
+        RegisterOrderResults("radix_sort_par"s, size, [](vector<Document>& documents) {
+            SortResults(execution::par, documents);
+        });
+        RegisterOrderResults("comparator_top5"s, size, [](vector<Document>& documents) {
+            SortByComparator(documents);
+            documents.resize(min<size_t>(documents.size(), MAX_RESULT_DOCUMENT_COUNT));
+        });
+        RegisterOrderResults("radix_select_top5"s, size, [](vector<Document>& documents) {
+            SelectTopResults(documents, MAX_RESULT_DOCUMENT_COUNT);
+        });
+        RegisterSearch("BM_FindTopDocuments/rating_lambda"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(query, RatingRangePredicate).size();
+        });
+        RegisterSearch("BM_FindTopDocuments/rating_filter"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(query, MakeRatingRangeFilter()).size();
+        });
+        RegisterSearch("BM_FindTopDocuments/rating_filter_par"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(execution::par, query, MakeRatingRangeFilter()).size();
+        });
+        RegisterSearch("BM_FindTopDocumentsByRating"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocumentsByRating(query, MakeRatingRangeFilter()).size();
+        });
+        RegisterSearch("BM_FindTopDocuments/prefix"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(query).size();
+        }, &Corpus::prefix_queries);
+        RegisterSearch("BM_FindTopDocuments/compact_storage_seq"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(query).size();
+        }, &Corpus::queries, GetCompactStorageServer);
+        RegisterSearch("BM_FindTopDocuments/compact_storage_required_seq"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(query).size();
+        }, &Corpus::required_queries, GetCompactStorageServer);
+        RegisterSearch("BM_FindTopDocuments/typo"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(query).size();
+        }, &Corpus::typo_queries);
+        RegisterSearch("BM_FindTopDocuments/typo_fuzzy"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(query).size();
+        }, &Corpus::typo_queries, GetFuzzyServer);
+        RegisterSearch("BM_FindTopDocuments/frequent_minus_seq"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(query).size();
+        }, &Corpus::frequent_minus_queries);
+        RegisterSearch("BM_FindTopDocuments/frequent_minus_par"s, size, [](const SearchServer& server, const string& query, int) {
+            return server.FindTopDocuments(execution::par, query).size();
+        }, &Corpus::frequent_minus_queries);
+        // Первые десять страниц по десять документов через курсор
+        RegisterSearch("BM_FindTopDocumentsPage/10x10"s, size, [](const SearchServer& server, const string& query, int) {
+            size_t found = 0;
+            SearchCursor cursor;
+            for (int page = 0; page < 10 && !cursor.IsEnd(); ++page) {
+                SearchPage result = server.FindTopDocumentsPage(query, 10, cursor);
+                found += result.documents.size();
+                cursor = result.next;
+            }
+            return found;
+        });
+        RegisterSearch("BM_MatchDocument/seq"s, size, [](const SearchServer& server, const string& query, int document_id) {
+            return get<0>(server.MatchDocument(execution::seq, query, document_id)).size();
+        });
+        RegisterSearch("BM_MatchDocument/par"s, size, [](const SearchServer& server, const string& query, int document_id) {
+            return get<0>(server.MatchDocument(execution::par, query, document_id)).size();
+        });
+        RegisterMatchDocuments(size);
+
+        RegisterRemoveDocument("seq"s, size, execution::seq);
+        RegisterRemoveDocument("par"s, size, execution::par);
+        RegisterRemoveDuplicates(size);
+        RegisterProcessQueries(size);
+        RegisterFindTopDocumentsBatch(size, 16);
+        RegisterFindTopDocumentsBatch(size, 64);
+        RegisterFindTopDocumentsBatch(size, 1000);
+        RegisterAsyncFindTopDocuments(size);
+        RegisterStopWordLookup<set<string, less<>>>("set"s, size);
+        RegisterStopWordLookup<StopWordSet>("perfect_hash"s, size);
+    }
+    for (const size_t thread_count : {1u, 4u, 16u}) {
+        RegisterConcurrentMapContention<MutexTreeMap<int, long long>>("mutex_tree"s, thread_count);
+        RegisterConcurrentMapContention<StripedMapAdapter>("striped"s, thread_count);
+    }
+}
+
+vector<size_t> ParseSizes(const string& text) {
+    vector<size_t> sizes;
+    istringstream input(text);
+    string size;
+    while (getline(input, size, ',')) {
+        sizes.push_back(stoul(size));
+    }
+    return sizes;
+}
+
+} // namespace
+
+// Параметры:
+//   --benchmark_filter=<подстрока имени>
+//   --benchmark_min_time=<секунды>
+//   --benchmark_out=<файл для JSON, по умолчанию stdout>
+//   --sizes=1000,10000,100000
+int main(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    vector<size_t> sizes = {1000, 10000, 100000};
+    string output_path;
+
+    for (int i = 1; i < argc; ++i) {
+        const string_view arg = argv[i];
+        const auto value = [arg](string_view prefix) {
+            return string(arg.substr(prefix.size()));
+        };
+        if (arg.rfind("--benchmark_filter="sv, 0) == 0) {
+            options.filter = value("--benchmark_filter="sv);
+        } else if (arg.rfind("--benchmark_min_time="sv, 0) == 0) {
+            options.min_time_seconds = stod(value("--benchmark_min_time="sv));
+        } else if (arg.rfind("--benchmark_out="sv, 0) == 0) {
+            output_path = value("--benchmark_out="sv);
+        } else if (arg.rfind("--sizes="sv, 0) == 0) {
+            sizes = ParseSizes(value("--sizes="sv));
+        } else {
+            cerr << "Unknown argument: "s << arg << endl;
+            return 1;
+        }
+    }
+
+    RegisterAll(sizes);
+    if (output_path.empty()) {
+        RunBenchmarks(options, cout);
+    } else {
+        ofstream output(output_path);
+        RunBenchmarks(options, output);
+    }
+    return 0;
+}
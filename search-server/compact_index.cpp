@@ -0,0 +1,220 @@
+#include "compact_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+#if defined(SEARCH_SERVER_SIMD) && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SEARCH_SERVER_AVX2_KERNEL
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Оба ядра сначала умножают, потом складывают, без FMA, поэтому дают побитово
+// одинаковую релевантность
+
+void AccumulateSparseScalar(float weight, const uint32_t* ordinals, const uint16_t* term_freqs, size_t count,
+                            float* relevance) {
+    for (size_t i = 0; i < count; ++i) {
+        relevance[ordinals[i]] += weight * static_cast<float>(term_freqs[i]);
+    }
+}
+
+void AccumulateDenseScalar(float weight, const uint16_t* term_freqs, size_t count, float* relevance) {
+    for (size_t i = 0; i < count; ++i) {
+        relevance[i] += weight * static_cast<float>(term_freqs[i]);
+    }
+}
+
+#ifdef SEARCH_SERVER_AVX2_KERNEL
+
+__attribute__((target("avx2")))
+void AccumulateSparseAvx2(float weight, const uint32_t* ordinals, const uint16_t* term_freqs, size_t count,
+                          float* relevance) {
+    const __m256 weights = _mm256_set1_ps(weight);
+    alignas(32) float sums[8];
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ordinals + i));
+        const __m128i levels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(term_freqs + i));
+        const __m256 contributions = _mm256_mul_ps(weights, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(levels)));
+        _mm256_store_ps(sums, _mm256_add_ps(_mm256_i32gather_ps(relevance, index, 4), contributions));
+        // Scatter в AVX2 нет. Номера документов внутри слова различны, записи не пересекаются.
+        for (size_t j = 0; j < 8; ++j) {
+            relevance[ordinals[i + j]] = sums[j];
+        }
+    }
+    AccumulateSparseScalar(weight, ordinals + i, term_freqs + i, count - i, relevance);
+}
+
+__attribute__((target("avx2")))
+void AccumulateDenseAvx2(float weight, const uint16_t* term_freqs, size_t count, float* relevance) {
+    const __m256 weights = _mm256_set1_ps(weight);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m256i levels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(term_freqs + i));
+        const __m256 low = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(levels)));
+        const __m256 high = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(levels, 1)));
+        _mm256_storeu_ps(relevance + i, _mm256_add_ps(_mm256_loadu_ps(relevance + i), _mm256_mul_ps(weights, low)));
+        _mm256_storeu_ps(relevance + i + 8,
+                         _mm256_add_ps(_mm256_loadu_ps(relevance + i + 8), _mm256_mul_ps(weights, high)));
+    }
+    AccumulateDenseScalar(weight, term_freqs + i, count - i, relevance + i);
+}
+
+#endif
+
+} // namespace
+
+CompactIndex::Kernel CompactIndex::GetBestKernel() {
+#ifdef SEARCH_SERVER_AVX2_KERNEL
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2 ? Kernel::AVX2 : Kernel::SCALAR;
+#else
+    return Kernel::SCALAR;
+#endif
+}
+
+CompactIndex::CompactIndex(int collection_size, const IndexSource& source)
+    : collection_size_(collection_size),
+      source_(source)
+{}
+
+void CompactIndex::AddDocument(int document_id, int rating) {
+    documents_.Add(document_id, rating);
+}
+
+void CompactIndex::AddTerm(std::string_view word, size_t document_freq, TermFreqIterator first, TermFreqIterator last) {
+    const auto count = static_cast<size_t>(last - first);
+    if (count == 0) {
+        return;
+    }
+    Term term;
+    term.inverse_document_freq = std::log(collection_size_ * 1.0 / document_freq);
+    // Шесть байт на постинг против двух на каждый документ индекса
+    term.is_dense = count * 3 > documents_.GetSize();
+    term.offset = term.is_dense ? dense_term_freqs_.size() : ordinals_.size();
+    term.size = count;
+    if (term.is_dense) {
+        dense_term_freqs_.resize(dense_term_freqs_.size() + documents_.GetSize(), 0);
+    }
+
+    uint32_t ordinal = 0;
+    for (auto it = first; it != last; ++it) {
+        const auto [document_id, term_freq] = *it;
+        ordinal = documents_.Find(document_id, ordinal);
+        // Уровень 0 означает отсутствие слова, поэтому даже очень малая доля - уровень 1
+        const uint16_t level = PostingList::EncodeTermFreq(term_freq);
+        if (term.is_dense) {
+            dense_term_freqs_[term.offset + ordinal] = level;
+        } else {
+            ordinals_.push_back(ordinal);
+            term_freqs_.push_back(level);
+        }
+    }
+    terms_[std::string(word)] = term;
+}
+
+std::vector<Document> CompactIndex::FindAllDocuments(const std::vector<std::string_view>& plus_words,
+                                                     const std::vector<std::string_view>& minus_words,
+                                                     Kernel kernel) const {
+    if (kernel == Kernel::AVX2 && GetBestKernel() != Kernel::AVX2) {
+        throw std::invalid_argument("CompactIndex: AVX2 kernel is not available");
+    }
+    const size_t document_count = documents_.GetSize();
+    std::vector<float> relevance(document_count, 0.0f);
+    // Слово всех документов сервера имеет нулевой idf и не меняет релевантность,
+    // поэтому его документы отмечаются отдельно
+    std::vector<uint8_t> zero_weight_matches;
+
+    for (const Term* term : FindTerms(plus_words)) {
+        const auto weight = static_cast<float>(term->inverse_document_freq / TF_LEVELS);
+        if (weight == 0.0f) {
+            zero_weight_matches.resize(document_count, 0);
+            for (size_t i = 0; i < (term->is_dense ? document_count : term->size); ++i) {
+                if (!term->is_dense) {
+                    zero_weight_matches[ordinals_[term->offset + i]] = 1;
+                } else if (dense_term_freqs_[term->offset + i] != 0) {
+                    zero_weight_matches[i] = 1;
+                }
+            }
+            continue;
+        }
+
+#ifdef SEARCH_SERVER_AVX2_KERNEL
+        if (kernel == Kernel::AVX2) {
+            if (term->is_dense) {
+                AccumulateDenseAvx2(weight, dense_term_freqs_.data() + term->offset, document_count, relevance.data());
+            } else {
+                AccumulateSparseAvx2(weight, ordinals_.data() + term->offset, term_freqs_.data() + term->offset,
+                                     term->size, relevance.data());
+            }
+            continue;
+        }
+#endif
+        if (term->is_dense) {
+            AccumulateDenseScalar(weight, dense_term_freqs_.data() + term->offset, document_count, relevance.data());
+        } else {
+            AccumulateSparseScalar(weight, ordinals_.data() + term->offset, term_freqs_.data() + term->offset,
+                                   term->size, relevance.data());
+        }
+    }
+
+    // Отрицательная релевантность помечает документы минус-слов
+    for (const Term* term : FindTerms(minus_words)) {
+        for (size_t i = 0; i < (term->is_dense ? document_count : term->size); ++i) {
+            if (!term->is_dense) {
+                relevance[ordinals_[term->offset + i]] = -1.0f;
+            } else if (dense_term_freqs_[term->offset + i] != 0) {
+                relevance[i] = -1.0f;
+            }
+        }
+    }
+
+    std::vector<Document> matched_documents;
+    for (size_t i = 0; i < document_count; ++i) {
+        if (relevance[i] > 0.0f || (!zero_weight_matches.empty() && zero_weight_matches[i] && relevance[i] == 0.0f)) {
+            matched_documents.push_back({documents_.GetId(i), relevance[i], documents_.GetRating(i)});
+        }
+    }
+    return matched_documents;
+}
+
+double CompactIndex::GetRelevanceErrorBound(const std::vector<std::string_view>& plus_words) const {
+    const std::vector<const Term*> terms = FindTerms(plus_words);
+    double inverse_document_freq_sum = 0.0;
+    for (const Term* term : terms) {
+        inverse_document_freq_sum += term->inverse_document_freq;
+    }
+    return inverse_document_freq_sum * (1.0 / TF_LEVELS + (terms.size() + 2) * std::ldexp(1.0, -24));
+}
+
+const IndexSource& CompactIndex::GetSource() const {
+    return source_;
+}
+
+size_t CompactIndex::GetDocumentCount() const {
+    return documents_.GetSize();
+}
+
+size_t CompactIndex::GetPostingBytes() const {
+    return ordinals_.size() * sizeof(uint32_t) + term_freqs_.size() * sizeof(uint16_t)
+           + dense_term_freqs_.size() * sizeof(uint16_t);
+}
+
+std::vector<const CompactIndex::Term*> CompactIndex::FindTerms(const std::vector<std::string_view>& words) const {
+    std::vector<std::string_view> unique_words = words;
+    std::sort(unique_words.begin(), unique_words.end());
+    unique_words.erase(std::unique(unique_words.begin(), unique_words.end()), unique_words.end());
+
+    std::vector<const Term*> terms;
+    for (const std::string_view word : unique_words) {
+        const auto it = terms_.find(word);
+        if (it != terms_.end()) {
+            terms.push_back(&it->second);
+        }
+    }
+    return terms;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+#include "document_ordinals.h"
+#include "index_source.h"
+#include "posting_list.h"
+
+// Компактный режим ранжирования TF-IDF. Доля слова в документе хранится 16-битным
+// уровнем TF_LEVELS, релевантность накапливается во float в плотном массиве по
+// номерам документов. Редкие слова хранят пары (номер документа, уровень), частые -
+// уровень для каждого документа индекса: при df больше трети документов так
+// меньше памяти, а накопление идёт подряд без адресации по номерам.
+//
+// Отличие релевантности от точного TF-IDF для запроса из T слов не больше
+//     sum(idf) * (1 / TF_LEVELS + (T + 2) * 2^-24),
+// см. GetRelevanceErrorBound: первое слагаемое - квантование частоты (половина
+// уровня, целый уровень для документов длиннее 2 * TF_LEVELS слов), второе -
+// округления float. Документы с точной релевантностью, различающейся больше чем
+// на две такие границы, упорядочены так же, как в SearchServer::FindTopDocuments.
+// Это снимок только для чтения для быстрого накопления во float, который хранится
+// рядом с индексом сервера и добавляется к его памяти. Память экономит сам сервер
+// в PostingStorage::COMPACT, где постинги хранят те же 16-битные уровни. Строится
+// SearchServer::BuildCompactIndex и после любого AddDocument или RemoveDocument
+// должен строиться заново - SearchServer::FindTopDocumentsCompact бросает
+// исключение для устаревшего снимка.
+class CompactIndex {
+public:
+    // Уровни те же, что у постингов сервера в PostingStorage::COMPACT
+    static constexpr int TF_LEVELS = PostingList::TF_LEVELS;
+
+    // Ядро накопления вкладов в массив релевантности
+    enum class Kernel {
+        SCALAR,
+        // AVX2: gather для редких слов, потоковое сложение для частых
+        AVX2,
+    };
+
+    // Лучшее ядро для этого процессора и сборки
+    static Kernel GetBestKernel();
+
+    CompactIndex() = default;
+
+    // collection_size - число документов сервера всех статусов, по нему считается idf;
+    // source - сервер и версия его индекса, по которым строится этот
+    CompactIndex(int collection_size, const IndexSource &source);
+
+    // Документы добавляются по возрастанию id и до слов
+    void AddDocument(int document_id, int rating);
+
+    using TermFreqIterator = std::vector<std::pair<int, double>>::const_iterator;
+
+    // [first, last) - пары (id документа, доля слова) по возрастанию id для документов
+    // индекса, document_freq - число документов со словом на сервере
+    void AddTerm(std::string_view word, size_t document_freq, TermFreqIterator first, TermFreqIterator last);
+
+    // Документы со словами plus_words без документов minus_words по возрастанию id
+    std::vector<Document> FindAllDocuments(const std::vector<std::string_view> &plus_words,
+                                           const std::vector<std::string_view> &minus_words,
+                                           Kernel kernel = GetBestKernel()) const;
+
+    double GetRelevanceErrorBound(const std::vector<std::string_view> &plus_words) const;
+
+    const IndexSource &GetSource() const;
+
+    size_t GetDocumentCount() const;
+
+    // Байты постингов: номера документов и уровни частоты
+    size_t GetPostingBytes() const;
+
+private:
+    struct Term {
+        double inverse_document_freq;
+        // Редкое слово - ordinals_/term_freqs_[offset, offset + size),
+        // частое - dense_term_freqs_[offset, offset + documents_.GetSize())
+        bool is_dense;
+        size_t offset;
+        size_t size;
+    };
+
+    int collection_size_ = 0;
+    IndexSource source_;
+    DocumentOrdinals documents_;
+    std::map<std::string, Term, std::less<>> terms_;
+    std::vector<uint32_t> ordinals_;
+    std::vector<uint16_t> term_freqs_;
+    std::vector<uint16_t> dense_term_freqs_;
+
+    std::vector<const Term *> FindTerms(const std::vector<std::string_view> &words) const;
+};
@@ -3,57 +3,254 @@
 //
 
 #pragma once
+#include <algorithm>
+#include <cstdint>
 #include <cstdlib>
+#include <execution>
+#include <functional>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
-using namespace std::string_literals;
+// Хеш строк, принимающий и std::string, и std::string_view, и const char*:
+// поиск по string_view в ConcurrentMap<std::string, ...> не создаёт строку
+struct TransparentStringHash {
+    using is_transparent = void;
 
-template <typename Key, typename Value>
+    size_t operator()(std::string_view text) const {
+        return std::hash<std::string_view>{}(text);
+    }
+};
+
+template <typename Key>
+struct ConcurrentMapHash : std::hash<Key> {};
+
+template <>
+struct ConcurrentMapHash<std::string> : TransparentStringHash {};
+
+template <>
+struct ConcurrentMapHash<std::string_view> : TransparentStringHash {};
+
+// Хеш-таблица, поделённая на полосы (stripes), у каждой полосы свой
+// std::shared_mutex: чтения одной полосы идут параллельно, запись блокирует
+// только свою полосу. Полосы выровнены по кэш-линии, чтобы блокировки
+// соседних полос не делили линию. Методы поиска шаблонные: ключ может быть
+// любого типа, который принимают Hash и KeyEqual (например, string_view
+// для строковых ключей).
+//
+// Чтения берут разделяемую блокировку, а не оптимистичную (seqlock): узлы
+// полосы освобождаются при Erase, и читатель без блокировки мог бы обратиться
+// к удалённому узлу.
+template <typename Key, typename Value, typename Hash = ConcurrentMapHash<Key>, typename KeyEqual = std::equal_to<>>
 class ConcurrentMap {
 private:
-    struct Bucket {
-        std::mutex mutex;
-        std::map<Key, Value> map;
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    struct Node {
+        std::pair<const Key, Value> item;
+        size_t hash;
+        std::unique_ptr<Node> next;
     };
-    std::vector<Bucket> buckets_;
 
-public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys"s);
+    struct alignas(CACHE_LINE_SIZE) Stripe {
+        mutable std::shared_mutex mutex;
+        std::vector<std::unique_ptr<Node>> buckets;
+        size_t size = 0;
+    };
+
+    std::vector<Stripe> stripes_;
+    Hash hash_;
+    KeyEqual equal_;
+
+    // std::hash для целых - тождественная функция, поэтому хеш перемешивается
+    // (финализатор splitmix64). Полоса - остаток от деления на число полос,
+    // корзина внутри полосы - по частному, так что выбор не коррелирует.
+    static size_t MixHash(size_t hash) {
+        uint64_t x = static_cast<uint64_t>(hash);
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return static_cast<size_t>(x ^ (x >> 31));
+    }
+
+    size_t StripeIndex(size_t hash) const {
+        return hash % stripes_.size();
+    }
+
+    // Число корзин полосы - степень двойки
+    size_t BucketIndex(size_t hash, size_t bucket_count) const {
+        return (hash / stripes_.size()) & (bucket_count - 1);
+    }
+
+    template <typename K>
+    Node* FindNode(const Stripe& stripe, const K& key, size_t hash) const {
+        if (stripe.buckets.empty()) {
+            return nullptr;
+        }
+        for (Node* node = stripe.buckets[BucketIndex(hash, stripe.buckets.size())].get(); node; node = node->next.get()) {
+            if (node->hash == hash && equal_(node->item.first, key)) {
+                return node;
+            }
+        }
+        return nullptr;
+    }
+
+    // Вставляет ключ со значением по умолчанию; вызывается под уникальной блокировкой
+    Value& FindOrInsert(Stripe& stripe, const Key& key, size_t hash) {
+        if (Node* node = FindNode(stripe, key, hash)) {
+            return node->item.second;
+        }
+        if (stripe.size >= stripe.buckets.size()) {
+            Rehash(stripe, std::max<size_t>(8, stripe.buckets.size() * 2));
+        }
+        auto& head = stripe.buckets[BucketIndex(hash, stripe.buckets.size())];
+        head = std::unique_ptr<Node>(new Node{{key, Value()}, hash, std::move(head)});
+        ++stripe.size;
+        return head->item.second;
+    }
+
+    void Rehash(Stripe& stripe, size_t bucket_count) const {
+        std::vector<std::unique_ptr<Node>> buckets(bucket_count);
+        for (auto& head : stripe.buckets) {
+            while (head) {
+                std::unique_ptr<Node> node = std::move(head);
+                head = std::move(node->next);
+                auto& new_head = buckets[BucketIndex(node->hash, bucket_count)];
+                node->next = std::move(new_head);
+                new_head = std::move(node);
+            }
+        }
+        stripe.buckets = std::move(buckets);
+    }
 
+public:
+    // Доступ к значению под уникальной блокировкой полосы
     struct Access {
-        std::lock_guard<std::mutex> guard;
+        std::unique_lock<std::shared_mutex> guard;
         Value& ref_to_value;
-
-        Access(const Key& key, Bucket& bucket)
-            : guard(bucket.mutex),
-            ref_to_value(bucket.map[key])
-        {}
     };
 
-    explicit ConcurrentMap(size_t bucket_count)
-        : buckets_(bucket_count)
+    explicit ConcurrentMap(size_t bucket_count, Hash hash = {}, KeyEqual equal = {})
+        : stripes_(std::max<size_t>(bucket_count, 1)), hash_(std::move(hash)), equal_(std::move(equal))
     {}
 
+    ConcurrentMap(const ConcurrentMap&) = delete;
+    ConcurrentMap& operator=(const ConcurrentMap&) = delete;
+
+    ~ConcurrentMap() {
+        // Длинные цепочки удаляются без рекурсии деструкторов unique_ptr
+        for (Stripe& stripe : stripes_) {
+            for (auto& head : stripe.buckets) {
+                while (head) {
+                    head = std::move(head->next);
+                }
+            }
+        }
+    }
+
+    // Вставляет значение по умолчанию, если ключа нет
     Access operator[](const Key& key) {
-        auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
-        return {key, bucket};
+        const size_t hash = MixHash(hash_(key));
+        Stripe& stripe = stripes_[StripeIndex(hash)];
+        std::unique_lock guard(stripe.mutex);
+        Value& value = FindOrInsert(stripe, key, hash);
+        return {std::move(guard), value};
     }
 
-    std::map<Key, Value> BuildOrdinaryMap() {
-        std::map<Key, Value> result;
-        for (auto& [mutex, map] : buckets_) {
-            std::lock_guard g(mutex);
-            result.insert(map.begin(), map.end());
+    // Вызывает action(Value&) под уникальной блокировкой, вставляя ключ при необходимости
+    template <typename Action>
+    void Update(const Key& key, Action action) {
+        const size_t hash = MixHash(hash_(key));
+        Stripe& stripe = stripes_[StripeIndex(hash)];
+        std::unique_lock guard(stripe.mutex);
+        action(FindOrInsert(stripe, key, hash));
+    }
+
+    // Вызывает action(const Value&) под разделяемой блокировкой без копирования;
+    // false, если ключа нет
+    template <typename K, typename Action>
+    bool Visit(const K& key, Action action) const {
+        const size_t hash = MixHash(hash_(key));
+        const Stripe& stripe = stripes_[StripeIndex(hash)];
+        std::shared_lock guard(stripe.mutex);
+        if (const Node* node = FindNode(stripe, key, hash)) {
+            action(node->item.second);
+            return true;
         }
+        return false;
+    }
+
+    template <typename K>
+    std::optional<Value> Find(const K& key) const {
+        std::optional<Value> result;
+        Visit(key, [&result](const Value& value) {
+            result = value;
+        });
         return result;
     }
 
-    auto Erase(const Key& key) {
-        uint64_t tmp_key = static_cast<uint64_t>(key) % buckets_.size();
-        std::lock_guard guard(buckets_[tmp_key].mutex);
-        return buckets_[tmp_key].map.erase(key);
+    template <typename K>
+    bool Contains(const K& key) const {
+        return Visit(key, [](const Value&) {});
+    }
+
+    template <typename K>
+    size_t Erase(const K& key) {
+        const size_t hash = MixHash(hash_(key));
+        Stripe& stripe = stripes_[StripeIndex(hash)];
+        std::unique_lock guard(stripe.mutex);
+        if (stripe.buckets.empty()) {
+            return 0;
+        }
+        for (std::unique_ptr<Node>* link = &stripe.buckets[BucketIndex(hash, stripe.buckets.size())]; *link; link = &(*link)->next) {
+            if ((*link)->hash == hash && equal_((*link)->item.first, key)) {
+                *link = std::move((*link)->next);
+                --stripe.size;
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    size_t Size() const {
+        size_t size = 0;
+        for (const Stripe& stripe : stripes_) {
+            std::shared_lock guard(stripe.mutex);
+            size += stripe.size;
+        }
+        return size;
+    }
+
+    // Обходит все пары без копирования: action(const Key&, const Value&) вызывается
+    // под разделяемой блокировкой своей полосы, полосы обходятся согласно policy.
+    // Это не единый снимок: записи в уже пройденные полосы обход не увидит.
+    template <typename ExecutionPolicy, typename Action>
+    void ForEach(ExecutionPolicy&& policy, Action action) const {
+        std::for_each(policy, stripes_.begin(), stripes_.end(), [&action](const Stripe& stripe) {
+            std::shared_lock guard(stripe.mutex);
+            for (const auto& head : stripe.buckets) {
+                for (const Node* node = head.get(); node; node = node->next.get()) {
+                    action(node->item.first, node->item.second);
+                }
+            }
+        });
+    }
+
+    template <typename Action>
+    void ForEach(Action action) const {
+        ForEach(std::execution::seq, action);
+    }
+
+    std::map<Key, Value> BuildOrdinaryMap() const {
+        std::map<Key, Value> result;
+        ForEach([&result](const Key& key, const Value& value) {
+            result.emplace(key, value);
+        });
+        return result;
     }
 };
@@ -0,0 +1,139 @@
+#include "corpus_generator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+std::string MakeWord(char prefix, size_t index) {
+    std::string word(1, prefix);
+    do {
+        word.push_back(static_cast<char>('a' + index % 26));
+        index /= 26;
+    } while (index > 0);
+    return word;
+}
+
+} // namespace
+
+CorpusGenerator::CorpusGenerator(CorpusOptions options)
+    : options_(options),
+    state_(options.seed)
+{
+    vocabulary_.reserve(options_.vocabulary_size);
+    zipf_cdf_.reserve(options_.vocabulary_size);
+    double total = 0.0;
+    for (size_t rank = 0; rank < options_.vocabulary_size; ++rank) {
+        vocabulary_.push_back(MakeWord('w', rank));
+        total += 1.0 / std::pow(static_cast<double>(rank + 1), options_.zipf_exponent);
+        zipf_cdf_.push_back(total);
+    }
+    for (double& value : zipf_cdf_) {
+        value /= total;
+    }
+
+    stop_words_.reserve(options_.stop_word_count);
+    for (size_t i = 0; i < options_.stop_word_count; ++i) {
+        stop_words_.push_back(MakeWord('s', i));
+    }
+}
+
+const CorpusOptions& CorpusGenerator::GetOptions() const {
+    return options_;
+}
+
+const std::vector<std::string>& CorpusGenerator::GetVocabulary() const {
+    return vocabulary_;
+}
+
+std::string CorpusGenerator::GetStopWordsText() const {
+    std::string result;
+    for (const std::string& word : stop_words_) {
+        if (!result.empty()) {
+            result.push_back(' ');
+        }
+        result += word;
+    }
+    return result;
+}
+
+std::vector<GeneratedDocument> CorpusGenerator::GenerateDocuments() {
+    std::vector<GeneratedDocument> documents;
+    documents.reserve(options_.document_count);
+
+    for (size_t i = 0; i < options_.document_count; ++i) {
+        GeneratedDocument document;
+        document.id = static_cast<int>(i);
+
+        const double length = options_.mean_document_length + options_.document_length_stddev * NextNormal();
+        const size_t word_count = std::max<long>(1, std::lround(length));
+        for (size_t w = 0; w < word_count; ++w) {
+            if (!document.text.empty()) {
+                document.text.push_back(' ');
+            }
+            if (!stop_words_.empty() && NextUniform() < options_.stop_word_ratio) {
+                document.text += stop_words_[NextRandom() % stop_words_.size()];
+            } else {
+                document.text += NextWord();
+            }
+        }
+
+        const uint64_t status = NextRandom() % 10;
+        document.status = status < 7 ? DocumentStatus::ACTUAL
+                        : status < 8 ? DocumentStatus::IRRELEVANT
+                        : status < 9 ? DocumentStatus::BANNED
+                        : DocumentStatus::REMOVED;
+
+        const size_t rating_count = NextRandom() % 5 + 1;
+        for (size_t r = 0; r < rating_count; ++r) {
+            document.ratings.push_back(static_cast<int>(NextRandom() % 21) - 10);
+        }
+        documents.push_back(std::move(document));
+    }
+    return documents;
+}
+
+std::vector<std::string> CorpusGenerator::GenerateQueries(size_t count, size_t words_per_query, double minus_word_ratio) {
+    std::vector<std::string> queries;
+    queries.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string query;
+        for (size_t w = 0; w < words_per_query; ++w) {
+            if (!query.empty()) {
+                query.push_back(' ');
+            }
+            if (NextUniform() < minus_word_ratio) {
+                query.push_back('-');
+            }
+            query += NextWord();
+        }
+        queries.push_back(std::move(query));
+    }
+    return queries;
+}
+
+// splitmix64
+uint64_t CorpusGenerator::NextRandom() {
+    uint64_t z = (state_ += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+double CorpusGenerator::NextUniform() {
+    return static_cast<double>(NextRandom() >> 11) * 0x1.0p-53;
+}
+
+// Box-Muller
+double CorpusGenerator::NextNormal() {
+    const double u1 = 1.0 - NextUniform();
+    const double u2 = NextUniform();
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * M_PI * u2);
+}
+
+const std::string& CorpusGenerator::NextWord() {
+    const double u = NextUniform();
+    const auto it = std::lower_bound(zipf_cdf_.begin(), zipf_cdf_.end(), u);
+    const size_t rank = std::min<size_t>(std::distance(zipf_cdf_.begin(), it), vocabulary_.size() - 1);
+    return vocabulary_[rank];
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "document.h"
+
+struct CorpusOptions {
+    uint64_t seed = 42;
+    size_t document_count = 1000;
+    size_t vocabulary_size = 10000;
+    // Показатель распределения Ципфа: частота слова ранга r ~ 1 / r^s
+    double zipf_exponent = 1.0;
+    // Длина документа в словах ~ N(mean, stddev), но не меньше 1
+    double mean_document_length = 50.0;
+    double document_length_stddev = 15.0;
+    size_t stop_word_count = 20;
+    // Доля стоп-слов среди слов документа
+    double stop_word_ratio = 0.2;
+};
+
+struct GeneratedDocument {
+    int id;
+    std::string text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
+
+// Детерминированный генератор синтетического корпуса. Не использует
+// std::*_distribution, реализация которых различается между стандартными
+// библиотеками, поэтому при одинаковом seed корпус совпадает на всех платформах.
+class CorpusGenerator {
+public:
+    explicit CorpusGenerator(CorpusOptions options);
+
+    const CorpusOptions& GetOptions() const;
+
+    const std::vector<std::string>& GetVocabulary() const;
+
+    // Стоп-слова через пробел - в формате конструктора SearchServer
+    std::string GetStopWordsText() const;
+
+    std::vector<GeneratedDocument> GenerateDocuments();
+
+    // Запросы из слов того же распределения; minus_word_ratio - вероятность минус-слова
+    std::vector<std::string> GenerateQueries(size_t count, size_t words_per_query, double minus_word_ratio);
+
+private:
+    CorpusOptions options_;
+    std::vector<std::string> vocabulary_;
+    std::vector<std::string> stop_words_;
+    std::vector<double> zipf_cdf_;
+    uint64_t state_;
+
+    uint64_t NextRandom();
+
+    double NextUniform();
+
+    double NextNormal();
+
+    const std::string& NextWord();
+};
@@ -0,0 +1,455 @@
+#include "corpus_loader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <exception>
+#include <execution>
+#include <numeric>
+#include <stdexcept>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <sstream>
+#endif
+
+#include "string_processing.h"
+
+using namespace std::string_literals;
+
+namespace {
+
+class CorpusError : public std::invalid_argument {
+public:
+    CorpusError(size_t position, const std::string& what)
+        : std::invalid_argument("LoadCorpus: bad record at byte "s + std::to_string(position) + ": "s + what)
+    {}
+};
+
+int ParseInt(std::string_view token, size_t position, const char* what) {
+    int value = 0;
+    const auto [ptr, error] = std::from_chars(token.data(), token.data() + token.size(), value);
+    if (token.empty() || error != std::errc() || ptr != token.data() + token.size())
+        throw CorpusError(position, "bad "s + what + " '"s + std::string(token) + "'"s);
+    return value;
+}
+
+void AppendUtf8(std::vector<char>& out, uint32_t code_point) {
+    if (code_point < 0x80) {
+        out.push_back(static_cast<char>(code_point));
+    } else if (code_point < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else if (code_point < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+}
+
+// Разбор одной строки JSONL. Строки без escape-последовательностей
+// возвращаются как string_view в исходный буфер.
+class JsonCursor {
+public:
+    JsonCursor(std::string_view text, size_t offset, std::vector<char>& unescaped, size_t chunk_size)
+        : text_(text), offset_(offset), unescaped_(unescaped), chunk_size_(chunk_size)
+    {}
+
+    void SkipSpaces() {
+        while (pos_ < text_.size() && (text_[pos_] == ' ' || text_[pos_] == '\t' || text_[pos_] == '\r')) {
+            ++pos_;
+        }
+    }
+
+    bool IsAtEnd() {
+        SkipSpaces();
+        return pos_ == text_.size();
+    }
+
+    // Пропускает c, если он следующий
+    bool Consume(char c) {
+        SkipSpaces();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    void Expect(char c) {
+        if (!Consume(c))
+            throw Error("expected '"s + c + "'"s);
+    }
+
+    std::string_view ParseString() {
+        Expect('"');
+        const size_t begin = pos_;
+        while (pos_ < text_.size() && text_[pos_] != '"' && text_[pos_] != '\\') {
+            ++pos_;
+        }
+        if (pos_ == text_.size())
+            throw Error("unterminated string");
+        if (text_[pos_] == '"') {
+            return text_.substr(begin, pos_++ - begin);
+        }
+
+        // Распакованная строка не длиннее исходной, поэтому буфера
+        // размером с кусок хватит и он не будет перевыделяться
+        if (unescaped_.capacity() == 0) {
+            unescaped_.reserve(chunk_size_);
+        }
+        const size_t out_begin = unescaped_.size();
+        unescaped_.insert(unescaped_.end(), text_.begin() + begin, text_.begin() + pos_);
+        while (true) {
+            if (pos_ == text_.size())
+                throw Error("unterminated string");
+            const char c = text_[pos_++];
+            if (c == '"') {
+                break;
+            }
+            if (c != '\\') {
+                unescaped_.push_back(c);
+                continue;
+            }
+            if (pos_ == text_.size())
+                throw Error("unterminated string");
+            switch (const char escaped = text_[pos_++]) {
+                case '"':
+                case '\\':
+                case '/':
+                    unescaped_.push_back(escaped);
+                    break;
+                case 'b':
+                    unescaped_.push_back('\b');
+                    break;
+                case 'f':
+                    unescaped_.push_back('\f');
+                    break;
+                case 'n':
+                    unescaped_.push_back('\n');
+                    break;
+                case 'r':
+                    unescaped_.push_back('\r');
+                    break;
+                case 't':
+                    unescaped_.push_back('\t');
+                    break;
+                case 'u':
+                    AppendUtf8(unescaped_, ParseCodePoint());
+                    break;
+                default:
+                    throw Error("bad escape sequence"s);
+            }
+        }
+        return {unescaped_.data() + out_begin, unescaped_.size() - out_begin};
+    }
+
+    int ParseInt(const char* what) {
+        SkipSpaces();
+        const size_t begin = pos_;
+        while (pos_ < text_.size() && (text_[pos_] == '-' || (text_[pos_] >= '0' && text_[pos_] <= '9'))) {
+            ++pos_;
+        }
+        return ::ParseInt(text_.substr(begin, pos_ - begin), offset_ + begin, what);
+    }
+
+    // Пропускает значение любого типа
+    void SkipValue() {
+        SkipSpaces();
+        if (pos_ == text_.size())
+            throw Error("expected a value");
+        if (text_[pos_] == '"') {
+            ParseString();
+            return;
+        }
+        if (text_[pos_] == '[' || text_[pos_] == '{') {
+            const char close = text_[pos_] == '[' ? ']' : '}';
+            ++pos_;
+            if (Consume(close)) {
+                return;
+            }
+            do {
+                if (close == '}') {
+                    ParseString();
+                    Expect(':');
+                }
+                SkipValue();
+            } while (Consume(','));
+            Expect(close);
+            return;
+        }
+        const size_t begin = pos_;
+        while (pos_ < text_.size() && std::string_view(",]} \t\r").find(text_[pos_]) == std::string_view::npos) {
+            ++pos_;
+        }
+        if (pos_ == begin)
+            throw Error("expected a value");
+    }
+
+    CorpusError Error(const std::string& what) const {
+        return CorpusError(offset_ + pos_, what);
+    }
+
+private:
+    std::string_view text_;
+    size_t pos_ = 0;
+    size_t offset_;
+    std::vector<char>& unescaped_;
+    size_t chunk_size_;
+
+    uint32_t ParseHex4() {
+        if (text_.size() - pos_ < 4)
+            throw Error("bad \\u escape");
+        uint32_t value = 0;
+        const auto [ptr, error] = std::from_chars(text_.data() + pos_, text_.data() + pos_ + 4, value, 16);
+        if (error != std::errc() || ptr != text_.data() + pos_ + 4)
+            throw Error("bad \\u escape");
+        pos_ += 4;
+        return value;
+    }
+
+    uint32_t ParseCodePoint() {
+        const uint32_t high = ParseHex4();
+        if (high < 0xD800 || high > 0xDBFF) {
+            return high;
+        }
+        // Суррогатная пара
+        if (text_.substr(pos_, 2) != "\\u")
+            throw Error("unpaired surrogate");
+        pos_ += 2;
+        const uint32_t low = ParseHex4();
+        if (low < 0xDC00 || low > 0xDFFF)
+            throw Error("unpaired surrogate");
+        return 0x10000 + ((high - 0xD800) << 10) + (low - 0xDC00);
+    }
+};
+
+DocumentRecord ParseJsonRecord(std::string_view line, size_t offset, std::vector<char>& unescaped, size_t chunk_size) {
+    JsonCursor cursor(line, offset, unescaped, chunk_size);
+    DocumentRecord record;
+    bool has_id = false;
+    bool has_text = false;
+
+    cursor.Expect('{');
+    if (!cursor.Consume('}')) {
+        do {
+            const std::string_view key = cursor.ParseString();
+            cursor.Expect(':');
+            if (key == "id") {
+                record.id = cursor.ParseInt("document id");
+                has_id = true;
+            } else if (key == "status") {
+                try {
+                    record.status = ParseDocumentStatus(cursor.ParseString());
+                } catch (const CorpusError&) {
+                    throw;
+                } catch (const std::invalid_argument& e) {
+                    throw cursor.Error(e.what());
+                }
+            } else if (key == "ratings") {
+                cursor.Expect('[');
+                if (!cursor.Consume(']')) {
+                    do {
+                        record.ratings.push_back(cursor.ParseInt("rating"));
+                    } while (cursor.Consume(','));
+                    cursor.Expect(']');
+                }
+            } else if (key == "text") {
+                record.text = cursor.ParseString();
+                has_text = true;
+            } else {
+                cursor.SkipValue();
+            }
+        } while (cursor.Consume(','));
+        cursor.Expect('}');
+    }
+    if (!cursor.IsAtEnd())
+        throw cursor.Error("trailing characters");
+    if (!has_id || !has_text)
+        throw CorpusError(offset, "\"id\" and \"text\" are required");
+    return record;
+}
+
+DocumentRecord ParseTsvRecord(std::string_view line, size_t offset) {
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    std::string_view fields[3];
+    for (std::string_view& field : fields) {
+        const size_t tab = line.find('\t');
+        if (tab == std::string_view::npos)
+            throw CorpusError(offset, "expected 4 tab-separated fields");
+        field = line.substr(0, tab);
+        line.remove_prefix(tab + 1);
+    }
+
+    DocumentRecord record;
+    record.id = ParseInt(fields[0], offset, "document id");
+    try {
+        record.status = ParseDocumentStatus(fields[1]);
+    } catch (const std::invalid_argument& e) {
+        throw CorpusError(offset, e.what());
+    }
+    for (std::string_view ratings = fields[2]; !ratings.empty();) {
+        const size_t comma = std::min(ratings.find(','), ratings.size());
+        record.ratings.push_back(ParseInt(ratings.substr(0, comma), offset, "rating"));
+        ratings.remove_prefix(std::min(comma + 1, ratings.size()));
+    }
+    record.text = line;
+    return record;
+}
+
+} // namespace
+
+#if defined(__unix__) || defined(__APPLE__)
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), "MappedFile: cannot open "s + path);
+
+    struct stat info{};
+    if (fstat(fd, &info) < 0) {
+        const int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "MappedFile: cannot stat "s + path);
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    if (size_ > 0) {
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            const int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), "MappedFile: cannot map "s + path);
+        }
+        data_ = static_cast<const char*>(data);
+        // Файл читается один раз от начала к концу: ядро читает с опережением
+        madvise(data, size_, MADV_SEQUENTIAL);
+    }
+    // Отображение остаётся действительным и после закрытия дескриптора
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+void MappedFile::Release(std::string_view range) const {
+    const auto page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    const auto begin = (reinterpret_cast<uintptr_t>(range.data()) + page_size - 1) / page_size * page_size;
+    const auto end = (reinterpret_cast<uintptr_t>(range.data()) + range.size()) / page_size * page_size;
+    if (begin < end) {
+        madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+    }
+}
+#else
+MappedFile::MappedFile(const std::string& path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input)
+        throw std::system_error(errno, std::generic_category(), "MappedFile: cannot open "s + path);
+    std::ostringstream content;
+    content << input.rdbuf();
+    buffer_ = content.str();
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+MappedFile::~MappedFile() = default;
+
+void MappedFile::Release(std::string_view) const {
+}
+#endif
+
+std::string_view MappedFile::GetData() const {
+    return {data_, size_};
+}
+
+CorpusChunk ParseCorpusChunk(std::string_view chunk, CorpusFormat format, size_t offset) {
+    CorpusChunk result;
+    const std::string_view data = chunk;
+    const auto parse_line = [&](std::string_view line) {
+        const size_t line_offset = offset + static_cast<size_t>(line.data() - data.data());
+        if (line.find_first_not_of(" \t\r") == std::string_view::npos) {
+            return;
+        }
+        if (format == CorpusFormat::TSV) {
+            result.records.push_back(ParseTsvRecord(line, line_offset));
+        } else {
+            result.records.push_back(ParseJsonRecord(line, line_offset, result.unescaped, data.size()));
+        }
+    };
+    // Последняя строка файла может быть без '\n'
+    const size_t consumed = ForEachLine(chunk, parse_line);
+    if (consumed < chunk.size()) {
+        parse_line(chunk.substr(consumed));
+    }
+    return result;
+}
+
+std::vector<std::string_view> SplitIntoChunks(std::string_view buffer, size_t chunk_size) {
+    chunk_size = std::max<size_t>(chunk_size, 1);
+    std::vector<std::string_view> chunks;
+    size_t begin = 0;
+    while (begin < buffer.size()) {
+        const size_t newline = buffer.find('\n', std::min(begin + chunk_size, buffer.size()) - 1);
+        const size_t end = newline == std::string_view::npos ? buffer.size() : newline + 1;
+        chunks.push_back(buffer.substr(begin, end - begin));
+        begin = end;
+    }
+    return chunks;
+}
+
+size_t LoadCorpus(SearchServer& server, const std::string& path, const CorpusLoadOptions& options) {
+    const MappedFile file(path);
+    const std::string_view data = file.GetData();
+    const std::vector<std::string_view> chunks = SplitIntoChunks(data, options.chunk_size);
+    const size_t chunks_per_wave = std::max<size_t>(options.chunks_per_wave, 1);
+
+    size_t loaded = 0;
+    for (size_t wave_begin = 0; wave_begin < chunks.size(); wave_begin += chunks_per_wave) {
+        const size_t wave_size = std::min(chunks_per_wave, chunks.size() - wave_begin);
+        std::vector<CorpusChunk> parsed(wave_size);
+        std::vector<std::exception_ptr> errors(wave_size);
+        std::vector<size_t> indexes(wave_size);
+        std::iota(indexes.begin(), indexes.end(), 0);
+        std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t i) {
+            const std::string_view chunk = chunks[wave_begin + i];
+            try {
+                parsed[i] = ParseCorpusChunk(chunk, options.format, static_cast<size_t>(chunk.data() - data.data()));
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+        for (const std::exception_ptr& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+        std::vector<DocumentRecord> records;
+        records.reserve(std::transform_reduce(parsed.begin(), parsed.end(), size_t{0}, std::plus<>(),
+                                              [](const CorpusChunk& chunk) { return chunk.records.size(); }));
+        for (CorpusChunk& chunk : parsed) {
+            std::move(chunk.records.begin(), chunk.records.end(), std::back_inserter(records));
+        }
+        server.AddDocuments(std::execution::par, records);
+        loaded += records.size();
+
+        // Тексты уже скопированы в сервер - страницы волны можно отдать
+        const std::string_view last_chunk = chunks[wave_begin + wave_size - 1];
+        const char* wave_data = chunks[wave_begin].data();
+        file.Release({wave_data, static_cast<size_t>(last_chunk.data() + last_chunk.size() - wave_data)});
+    }
+    return loaded;
+}
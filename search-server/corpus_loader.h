@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+// Форматы файла корпуса, одна запись на строку:
+//     TSV:   <id>\t<status>\t<rating,rating,...>\t<text>   (рейтингов может не быть)
+//     JSONL: {"id": 1, "status": "ACTUAL", "ratings": [1, 2], "text": "..."}
+// В JSONL status и ratings необязательны, прочие поля пропускаются.
+// Пустые строки игнорируются, строка может заканчиваться на "\r\n".
+enum class CorpusFormat {
+    TSV,
+    JSONL,
+};
+
+struct CorpusLoadOptions {
+    CorpusFormat format = CorpusFormat::TSV;
+    // Файл режется на куски примерно такого размера по границам строк;
+    // куски одной волны разбираются параллельно и добавляются одним AddDocuments
+    size_t chunk_size = 4 << 20;
+    size_t chunks_per_wave = 8;
+};
+
+// Файл, отображённый в память только для чтения
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    std::string_view GetData() const;
+
+    // Подсказка ядру, что страницы диапазона больше не нужны
+    void Release(std::string_view range) const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#if !defined(__unix__) && !defined(__APPLE__)
+    std::string buffer_;
+#endif
+};
+
+// Разобранный кусок корпуса; text записей ссылается на разобранный буфер
+// или на unescaped, если в JSON-строке были escape-последовательности
+struct CorpusChunk {
+    std::vector<DocumentRecord> records;
+    // Ёмкость резервируется сразу под весь кусок, чтобы буфер не переезжал;
+    // vector, а не string: у перемещённой короткой строки меняется адрес данных
+    std::vector<char> unescaped;
+};
+
+// Бросает std::invalid_argument с позицией первой некорректной записи;
+// offset - смещение chunk от начала файла, для сообщения об ошибке
+CorpusChunk ParseCorpusChunk(std::string_view chunk, CorpusFormat format, size_t offset = 0);
+
+// Делит buffer на куски не меньше chunk_size (кроме последнего), заканчивающиеся на '\n'
+std::vector<std::string_view> SplitIntoChunks(std::string_view buffer, size_t chunk_size);
+
+// Загружает корпус из файла, возвращает число добавленных документов.
+// Тексты не копируются до сохранения в SearchServer: записи ссылаются на
+// отображённый файл. При ошибке документы предыдущих волн остаются в индексе.
+size_t LoadCorpus(SearchServer& server, const std::string& path, const CorpusLoadOptions& options = {});
@@ -1,5 +1,7 @@
 #include "document.h"
 
+#include <stdexcept>
+
 Document::Document(int id, double relevance, int rating)
     : id(id), relevance(relevance), rating(rating)
 {}
@@ -7,4 +9,29 @@ Document::Document(int id, double relevance, int rating)
 std::ostream& operator<<(std::ostream& os, const Document& doc) {
     using namespace std::string_literals;
     return os << "{ document_id = "s << doc.id << ", relevance = "s << doc.relevance << ", rating = "s << doc.rating << " }"s;
-}
\ No newline at end of file
+}
+
+std::string_view GetDocumentStatusName(DocumentStatus status) {
+    switch (status) {
+        case DocumentStatus::ACTUAL:
+            return "ACTUAL";
+        case DocumentStatus::IRRELEVANT:
+            return "IRRELEVANT";
+        case DocumentStatus::BANNED:
+            return "BANNED";
+        case DocumentStatus::REMOVED:
+            return "REMOVED";
+    }
+    return "UNKNOWN";
+}
+
+DocumentStatus ParseDocumentStatus(std::string_view name) {
+    using namespace std::string_literals;
+    for (size_t i = 0; i < DOCUMENT_STATUS_COUNT; ++i) {
+        const auto status = static_cast<DocumentStatus>(i);
+        if (name == GetDocumentStatusName(status)) {
+            return status;
+        }
+    }
+    throw std::invalid_argument("unknown document status '"s + std::string(name) + "'"s);
+}
@@ -2,6 +2,8 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <vector>
 
 struct Document {
     Document() = default;
@@ -20,6 +22,32 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+const size_t DOCUMENT_STATUS_COUNT = 4;
+
+// Имя статуса как в перечислении: "ACTUAL", "BANNED", ...
+std::string_view GetDocumentStatusName(DocumentStatus status);
+
+// Обратная к GetDocumentStatusName; бросает std::invalid_argument
+DocumentStatus ParseDocumentStatus(std::string_view name);
+
+// Документ для SearchServer::AddDocuments; text ссылается на чужой буфер
+struct DocumentRecord {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+// Фильтр только по статусу. FindTopDocuments распознаёт его по типу и проверяет
+// статус по битовой карте, не обращаясь к данным документа.
+struct DocumentStatusFilter {
+    DocumentStatus status;
+
+    bool operator()(int document_id, DocumentStatus document_status, int rating) const {
+        return document_status == status;
+    }
+};
+
 template <typename Document>
 void PrintDocument(const Document& document) {
     using namespace std::string_literals;
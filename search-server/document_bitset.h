@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Множество id документов в виде битовой карты. Id произвольные неотрицательные,
+// поэтому карта страничная: страница на 65536 id (8 КиБ) выделяется при первой записи,
+// пустые диапазоны id памяти не занимают. Страницы и таблица страниц выделяются
+// через Allocator, чтобы карты индекса учитывались в его счётчиках памяти.
+template <typename Allocator = std::allocator<uint64_t>>
+class BasicDocumentBitset {
+public:
+    using allocator_type = Allocator;
+
+    BasicDocumentBitset() = default;
+
+    explicit BasicDocumentBitset(const Allocator& allocator)
+        : pages_(PagePointerAllocator(allocator))
+    {}
+
+    BasicDocumentBitset(const BasicDocumentBitset&) = delete;
+    BasicDocumentBitset& operator=(const BasicDocumentBitset&) = delete;
+
+    // Перемещённый вектор пуст, поэтому страницы освобождает только новый владелец
+    BasicDocumentBitset(BasicDocumentBitset&& other) noexcept = default;
+
+    BasicDocumentBitset& operator=(BasicDocumentBitset&& other) noexcept {
+        if (this != &other) {
+            FreePages();
+            pages_ = std::move(other.pages_);
+            other.pages_.clear();
+        }
+        return *this;
+    }
+
+    ~BasicDocumentBitset() {
+        FreePages();
+    }
+
+    void Set(int document_id) {
+        const auto page = static_cast<size_t>(document_id) >> PAGE_BITS;
+        if (page >= pages_.size()) {
+            pages_.resize(page + 1, nullptr);
+        }
+        if (!pages_[page]) {
+            PageAllocator allocator(pages_.get_allocator());
+            Page* const created = std::allocator_traits<PageAllocator>::allocate(allocator, 1);
+            // Без аргументов страница инициализируется нулями
+            std::allocator_traits<PageAllocator>::construct(allocator, created);
+            pages_[page] = created;
+        }
+        (*pages_[page])[WordIndex(document_id)] |= BitMask(document_id);
+    }
+
+    void Reset(int document_id) {
+        const auto page = static_cast<size_t>(document_id) >> PAGE_BITS;
+        if (page < pages_.size() && pages_[page]) {
+            (*pages_[page])[WordIndex(document_id)] &= ~BitMask(document_id);
+        }
+    }
+
+    bool Test(int document_id) const {
+        const auto page = static_cast<size_t>(document_id) >> PAGE_BITS;
+        return page < pages_.size() && pages_[page]
+               && ((*pages_[page])[WordIndex(document_id)] & BitMask(document_id)) != 0;
+    }
+
+private:
+    static constexpr int PAGE_BITS = 16;
+    static constexpr size_t WORDS_PER_PAGE = (size_t(1) << PAGE_BITS) / 64;
+
+    using Page = std::array<uint64_t, WORDS_PER_PAGE>;
+    using PageAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Page>;
+    using PagePointerAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Page*>;
+
+    std::vector<Page*, PagePointerAllocator> pages_;
+
+    void FreePages() noexcept {
+        PageAllocator allocator(pages_.get_allocator());
+        for (Page* const page : pages_) {
+            if (page) {
+                std::allocator_traits<PageAllocator>::deallocate(allocator, page, 1);
+            }
+        }
+    }
+
+    static size_t WordIndex(int document_id) {
+        return (static_cast<size_t>(document_id) & ((size_t(1) << PAGE_BITS) - 1)) >> 6;
+    }
+
+    static uint64_t BitMask(int document_id) {
+        return uint64_t(1) << (static_cast<unsigned>(document_id) & 63);
+    }
+};
+
+using DocumentBitset = BasicDocumentBitset<>;
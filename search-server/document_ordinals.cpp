@@ -0,0 +1,20 @@
+#include "document_ordinals.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void DocumentOrdinals::Add(int document_id, int rating) {
+    if (!ids_.empty() && ids_.back() >= document_id) {
+        throw std::invalid_argument("DocumentOrdinals: documents must be added in ascending id order");
+    }
+    ids_.push_back(document_id);
+    ratings_.push_back(rating);
+}
+
+uint32_t DocumentOrdinals::Find(int document_id, uint32_t from) const {
+    const auto it = std::lower_bound(ids_.begin() + std::min<size_t>(from, ids_.size()), ids_.end(), document_id);
+    if (it == ids_.end() || *it != document_id) {
+        throw std::invalid_argument("DocumentOrdinals: document was not added to the index");
+    }
+    return static_cast<uint32_t>(it - ids_.begin());
+}
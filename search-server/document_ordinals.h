@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Документы снимка индекса по порядковым номерам: номер - позиция документа
+// в порядке возрастания id. Постинги снимков хранят номера вместо id, а id
+// и рейтинг берутся отсюда.
+class DocumentOrdinals {
+public:
+    // Документы добавляются по возрастанию id
+    void Add(int document_id, int rating);
+
+    // Номер документа document_id не меньше from. Для id по возрастанию каждый
+    // поиск начинается с предыдущего найденного номера, и весь список постингов
+    // сопоставляется за один проход. Документа нет - std::invalid_argument.
+    uint32_t Find(int document_id, uint32_t from = 0) const;
+
+    int GetId(uint32_t ordinal) const {
+        return ids_[ordinal];
+    }
+
+    int GetRating(uint32_t ordinal) const {
+        return ratings_[ordinal];
+    }
+
+    size_t GetSize() const {
+        return ids_.size();
+    }
+
+private:
+    std::vector<int> ids_;
+    std::vector<int> ratings_;
+};
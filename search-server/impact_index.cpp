@@ -0,0 +1,198 @@
+#include "impact_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+ImpactIndex::ImpactIndex(double max_impact, const IndexSource& source)
+    : impact_step_(max_impact > 0.0 ? max_impact / (IMPACT_LEVELS - 1) : 1.0),
+      source_(source)
+{}
+
+void ImpactIndex::AddDocument(int document_id, int rating) {
+    documents_.Add(document_id, rating);
+}
+
+void ImpactIndex::AddTerm(std::string_view word, ImpactIterator first, ImpactIterator last) {
+    if (first == last) {
+        return;
+    }
+    std::vector<std::pair<uint16_t, uint32_t>> levels;
+    levels.reserve(last - first);
+    uint32_t ordinal = 0;
+    for (auto it = first; it != last; ++it) {
+        const auto [document_id, impact] = *it;
+        ordinal = documents_.Find(document_id, ordinal);
+        const long level = std::lround(impact / impact_step_);
+        levels.emplace_back(static_cast<uint16_t>(std::clamp(level, 0L, static_cast<long>(IMPACT_LEVELS - 1))),
+                            ordinal);
+    }
+    // Уровни по убыванию, внутри уровня документы по возрастанию номера
+    std::sort(levels.begin(), levels.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first != rhs.first ? lhs.first > rhs.first : lhs.second < rhs.second;
+    });
+
+    const auto first_segment = static_cast<uint32_t>(segments_.size());
+    for (const auto [impact, ordinal] : levels) {
+        if (segments_.size() == first_segment || segments_.back().impact != impact) {
+            const auto begin = static_cast<uint32_t>(postings_.size());
+            segments_.push_back({begin, begin, impact});
+        }
+        postings_.push_back(ordinal);
+        ++segments_.back().end;
+    }
+    terms_[std::string(word)] = {first_segment, static_cast<uint32_t>(segments_.size())};
+}
+
+SearchResult ImpactIndex::FindTopDocuments(const std::vector<std::string_view>& plus_words,
+                                           const std::vector<std::string_view>& minus_words,
+                                           size_t top_count,
+                                           const SearchBudget& budget) const {
+    enum : uint8_t { UNSEEN, CANDIDATE, EXCLUDED };
+
+    SearchResult result;
+    if (top_count == 0) {
+        return result;
+    }
+    std::vector<uint32_t> scores(documents_.GetSize(), 0);
+    std::vector<uint8_t> states(documents_.GetSize(), UNSEEN);
+
+    for (const std::string_view word : minus_words) {
+        const auto it = terms_.find(word);
+        if (it == terms_.end()) {
+            continue;
+        }
+        const TermSegments& term = it->second;
+        for (uint32_t i = segments_[term.begin].begin; i < segments_[term.end - 1].end; ++i) {
+            states[postings_[i]] = EXCLUDED;
+        }
+    }
+
+    struct Cursor {
+        const Segment* it;
+        const Segment* end;
+    };
+    std::vector<std::string_view> words = plus_words;
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    std::vector<Cursor> cursors;
+    // Сумма уровней следующих сегментов всех слов - наибольшая прибавка любому документу
+    uint32_t remaining = 0;
+    for (const std::string_view word : words) {
+        const auto it = terms_.find(word);
+        if (it != terms_.end()) {
+            cursors.push_back({segments_.data() + it->second.begin, segments_.data() + it->second.end});
+            remaining += cursors.back().it->impact;
+        }
+    }
+
+    BudgetTracker tracker(budget);
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> top_scores;
+    // Проверка окончательности стоит O(кандидатов), поэтому делается, когда с прошлой
+    // проверки обработано не меньше половины их числа постингов: каждый постинг
+    // добавляет не больше одного кандидата, и лишняя работа после момента, когда
+    // выдача стала окончательной, не больше двукратной
+    size_t unchecked_postings = 0;
+    bool exhausted = !tracker.Consume(0);
+    while (!exhausted) {
+        Cursor* next = nullptr;
+        for (Cursor& cursor : cursors) {
+            if (cursor.it != cursor.end && (next == nullptr || cursor.it->impact > next->it->impact)) {
+                next = &cursor;
+            }
+        }
+        if (next == nullptr) {
+            break;
+        }
+        const Segment& segment = *next->it++;
+        remaining -= segment.impact;
+        remaining += next->it != next->end ? next->it->impact : 0;
+
+        for (uint32_t i = segment.begin; i < segment.end && !exhausted; ++i) {
+            const uint32_t ordinal = postings_[i];
+            if (states[ordinal] != EXCLUDED) {
+                if (states[ordinal] == UNSEEN) {
+                    states[ordinal] = CANDIDATE;
+                    candidates.push_back(ordinal);
+                }
+                scores[ordinal] += segment.impact;
+            }
+            exhausted = !tracker.Consume();
+        }
+        unchecked_postings += segment.end - segment.begin;
+        if (unchecked_postings * 2 >= candidates.size()) {
+            unchecked_postings = 0;
+            if (IsRankingFinal(scores, candidates, top_count, remaining, top_scores)) {
+                break;
+            }
+        }
+    }
+    result.truncated = tracker.IsExhausted();
+
+    const size_t count = std::min(top_count, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+                      [this, &scores](uint32_t lhs, uint32_t rhs) {
+                          if (scores[lhs] != scores[rhs]) {
+                              return scores[lhs] > scores[rhs];
+                          }
+                          if (documents_.GetRating(lhs) != documents_.GetRating(rhs)) {
+                              return documents_.GetRating(lhs) > documents_.GetRating(rhs);
+                          }
+                          return lhs < rhs;
+                      });
+    result.documents.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t ordinal = candidates[i];
+        result.documents.push_back({documents_.GetId(ordinal), scores[ordinal] * impact_step_,
+                                     documents_.GetRating(ordinal)});
+    }
+    return result;
+}
+
+double ImpactIndex::GetImpactStep() const {
+    return impact_step_;
+}
+
+const IndexSource& ImpactIndex::GetSource() const {
+    return source_;
+}
+
+size_t ImpactIndex::GetDocumentCount() const {
+    return documents_.GetSize();
+}
+
+size_t ImpactIndex::GetPostingCount() const {
+    return postings_.size();
+}
+
+bool ImpactIndex::IsRankingFinal(const std::vector<uint32_t>& scores,
+                                 const std::vector<uint32_t>& candidates,
+                                 size_t top_count,
+                                 uint32_t remaining,
+                                 std::vector<uint32_t>& top_scores) {
+    // Пока выдача не заполнена, в неё может попасть любой ещё не встреченный документ
+    if (candidates.size() < top_count) {
+        return false;
+    }
+    top_scores.resize(std::min(top_count + 1, candidates.size()));
+    std::partial_sort_copy(candidates.begin(), candidates.end(), top_scores.begin(), top_scores.end(),
+                           [&scores](uint32_t lhs, uint32_t rhs) { return scores[lhs] > scores[rhs]; });
+    for (uint32_t& score : top_scores) {
+        score = scores[score];
+    }
+    // Не встреченные документы пока имеют ноль
+    if (top_scores.size() == top_count) {
+        top_scores.push_back(0);
+    }
+    for (size_t i = 0; i < top_count; ++i) {
+        // Порядок внутри выдачи без новых вкладов уже не изменится
+        if (remaining == 0 && i + 1 < top_count) {
+            continue;
+        }
+        if (top_scores[i] <= top_scores[i + 1] + remaining) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+#include "document_ordinals.h"
+#include "index_source.h"
+#include "search_budget.h"
+
+// Постинги, упорядоченные по вкладу слова в релевантность, для поиска
+// score-at-a-time. Вклад tf * idf квантуется в IMPACT_LEVELS уровней с общим для
+// индекса шагом, постинги слова с одним уровнем образуют сегмент. Поиск берёт
+// сегменты всех слов запроса от большего вклада к меньшему и останавливается, как
+// только первые документы выдачи уже не могут измениться.
+// Строится SearchServer::BuildImpactIndex и изменений сервера не отслеживает.
+class ImpactIndex {
+public:
+    static constexpr int IMPACT_LEVELS = 1024;
+
+    ImpactIndex() = default;
+
+    // max_impact - наибольший вклад в индексе, задаёт шаг квантования;
+    // source - сервер и версия его индекса, по которым строится этот
+    ImpactIndex(double max_impact, const IndexSource &source);
+
+    // Документы добавляются по возрастанию id и до слов
+    void AddDocument(int document_id, int rating);
+
+    using ImpactIterator = std::vector<std::pair<int, double>>::const_iterator;
+
+    // [first, last) - пары (id документа, вклад слова) по возрастанию id,
+    // документы уже добавлены
+    void AddTerm(std::string_view word, ImpactIterator first, ImpactIterator last);
+
+    // Первые top_count документов по сумме квантованных вкладов plus_words без
+    // документов minus_words; при равной сумме - по убыванию рейтинга, затем по
+    // возрастанию id. Релевантность - сумма уровней, умноженная на шаг: каждый
+    // вклад отличается от точного не больше чем на половину шага. Вклады сегментов,
+    // не прочитанных из-за ранней остановки, порядок уже не меняют и в сумму не входят.
+    SearchResult FindTopDocuments(const std::vector<std::string_view> &plus_words,
+                                  const std::vector<std::string_view> &minus_words,
+                                  size_t top_count,
+                                  const SearchBudget &budget = {}) const;
+
+    double GetImpactStep() const;
+
+    const IndexSource &GetSource() const;
+
+    size_t GetDocumentCount() const;
+
+    size_t GetPostingCount() const;
+
+private:
+    // Постинги одного уровня вклада: postings_[begin, end) по возрастанию номера документа
+    struct Segment {
+        uint32_t begin;
+        uint32_t end;
+        uint16_t impact;
+    };
+
+    // Сегменты слова в segments_[begin, end) по убыванию вклада
+    struct TermSegments {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    double impact_step_ = 1.0;
+    IndexSource source_;
+    DocumentOrdinals documents_;
+    std::map<std::string, TermSegments, std::less<>> terms_;
+    std::vector<Segment> segments_;
+    std::vector<uint32_t> postings_;
+
+    // Выдача окончательна, если каждый из первых top_count результатов опережает
+    // следующий больше чем на remaining - наибольший вклад, который ещё может прийти
+    static bool IsRankingFinal(const std::vector<uint32_t> &scores,
+                               const std::vector<uint32_t> &candidates,
+                               size_t top_count,
+                               uint32_t remaining,
+                               std::vector<uint32_t> &top_scores);
+};
@@ -0,0 +1,31 @@
+#include "index_source.h"
+
+#include <atomic>
+
+namespace {
+
+// Номер 0 не выдаётся: им помечены снимки, построенные конструктором по умолчанию
+uint64_t NextServerId() {
+    static std::atomic<uint64_t> next_id = 1;
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace
+
+ServerId::ServerId()
+    : value_(NextServerId())
+{}
+
+ServerId::ServerId(ServerId&& other) noexcept
+    : value_(other.value_)
+{
+    other.value_ = NextServerId();
+}
+
+ServerId& ServerId::operator=(ServerId&& other) noexcept {
+    if (this != &other) {
+        value_ = other.value_;
+        other.value_ = NextServerId();
+    }
+    return *this;
+}
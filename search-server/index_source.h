@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+
+// Уникальный в процессе номер сервера. Версия индекса считается с нуля в каждом
+// сервере, поэтому снимок индекса (ImpactIndex, CompactIndex) помечается ещё и
+// номером сервера. При перемещении номер уходит вместе с индексом, а перемещённый
+// объект получает новый: его прежние снимки к нему больше не относятся.
+class ServerId {
+public:
+    ServerId();
+
+    ServerId(ServerId &&other) noexcept;
+
+    ServerId &operator=(ServerId &&other) noexcept;
+
+    uint64_t Get() const {
+        return value_;
+    }
+
+    // Обмен не расходует новых номеров
+    friend void swap(ServerId &lhs, ServerId &rhs) noexcept {
+        std::swap(lhs.value_, rhs.value_);
+    }
+
+private:
+    uint64_t value_;
+};
+
+// Сервер и версия его индекса, по которым построен снимок
+struct IndexSource {
+    uint64_t server_id = 0;
+    uint64_t version = 0;
+};
+
+inline bool operator==(const IndexSource &lhs, const IndexSource &rhs) {
+    return lhs.server_id == rhs.server_id && lhs.version == rhs.version;
+}
+
+inline bool operator!=(const IndexSource &lhs, const IndexSource &rhs) {
+    return !(lhs == rhs);
+}
@@ -0,0 +1,38 @@
+#include "levenshtein_automaton.h"
+
+#include <algorithm>
+
+LevenshteinAutomaton::LevenshteinAutomaton(std::string_view word, int max_edits)
+    : word_(word), max_edits_(max_edits)
+{}
+
+void LevenshteinAutomaton::Start(int* state) const {
+    for (size_t i = 0; i <= word_.size(); ++i) {
+        state[i] = std::min(static_cast<int>(i), max_edits_ + 1);
+    }
+}
+
+void LevenshteinAutomaton::Step(const int* state, char c, int* next) const {
+    const int limit = max_edits_ + 1;
+    next[0] = std::min(state[0] + 1, limit);
+    for (size_t i = 1; i <= word_.size(); ++i) {
+        const int replace = state[i - 1] + (word_[i - 1] == c ? 0 : 1);
+        next[i] = std::min({replace, state[i] + 1, next[i - 1] + 1, limit});
+    }
+}
+
+bool LevenshteinAutomaton::CanMatch(const int* state) const {
+    return *std::min_element(state, state + GetStateSize()) <= max_edits_;
+}
+
+std::string NextPrefix(std::string_view prefix) {
+    std::string next(prefix);
+    while (!next.empty() && static_cast<unsigned char>(next.back()) == 0xFF) {
+        next.pop_back();
+    }
+    if (!next.empty()) {
+        // std::char_traits<char> сравнивает символы как unsigned char
+        next.back() = static_cast<char>(static_cast<unsigned char>(next.back()) + 1);
+    }
+    return next;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Автомат Левенштейна для слова: принимает строки на расстоянии не больше max_edits.
+// Состояние - строка таблицы динамики (расстояния от префикса входа до каждого префикса
+// слова), значения обрезаются до max_edits + 1. По CanMatch видно, что ни одно
+// продолжение префикса уже не подойдёт, - на этом строится обход отсортированного
+// словаря с пропуском целых поддеревьев префиксов.
+class LevenshteinAutomaton {
+public:
+    LevenshteinAutomaton(std::string_view word, int max_edits);
+
+    // Размер состояния в int, состояния хранятся снаружи подряд
+    size_t GetStateSize() const {
+        return word_.size() + 1;
+    }
+
+    void Start(int* state) const;
+
+    void Step(const int* state, char c, int* next) const;
+
+    bool IsMatch(const int* state) const {
+        return state[word_.size()] <= max_edits_;
+    }
+
+    bool CanMatch(const int* state) const;
+
+    int GetDistance(const int* state) const {
+        return state[word_.size()];
+    }
+
+private:
+    std::string word_;
+    int max_edits_;
+};
+
+// Наименьшая строка, большая всех строк с данным префиксом; пустая, если такой нет
+std::string NextPrefix(std::string_view prefix);
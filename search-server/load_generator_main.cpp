@@ -0,0 +1,239 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "corpus_generator.h"
+#include "query_protocol.h"
+#include "query_trace.h"
+
+using namespace std;
+
+namespace {
+
+struct LoadOptions {
+    uint16_t port = 7700;
+    string unix_path;
+    size_t connections = 4;
+    size_t queries_per_connection = 10000;
+    // Сколько запросов отправляется подряд, не дожидаясь ответов
+    size_t pipeline_depth = 16;
+    size_t words_per_query = 3;
+    // 0 - не загружать корпус, сервер уже заполнен
+    size_t document_count = 10000;
+    uint64_t seed = 42;
+};
+
+class Connection {
+public:
+    explicit Connection(const LoadOptions& options) {
+        if (options.unix_path.empty()) {
+            fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = htons(options.port);
+            Check(fd_ >= 0 && connect(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+            const int enable = 1;
+            setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        } else {
+            fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            strncpy(address.sun_path, options.unix_path.c_str(), sizeof(address.sun_path) - 1);
+            Check(fd_ >= 0 && connect(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+        }
+    }
+
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    ~Connection() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    void Send(string_view data) {
+        while (!data.empty()) {
+            const ssize_t size = send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+            Check(size > 0);
+            data.remove_prefix(static_cast<size_t>(size));
+        }
+    }
+
+    // Читает одну строку ответа без '\n'
+    string_view ReceiveLine() {
+        input_.erase(0, consumed_);
+        consumed_ = 0;
+        size_t newline;
+        while ((newline = input_.find('\n')) == string::npos) {
+            char buffer[64 * 1024];
+            const ssize_t size = read(fd_, buffer, sizeof(buffer));
+            Check(size > 0);
+            input_.append(buffer, static_cast<size_t>(size));
+        }
+        consumed_ = newline + 1;
+        return string_view(input_).substr(0, newline);
+    }
+
+private:
+    int fd_ = -1;
+    string input_;
+    size_t consumed_ = 0;
+
+    static void Check(bool ok) {
+        if (!ok) {
+            throw system_error(errno, generic_category(), "load generator connection"s);
+        }
+    }
+};
+
+void CheckResponse(string_view response) {
+    if (response.rfind("OK"sv, 0) != 0) {
+        throw runtime_error("server replied: "s + string(response));
+    }
+}
+
+void LoadCorpus(const LoadOptions& options, CorpusGenerator& generator) {
+    Connection connection(options);
+    const vector<GeneratedDocument> documents = generator.GenerateDocuments();
+    // Отправляем пачками, чтобы не упереться в буферы сокета
+    constexpr size_t CHUNK_SIZE = 256;
+    for (size_t begin = 0; begin < documents.size(); begin += CHUNK_SIZE) {
+        const size_t end = min(documents.size(), begin + CHUNK_SIZE);
+        string chunk;
+        for (size_t i = begin; i < end; ++i) {
+            const GeneratedDocument& document = documents[i];
+            chunk += FormatAddCommand(document.id, document.status, document.ratings, document.text);
+        }
+        connection.Send(chunk);
+        for (size_t i = begin; i < end; ++i) {
+            CheckResponse(connection.ReceiveLine());
+        }
+    }
+}
+
+void RunClient(const LoadOptions& options, const vector<string>& queries, LatencyHistogram& latencies) {
+    using Clock = chrono::steady_clock;
+    Connection connection(options);
+    string batch;
+    for (size_t begin = 0; begin < queries.size(); begin += options.pipeline_depth) {
+        const size_t end = min(queries.size(), begin + options.pipeline_depth);
+        batch.clear();
+        for (size_t i = begin; i < end; ++i) {
+            batch += "QUERY "s;
+            batch += queries[i];
+            batch += '\n';
+        }
+
+        const Clock::time_point sent = Clock::now();
+        connection.Send(batch);
+        for (size_t i = begin; i < end; ++i) {
+            CheckResponse(connection.ReceiveLine());
+            latencies.Record(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - sent).count());
+        }
+    }
+}
+
+} // namespace
+
+// Нагрузочный клиент для search_server_daemon. Параметры:
+//   --port=<порт>, --unix=<путь>          куда подключаться (по умолчанию порт 7700)
+//   --connections=<число соединений>
+//   --queries=<запросов на соединение>
+//   --pipeline=<запросов без ожидания ответа>
+//   --words=<слов в запросе>
+//   --documents=<документов для загрузки, 0 - не загружать>
+//   --seed=<seed генератора корпуса>
+int main(int argc, char* argv[]) {
+    LoadOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const string_view arg = argv[i];
+        const auto value = [arg](string_view prefix) {
+            return string(arg.substr(prefix.size()));
+        };
+        if (arg.rfind("--port="sv, 0) == 0) {
+            options.port = static_cast<uint16_t>(stoul(value("--port="sv)));
+        } else if (arg.rfind("--unix="sv, 0) == 0) {
+            options.unix_path = value("--unix="sv);
+        } else if (arg.rfind("--connections="sv, 0) == 0) {
+            options.connections = stoul(value("--connections="sv));
+        } else if (arg.rfind("--queries="sv, 0) == 0) {
+            options.queries_per_connection = stoul(value("--queries="sv));
+        } else if (arg.rfind("--pipeline="sv, 0) == 0) {
+            options.pipeline_depth = max<size_t>(1, stoul(value("--pipeline="sv)));
+        } else if (arg.rfind("--words="sv, 0) == 0) {
+            options.words_per_query = stoul(value("--words="sv));
+        } else if (arg.rfind("--documents="sv, 0) == 0) {
+            options.document_count = stoul(value("--documents="sv));
+        } else if (arg.rfind("--seed="sv, 0) == 0) {
+            options.seed = stoull(value("--seed="sv));
+        } else {
+            cerr << "Unknown argument: "s << arg << endl;
+            return 1;
+        }
+    }
+
+    CorpusOptions corpus_options;
+    corpus_options.seed = options.seed;
+    corpus_options.document_count = options.document_count;
+    CorpusGenerator generator(corpus_options);
+    if (options.document_count > 0) {
+        LoadCorpus(options, generator);
+    }
+
+    vector<vector<string>> queries;
+    for (size_t i = 0; i < options.connections; ++i) {
+        queries.push_back(generator.GenerateQueries(options.queries_per_connection, options.words_per_query, 0.1));
+    }
+
+    vector<LatencyHistogram> latencies(options.connections);
+    atomic<bool> failed = false;
+    const auto start = chrono::steady_clock::now();
+    vector<thread> clients;
+    for (size_t i = 0; i < options.connections; ++i) {
+        clients.emplace_back([&, i] {
+            try {
+                RunClient(options, queries[i], latencies[i]);
+            } catch (const exception& e) {
+                cerr << "Client "s << i << ": "s << e.what() << endl;
+                failed = true;
+            }
+        });
+    }
+    for (thread& client : clients) {
+        client.join();
+    }
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    HistogramSnapshot total;
+    for (const LatencyHistogram& histogram : latencies) {
+        total.Add(histogram);
+    }
+    const auto to_us = [](uint64_t ns) {
+        return ns / 1000.0;
+    };
+    cout << fixed << setprecision(1);
+    cout << "queries: "s << total.GetTotalCount()
+         << ", throughput: "s << total.GetTotalCount() / elapsed.count() << " q/s"s
+         << ", p50: "s << to_us(total.GetPercentile(0.5)) << " us"s
+         << ", p99: "s << to_us(total.GetPercentile(0.99)) << " us"s
+         << ", max: "s << to_us(total.GetMax()) << " us"s << endl;
+    return failed ? 1 : 0;
+}
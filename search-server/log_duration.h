@@ -7,7 +7,7 @@
 #define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
 #define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
 #define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
-#define LOG_DURATION(x, os) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
+#define LOG_DURATION(x, os) LogDuration UNIQUE_VAR_NAME_PROFILE(x, os)
 
 class LogDuration {
 public:
@@ -30,5 +30,5 @@ public:
 private:
     const Clock::time_point start_time_ = Clock::now();
     const std::string desc_;
-    const std::ostream& os_;
+    std::ostream& os_;
 };
@@ -4,6 +4,17 @@
 #include "request_queue.h"
 #include "paginator.h"
 #include "process_queries.h"
+#include "query_trace.h"
+#include "async_search_server.h"
+#include "query_protocol.h"
+#include "corpus_loader.h"
+#include "concurrent_map.h"
+#include "roaring_bitmap.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
 
 using namespace std;
 
@@ -606,6 +617,1374 @@ void TestFindTopParWithoutLambda() {
     }
 }
 
+void TestLatencyHistogram() {
+    HistogramSnapshot histogram;
+    for (uint64_t value = 1; value <= 1000; ++value) {
+        histogram.Record(value * 1000);
+    }
+
+    ASSERT_EQUAL(histogram.GetTotalCount(), 1000u);
+    ASSERT(abs(static_cast<double>(histogram.GetPercentile(0.5)) - 500000.0) / 500000.0 < 0.035);
+    ASSERT(abs(static_cast<double>(histogram.GetPercentile(0.99)) - 990000.0) / 990000.0 < 0.035);
+    ASSERT(histogram.GetPercentile(0.999) <= histogram.GetMax());
+    ASSERT_EQUAL(HistogramSnapshot().GetPercentile(0.5), 0u);
+    ASSERT_EQUAL(LatencyHistogram::BucketUpperBound(LatencyHistogram::BucketIndex(17)), 17u);
+}
+
+void TestMemoryStats() {
+    SearchServer server("in the"s);
+    ASSERT_EQUAL(server.GetMemoryStats().GetTotalBytes(), 0u);
+
+    server.AddDocument(42, "cat in the city"s, DocumentStatus::ACTUAL, {1, 5, 2});
+    server.AddDocument(11, "dog in the big city, which never sleeps at all"s, DocumentStatus::ACTUAL, {1, 1, 1});
+
+    const IndexMemoryStats stats = server.GetMemoryStats();
+    ASSERT_EQUAL(stats.document_count, 2u);
+    ASSERT_EQUAL(stats.term_count, 10u);
+    ASSERT_EQUAL(stats.posting_count, 10u);
+    ASSERT_EQUAL(stats.empty_posting_lists, 0u);
+    ASSERT(stats.document_bytes > 0);
+    ASSERT(stats.dictionary_bytes > 0);
+    ASSERT(stats.posting_bytes > 0);
+    ASSERT(stats.reverse_index_bytes > 0);
+    ASSERT(stats.document_id_bytes > 0);
+    ASSERT(stats.attribute_bytes > 0);
+    ASSERT(stats.status_document_bytes > 0);
+    ASSERT_EQUAL(stats.minus_cache_bytes, 0u);
+
+    // Карта минус-слова кэшируется со второго запроса и учитывается, пока индекс не изменится
+    for (int i = 0; i < MINUS_CACHE_MIN_REQUESTS; ++i) {
+        server.FindTopDocuments("city -cat"s);
+    }
+    const size_t cached_bytes = server.GetMemoryStats().minus_cache_bytes;
+    ASSERT(cached_bytes > 0);
+
+    server.RemoveDocument(11);
+    // Остаётся только счётчик запросов слова
+    server.FindTopDocuments("city -cat"s);
+    ASSERT(server.GetMemoryStats().minus_cache_bytes < cached_bytes);
+    const IndexMemoryStats after_remove = server.GetMemoryStats();
+    ASSERT_EQUAL(after_remove.document_count, 1u);
+    ASSERT_EQUAL(after_remove.term_count, 10u);
+    ASSERT_EQUAL(after_remove.posting_count, 2u);
+    ASSERT_EQUAL(after_remove.empty_posting_lists, 8u);
+    ASSERT(after_remove.document_bytes < stats.document_bytes);
+    ASSERT(after_remove.posting_bytes < stats.posting_bytes);
+    ASSERT(after_remove.reverse_index_bytes < stats.reverse_index_bytes);
+    ASSERT_EQUAL(after_remove.dictionary_bytes, stats.dictionary_bytes);
+}
+
+void TestMoveAssignment() {
+    SearchServer target("in the"s);
+    target.AddDocument(1, "white cat in the city"s, DocumentStatus::ACTUAL, {3});
+    target.AddDocument(2, "black dog"s, DocumentStatus::ACTUAL, {1});
+    {
+        SearchServer source("and"s);
+        source.AddDocument(7, "fluffy cat and collar"s, DocumentStatus::ACTUAL, {5});
+        source.AddDocument(8, "groomed dog"s, DocumentStatus::BANNED, {2});
+        const IndexMemoryStats source_stats = source.GetMemoryStats();
+        target = std::move(source);
+        ASSERT_EQUAL(target.GetMemoryStats().GetTotalBytes(), source_stats.GetTotalBytes());
+    }
+
+    // Прежние документы target удалены, счётчики переехали вместе с контейнерами
+    ASSERT_EQUAL(target.GetDocumentCount(), 2);
+    ASSERT(target.FindTopDocuments("white"s).empty());
+    ASSERT_EQUAL(target.FindTopDocuments("cat"s)[0].id, 7);
+    target.AddDocument(9, "white cat"s, DocumentStatus::ACTUAL, {1});
+    target.RemoveDocument(7);
+    target.RemoveDocument(8);
+    ASSERT_EQUAL(target.FindTopDocuments("cat"s)[0].id, 9);
+    ASSERT_EQUAL(target.GetMemoryStats().document_count, 1u);
+
+    target = SearchServer("in"s);
+    ASSERT_EQUAL(target.GetMemoryStats().GetTotalBytes(), 0u);
+}
+
+void TestBm25Ranking() {
+    SearchServer server("in the"s);
+    server.AddDocument(42, "cat in the city"s, DocumentStatus::ACTUAL, {1, 5, 2});
+    server.AddDocument(11, "dog in the city scary"s, DocumentStatus::ACTUAL, {1, 1, 1});
+    server.AddDocument(1, "pretty dog in the city"s, DocumentStatus::ACTUAL, {4, 2, 3});
+    server.AddDocument(2, "pretty cat in the city"s, DocumentStatus::ACTUAL, {5, 5, 4});
+
+    // Короткий документ получает больший вес при той же частоте слова
+    const auto bm25_docs = server.FindTopDocuments(Bm25Scorer(), "cat"s);
+    ASSERT_EQUAL(bm25_docs.size(), 2u);
+    ASSERT_EQUAL(bm25_docs[0].id, 42);
+    ASSERT(abs(bm25_docs[0].relevance - 0.780194) < ACCURACY);
+    ASSERT_EQUAL(bm25_docs[1].id, 2);
+    ASSERT(abs(bm25_docs[1].relevance - 0.668293) < ACCURACY);
+
+    const auto par_docs = server.FindTopDocuments(std::execution::par, Bm25Scorer(1.2, 0.75), "cat"s);
+    ASSERT_EQUAL(par_docs.size(), 2u);
+    ASSERT_EQUAL(par_docs[0].relevance, bm25_docs[0].relevance);
+
+    const auto tf_idf_docs = server.FindTopDocuments(TfIdfScorer(), "cat dog -pretty scary"s);
+    const auto default_docs = server.FindTopDocuments("cat dog -pretty scary"s);
+    ASSERT_EQUAL(tf_idf_docs.size(), default_docs.size());
+    for (size_t i = 0; i < default_docs.size(); ++i) {
+        ASSERT_EQUAL(tf_idf_docs[i].id, default_docs[i].id);
+        ASSERT_EQUAL(tf_idf_docs[i].relevance, default_docs[i].relevance);
+    }
+
+    ASSERT(server.FindTopDocuments(Bm25Scorer(), "cat"s, DocumentStatus::BANNED).empty());
+}
+
+void TestStatusFilterFastPath() {
+    SearchServer server("in the"s);
+    server.AddDocument(42, "cat in the city"s, DocumentStatus::ACTUAL, {1, 5, 2});
+    server.AddDocument(100000, "cat and dog"s, DocumentStatus::BANNED, {1, 1, 1});
+    server.AddDocument(3, "pretty cat"s, DocumentStatus::ACTUAL, {4, 2, 3});
+    server.AddDocument(4, "scary cat"s, DocumentStatus::ACTUAL, {4, 2, 3});
+
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), 3u);
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s, DocumentStatus::BANNED).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments(std::execution::par, "cat"s, DocumentStatus::BANNED)[0].id, 100000);
+
+    server.RemoveDocument(100000);
+    ASSERT(server.FindTopDocuments("cat"s, DocumentStatus::BANNED).empty());
+    server.AddDocument(100000, "cat and dog"s, DocumentStatus::IRRELEVANT, {1, 1, 1});
+    ASSERT(server.FindTopDocuments("cat"s, DocumentStatus::BANNED).empty());
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s, DocumentStatus::IRRELEVANT).size(), 1u);
+
+    // Предикат вызывается один раз на кандидата, оставшегося после минус-слов
+    int calls = 0;
+    const auto docs = server.FindTopDocuments("cat city pretty -scary"s, [&calls](int document_id, DocumentStatus status, int rating) {
+        ++calls;
+        return status == DocumentStatus::ACTUAL;
+    });
+    ASSERT_EQUAL(docs.size(), 2u);
+    ASSERT_EQUAL(calls, 3);
+}
+
+void TestMatchDocuments() {
+    SearchServer server("in the"s);
+    server.AddDocument(42, "cat in the city"s, DocumentStatus::ACTUAL, {1, 5, 2});
+    server.AddDocument(11, "dog in the city scary"s, DocumentStatus::IRRELEVANT, {1, 1, 1});
+    server.AddDocument(1, "pretty dog in the city"s, DocumentStatus::ACTUAL, {4, 2, 3});
+
+    vector<SearchServer::MatchResult> results;
+    {
+        const string query = "city dog cat -pretty"s;
+        results = server.MatchDocuments(std::execution::par, query, {42, 11, 1});
+    }
+    ASSERT_EQUAL(results.size(), 3u);
+    // Слова ссылаются на словарь сервера и переживают строку запроса
+    ASSERT(get<0>(results[0]) == vector<string_view>({"cat"sv, "city"sv}));
+    ASSERT(get<1>(results[1]) == DocumentStatus::IRRELEVANT);
+    ASSERT(get<0>(results[1]) == vector<string_view>({"city"sv, "dog"sv}));
+    ASSERT(get<0>(results[2]).empty());
+
+    const auto single = server.MatchDocuments("city scary"s, {11});
+    ASSERT(get<0>(single[0]) == get<0>(server.MatchDocument(std::execution::par, "city scary"s, 11)));
+
+    try {
+        server.MatchDocuments("city"s, {42, 7});
+        ASSERT_HINT(false, "MatchDocuments must reject unknown ids"s);
+    } catch (const out_of_range&) {
+    }
+}
+
+void TestPhraseQueries() {
+    SearchServer server("in the"s);
+    server.AddDocument(1, "big cat in the city"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "cat is big"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "big fluffy grey cat"s, DocumentStatus::ACTUAL, {3});
+    server.AddDocument(5, "white dog"s, DocumentStatus::ACTUAL, {5});
+
+    try {
+        server.FindTopDocuments("\"big cat\""s);
+        ASSERT_HINT(false, "phrases need the positional index"s);
+    } catch (const logic_error&) {
+    }
+
+    // Индекс строится по уже добавленным документам
+    server.SetPositionalIndexEnabled(true);
+    server.AddDocument(4, "small dog and big cat"s, DocumentStatus::ACTUAL, {4});
+
+    const auto exact = server.FindTopDocuments("\"big cat\""s);
+    ASSERT_EQUAL(exact.size(), 2u);
+    ASSERT(exact[0].id == 1 || exact[0].id == 4);
+    ASSERT(exact[1].id == 1 || exact[1].id == 4);
+
+    // Стоп-слова внутри фразы пропускаются и в документе, и в запросе
+    ASSERT_EQUAL(server.FindTopDocuments("\"cat in the city\""s).size(), 1u);
+
+    const auto sloppy = server.FindTopDocuments("\"big cat\"~2"s);
+    ASSERT_EQUAL(sloppy.size(), 3u);
+    // Точное вхождение ранжируется выше вхождения с разрывом
+    ASSERT(sloppy.back().id == 3);
+
+    ASSERT(get<0>(server.MatchDocument("\"big cat\" city"s, 1)) == vector<string_view>({"big"sv, "cat"sv, "city"sv}));
+    ASSERT(get<0>(server.MatchDocument("\"big cat\""s, 2)).empty());
+
+    server.RemoveDocument(std::execution::par, 1);
+    ASSERT_EQUAL(server.FindTopDocuments("\"big cat\""s).size(), 1u);
+
+    for (const string query : {"\"big cat"s, "-\"big cat\""s, "\"big cat\"x"s, "\"big -cat\""s, "\"big +cat\""s,
+                               "\"big cat*\""s, "\"-big cat\""s}) {
+        try {
+            server.FindTopDocuments(query);
+            ASSERT_HINT(false, "malformed phrase must be rejected: "s + query);
+        } catch (const invalid_argument&) {
+        }
+    }
+}
+
+void TestPrefixQueries() {
+    SearchServer server("in the"s);
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "catalog of cities"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "dog in the town"s, DocumentStatus::ACTUAL, {3});
+    server.AddDocument(4, "caterpillar"s, DocumentStatus::ACTUAL, {4});
+
+    ASSERT_EQUAL(server.FindTopDocuments("cat*"s).size(), 3u);
+    ASSERT_EQUAL(server.FindTopDocuments("cit*"s).size(), 2u);
+    ASSERT_EQUAL(server.FindTopDocuments("cat* -caterp*"s).size(), 2u);
+    ASSERT(server.FindTopDocuments("zebra*"s).empty());
+    ASSERT(get<0>(server.MatchDocument("ci* do*"s, 1)) == vector<string_view>({"city"sv}));
+
+    // Слово удалённого документа остаётся в словаре, но не подставляется
+    server.RemoveDocument(4);
+    ASSERT_EQUAL(server.FindTopDocuments("cat*"s).size(), 2u);
+
+    SearchServer many(""s);
+    for (int id = 0; id < MAX_PREFIX_EXPANSIONS + 10; ++id) {
+        many.AddDocument(id, "w"s + to_string(id), DocumentStatus::ACTUAL, {id});
+    }
+    int matched = 0;
+    for (const int id : many) {
+        matched += get<0>(many.MatchDocument("w*"s, id)).empty() ? 0 : 1;
+    }
+    ASSERT_EQUAL(matched, MAX_PREFIX_EXPANSIONS);
+
+    for (const string query : {"*"s, "-*"s}) {
+        try {
+            server.FindTopDocuments(query);
+            ASSERT_HINT(false, "empty prefix must be rejected"s);
+        } catch (const invalid_argument&) {
+        }
+    }
+}
+
+void TestFuzzyQueries() {
+    SearchServer server("in the"s);
+    server.AddDocument(1, "white cat in the city"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "black dog in the town"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "white parrot"s, DocumentStatus::ACTUAL, {3});
+
+    // По умолчанию опечатки не исправляются
+    ASSERT(server.FindTopDocuments("whte"s).empty());
+
+    server.SetFuzzyOptions({1, 8, 0.5});
+    const auto fixed = server.FindTopDocuments("whte"s);
+    ASSERT_EQUAL(fixed.size(), 2u);
+    ASSERT(get<0>(server.MatchDocument("whte cat"s, 1)) == vector<string_view>({"cat"sv, "white"sv}));
+
+    // Исправленное слово весит меньше точного
+    const auto exact = server.FindTopDocuments("white"s);
+    ASSERT(abs(fixed[0].relevance - exact[0].relevance * 0.5) < ACCURACY);
+
+    // Слово с документами не исправляется, короткие слова - тоже
+    ASSERT(server.FindTopDocuments("town"s).size() == 1u);
+    ASSERT(server.FindTopDocuments("dg"s).empty());
+    // Две правки при max_edits = 1 не находятся
+    ASSERT(server.FindTopDocuments("pirrat"s).empty());
+    server.SetFuzzyOptions({2, 8, 0.5});
+    ASSERT_EQUAL(server.FindTopDocuments("pirrat"s).size(), 1u);
+    // Минус-слова применяются и к исправленным словам
+    ASSERT(server.FindTopDocuments("whte -city -parrot"s).empty());
+
+    server.SetFuzzyOptions({2, 0, 0.5});
+    ASSERT(server.FindTopDocuments("whte"s).empty());
+
+    try {
+        server.SetFuzzyOptions({3, 8, 0.5});
+        ASSERT_HINT(false, "max_edits above 2 must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestTextAnalyzer() {
+    const auto analyze = [](string word) {
+        word.resize(DefaultTextAnalyzer::Analyze(word.data(), word.size()));
+        return word;
+    };
+    ASSERT_EQUAL(analyze("Cats,"s), "cat"s);
+    ASSERT_EQUAL(analyze("PONIES"s), "pony"s);
+    ASSERT_EQUAL(analyze("glass"s), "glass"s);
+    ASSERT_EQUAL(analyze("Ёжик!"s), "ёжик"s);
+    ASSERT_EQUAL(analyze("..."s), ""s);
+    ASSERT_EQUAL(TextAnalyzer<>::Analyze(nullptr, 0), 0u);
+
+    SearchServer server("The in"s, DefaultTextAnalyzer::Analyze);
+    server.AddDocument(1, "  The Cat in the CITY,  "s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "cats and dogs !!! "s, DocumentStatus::ACTUAL, {2});
+
+    // "Cat", "cats" и "cat" попадают в один список постингов
+    ASSERT_EQUAL(server.GetMemoryStats().term_count, 4u);
+    ASSERT_EQUAL(server.FindTopDocuments("CAT"s).size(), 2u);
+    ASSERT_EQUAL(server.FindTopDocuments("city -Dogs"s).size(), 1u);
+    ASSERT(server.FindTopDocuments("THE !!!"s).empty());
+    ASSERT(get<0>(server.MatchDocument("Cats, city"s, 1)) == vector<string_view>({"cat"sv, "city"sv}));
+    ASSERT_EQUAL(server.FindTopDocuments("Do*"s).size(), 1u);
+
+    server.SetPositionalIndexEnabled(true);
+    ASSERT_EQUAL(server.FindTopDocuments("\"Cats in the City\""s).size(), 1u);
+
+    // Без анализатора слова не меняются
+    SearchServer plain("in the"s);
+    plain.AddDocument(1, "The Cat in the CITY,"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(plain.FindTopDocuments("cat"s).empty());
+}
+
+void TestStopWordSet() {
+    ASSERT(!StopWordSet().Contains("a"sv));
+    ASSERT(!StopWordSet().Contains(""sv));
+
+    set<string, less<>> words;
+    for (int i = 0; i < 1000; ++i) {
+        words.insert("w"s + to_string(i * 7));
+    }
+    words.insert(string(100, 'x'));
+    const StopWordSet stop_words(words);
+    ASSERT_EQUAL(stop_words.size(), words.size());
+    for (const string& word : words) {
+        ASSERT_HINT(stop_words.Contains(word), word);
+    }
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT(!stop_words.Contains("w"s + to_string(i * 7 + 1)));
+    }
+    ASSERT(!stop_words.Contains(string(99, 'x')));
+    ASSERT(!stop_words.Contains(string(101, 'x')));
+    ASSERT(!stop_words.Contains("w"sv));
+}
+
+void TestAsyncSearchServer() {
+    SearchServer server("in the"s);
+    server.AddDocument(1, "white cat in the city"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "black dog in the town"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "white parrot"s, DocumentStatus::ACTUAL, {3});
+
+    const vector<string> queries = {"white"s, "dog city"s, "parrot -white"s, "black cat"s, "town"s};
+    {
+        // Окно большое: пакет отправляется, как только наберётся max_batch_size запросов
+        AsyncSearchServer async_server(server, {16, queries.size(), chrono::seconds(10), OverflowPolicy::BLOCK});
+        vector<future<vector<Document>>> futures;
+        for (const string& query : queries) {
+            futures.push_back(async_server.FindTopDocumentsAsync(query));
+        }
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const auto expected = server.FindTopDocuments(queries[i]);
+            const auto actual = futures[i].get();
+            ASSERT_EQUAL(actual.size(), expected.size());
+            for (size_t j = 0; j < actual.size(); ++j) {
+                ASSERT_EQUAL(actual[j].id, expected[j].id);
+            }
+        }
+        ASSERT(async_server.GetBatchSizes() == vector<size_t>({queries.size()}));
+    }
+    {
+        // Ошибка в одном запросе пакета достаётся только ему
+        AsyncSearchServer async_server(server, {16, 2, chrono::seconds(10), OverflowPolicy::BLOCK});
+        auto bad = async_server.FindTopDocumentsAsync("--cat"s);
+        auto good = async_server.FindTopDocumentsAsync("cat"s);
+        ASSERT_EQUAL(good.get().size(), 1u);
+        try {
+            bad.get();
+            ASSERT_HINT(false, "invalid query must fail its future"s);
+        } catch (const invalid_argument&) {
+        }
+    }
+    {
+        // Первый запрос ждёт в очереди, пока не истечёт окно, второй не помещается
+        AsyncSearchServer async_server(server, {1, 64, chrono::seconds(10), OverflowPolicy::REJECT});
+        auto accepted = async_server.FindTopDocumentsAsync("cat"s);
+        try {
+            async_server.FindTopDocumentsAsync("dog"s);
+            ASSERT_HINT(false, "full queue must reject"s);
+        } catch (const QueueOverflowError&) {
+        }
+        // Деструктор выполняет уже принятые запросы
+    }
+}
+
+void TestFindTopDocumentsBatch() {
+    SearchServer server("and in on the"s);
+    const vector<string> texts = {
+        "white cat and fancy collar"s, "fluffy cat fluffy tail"s, "groomed dog expressive eyes"s,
+        "groomed starling evgeny"s, "white dog in the city"s, "cat on the roof"s, "big dog big bone"s,
+    };
+    for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+        const auto status = id == 3 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        // Разрывы в id проверяют разбиение на диапазоны
+        server.AddDocument(id * 1000 + id, texts[id], status, {id, 2 * id});
+    }
+    server.SetPositionalIndexEnabled(true);
+    server.SetFuzzyOptions({1, 4, 0.5});
+
+    const vector<string> queries = {
+        "fluffy groomed cat"s, "cat -collar"s, "dog"s, "white dog -city"s, "evgeny"s,
+        "\"fluffy tail\""s, "cat*"s, "grooomed"s, "nothing"s, "big dog cat -roof"s,
+    };
+    for (const auto& results : {server.FindTopDocumentsBatch(queries),
+                                server.FindTopDocumentsBatch(std::execution::par, queries),
+                                ProcessQueries(server, queries)}) {
+        ASSERT_EQUAL(results.size(), queries.size());
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const auto expected = server.FindTopDocuments(queries[i]);
+            ASSERT_EQUAL_HINT(results[i].size(), expected.size(), queries[i]);
+            for (size_t j = 0; j < expected.size(); ++j) {
+                ASSERT_EQUAL(results[i][j].id, expected[j].id);
+                // Порядок сложения тот же, поэтому сравнение точное
+                ASSERT(results[i][j].relevance == expected[j].relevance);
+                ASSERT_EQUAL(results[i][j].rating, expected[j].rating);
+            }
+        }
+    }
+
+    ASSERT(SearchServer(""s).FindTopDocumentsBatch({"cat"s})[0].empty());
+    try {
+        server.FindTopDocumentsBatch({"cat"s, "--dog"s});
+        ASSERT_HINT(false, "invalid query must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    vector<exception_ptr> errors;
+    const auto partial = ProcessQueries(server, {"cat"s, "--dog"s}, errors);
+    ASSERT(!partial[0].empty() && !errors[0] && errors[1]);
+    // Ошибка одного запроса не отменяет пакетного выполнения остальных
+    const vector<string> mixed = {"dog"s, "\"big -cat\""s, "white dog -city"s, "cat -"s};
+    vector<exception_ptr> par_errors;
+    const auto seq_results = server.FindTopDocumentsBatch(std::execution::seq, mixed, errors);
+    const auto par_results = server.FindTopDocumentsBatch(std::execution::par, mixed, par_errors);
+    for (const auto& [results, batch_errors] : {pair{seq_results, errors}, pair{par_results, par_errors}}) {
+        ASSERT(batch_errors.size() == mixed.size() && !batch_errors[0] && batch_errors[1] && !batch_errors[2] && batch_errors[3]);
+        ASSERT(results[1].empty() && results[3].empty());
+        for (const size_t i : {0u, 2u}) {
+            const auto expected = server.FindTopDocuments(mixed[i]);
+            ASSERT_EQUAL_HINT(results[i].size(), expected.size(), mixed[i]);
+            for (size_t j = 0; j < expected.size(); ++j) {
+                ASSERT(results[i][j].id == expected[j].id && results[i][j].relevance == expected[j].relevance);
+            }
+        }
+        try {
+            rethrow_exception(batch_errors[1]);
+        } catch (const invalid_argument&) {
+        }
+    }
+}
+
+void TestQueryProtocol() {
+    const Command add = ParseCommand("ADD 7 BANNED 1,-2,3 white  cat\r"sv);
+    ASSERT(add.type == CommandType::ADD && IsWriteCommand(add.type));
+    ASSERT_EQUAL(add.document_id, 7);
+    ASSERT(add.status == DocumentStatus::BANNED);
+    ASSERT(add.ratings == vector<int>({1, -2, 3}));
+    ASSERT_EQUAL(add.text, "white  cat"sv);
+    ASSERT_EQUAL(FormatAddCommand(7, DocumentStatus::BANNED, {1, -2, 3}, "white  cat"sv),
+                 "ADD 7 BANNED 1,-2,3 white  cat\n"s);
+    ASSERT(ParseCommand("ADD 8 ACTUAL - dog"sv).ratings.empty());
+    ASSERT_EQUAL(ParseCommand("MATCH 3 cat -dog"sv).text, "cat -dog"sv);
+    ASSERT(!IsWriteCommand(ParseCommand("QUERY cat"sv).type));
+
+    for (const string_view bad : {"FIND cat"sv, "ADD x ACTUAL - cat"sv, "ADD 1 GOOD - cat"sv,
+                                  "ADD 1 ACTUAL 1,,2 cat"sv, "REMOVE 1 2"sv, "MATCH cat"sv, ""sv}) {
+        try {
+            ParseCommand(bad);
+            ASSERT_HINT(false, string(bad));
+        } catch (const invalid_argument&) {
+        }
+    }
+
+    // Хвост без '\n' не обрабатывается
+    vector<string_view> lines;
+    const string_view buffer = "QUERY cat\n\nREMOVE 1\nQUERY d"sv;
+    ASSERT_EQUAL(ForEachLine(buffer, [&lines](string_view line) { lines.push_back(line); }), 20u);
+    ASSERT(lines == vector<string_view>({"QUERY cat"sv, ""sv, "REMOVE 1"sv}));
+
+    SearchServer server("in the"s);
+    ASSERT_EQUAL(ExecuteCommand(server, ParseCommand("ADD 1 ACTUAL 4,6 white cat in the city"sv)), "OK\n"s);
+    ASSERT_EQUAL(ExecuteCommand(server, ParseCommand("ADD 2 ACTUAL - black dog"sv)), "OK\n"s);
+    ASSERT_EQUAL(ExecuteCommand(server, ParseCommand("QUERY cat -dog"sv)),
+                 FormatQueryResponse(server.FindTopDocuments("cat"s)));
+    ASSERT_EQUAL(ExecuteCommand(server, ParseCommand("MATCH 1 city cat -dog"sv)), "OK ACTUAL cat city\n"s);
+    ASSERT_EQUAL(ExecuteCommand(server, ParseCommand("ADD 1 ACTUAL - cat"sv)).rfind("ERROR "s, 0), 0u);
+    ASSERT_EQUAL(ExecuteCommand(server, ParseCommand("QUERY --cat"sv)).rfind("ERROR "s, 0), 0u);
+    ASSERT_EQUAL(ExecuteCommand(server, ParseCommand("REMOVE 1"sv)), "OK\n"s);
+    ASSERT_EQUAL(ExecuteCommand(server, ParseCommand("QUERY cat"sv)), "OK 0\n"s);
+}
+
+void TestCorpusLoader() {
+    SearchServer expected("in the"s);
+    expected.AddDocument(1, "white cat in the city"s, DocumentStatus::ACTUAL, {4, 6});
+    expected.AddDocument(2, "black dog"s, DocumentStatus::BANNED, {});
+    expected.AddDocument(10, "fluffy cat \"tail\""s, DocumentStatus::ACTUAL, {-1});
+    expected.AddDocument(11, "caf\xc3\xa9 dog"s, DocumentStatus::ACTUAL, {2, 3});
+
+    const auto check_same = [&expected](const SearchServer& server) {
+        ASSERT_EQUAL(server.GetDocumentCount(), expected.GetDocumentCount());
+        for (const string& query : {"cat"s, "dog -white"s, "\"tail\" city"s, "caf\xc3\xa9"s}) {
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                const auto actual_documents = server.FindTopDocuments(query, status);
+                const auto expected_documents = expected.FindTopDocuments(query, status);
+                ASSERT_EQUAL_HINT(actual_documents.size(), expected_documents.size(), query);
+                for (size_t i = 0; i < actual_documents.size(); ++i) {
+                    ASSERT_EQUAL(actual_documents[i].id, expected_documents[i].id);
+                    ASSERT(actual_documents[i].relevance == expected_documents[i].relevance);
+                    ASSERT_EQUAL(actual_documents[i].rating, expected_documents[i].rating);
+                }
+            }
+        }
+    };
+    const auto path = filesystem::temp_directory_path() / "search_server_test_corpus"s;
+    const auto load = [&path](const string& content, CorpusFormat format) {
+        ofstream(path, ios::binary) << content;
+        SearchServer server("in the"s);
+        // Маленькие куски и волны проверяют разрезание по границам строк
+        ASSERT_EQUAL(LoadCorpus(server, path.string(), {format, 16, 2}), 4u);
+        return server;
+    };
+
+    // Пустая строка, "\r\n" и последняя строка без '\n'
+    check_same(load("1\tACTUAL\t4,6\twhite cat in the city\n2\tBANNED\t\tblack dog\r\n\n"
+                    "10\tACTUAL\t-1\tfluffy cat \"tail\"\n11\tACTUAL\t2,3\tcaf\xc3\xa9 dog"s, CorpusFormat::TSV));
+    // Порядок полей произвольный, неизвестные поля пропускаются
+    check_same(load("{\"id\": 1, \"ratings\": [4, 6], \"text\": \"white cat in the city\"}\n"
+                    "{\"text\": \"black dog\", \"status\": \"BANNED\", \"meta\": {\"tags\": [1, \"x\"]}, \"id\": 2}\n"
+                    "{\"id\":10,\"text\":\"fluffy cat \\\"tail\\\"\",\"ratings\":[-1],\"seen\":true}\n"
+                    "{\"id\": 11, \"text\": \"caf\\u00e9 dog\", \"ratings\": [2,3]}\n"s, CorpusFormat::JSONL));
+
+    for (const auto& [content, format] : {pair{"1\tACTUAL\tcat\n"s, CorpusFormat::TSV},
+                                          pair{"1\tGOOD\t\tcat\n"s, CorpusFormat::TSV},
+                                          pair{"{\"id\": 1}\n"s, CorpusFormat::JSONL},
+                                          pair{"{\"id\": 1, \"text\": \"cat}\n"s, CorpusFormat::JSONL},
+                                          pair{"{\"id\": 1, \"text\": \"cat\"} x\n"s, CorpusFormat::JSONL}}) {
+        ofstream(path, ios::binary) << content;
+        SearchServer server(""s);
+        try {
+            LoadCorpus(server, path.string(), {format});
+            ASSERT_HINT(false, content);
+        } catch (const invalid_argument&) {
+        }
+    }
+    filesystem::remove(path);
+
+    const auto chunks = SplitIntoChunks("ab\ncd\nef\ng"sv, 2);
+    ASSERT(chunks == vector<string_view>({"ab\n"sv, "cd\n"sv, "ef\n"sv, "g"sv}));
+
+    // Ошибка в любой записи пакета оставляет индекс нетронутым
+    SearchServer server("in the"s);
+    server.AddDocuments(std::execution::par, {{1, "white cat"sv, DocumentStatus::ACTUAL, {1}}});
+    for (const vector<DocumentRecord>& bad : {vector<DocumentRecord>{{2, "dog"sv}, {2, "cat"sv}},
+                                              vector<DocumentRecord>{{2, "dog"sv}, {1, "cat"sv}},
+                                              vector<DocumentRecord>{{2, "dog"sv}, {3, "c\x12t"sv}}}) {
+        try {
+            server.AddDocuments(std::execution::par, bad);
+            ASSERT_HINT(false, "invalid batch must be rejected"s);
+        } catch (const invalid_argument&) {
+        }
+        ASSERT_EQUAL(server.GetDocumentCount(), 1);
+    }
+}
+
+void TestSearchCursor() {
+    vector<int> numbers = {5, 1, 9, 3, 7, 2, 8};
+    auto lazy_pages = PaginateLazily(numbers, 3, greater<>());
+    vector<vector<int>> pages;
+    while (lazy_pages.HasNextPage()) {
+        const auto page = lazy_pages.NextPage();
+        pages.emplace_back(page.begin(), page.end());
+    }
+    ASSERT(pages == vector<vector<int>>({{9, 8, 7}, {5, 3, 2}, {1}}));
+    ASSERT_EQUAL(lazy_pages.NextPage().size(), 0);
+
+    SearchServer server("and"s);
+    // Одинаковые тексты дают равную релевантность, порядок решают рейтинг и id
+    for (int id = 0; id < 23; ++id) {
+        const string text = id % 3 == 0 ? "cat and dog"s : (id % 3 == 1 ? "cat cat bird"s : "cat fish fish"s);
+        server.AddDocument(id, text + " "s + to_string(id % 4), DocumentStatus::ACTUAL, {id % 5});
+    }
+    server.AddDocument(100, "cat"s, DocumentStatus::BANNED, {});
+
+    const SearchPage all = server.FindTopDocumentsPage("cat fish -bird"s, 1000);
+    ASSERT(all.next.IsEnd());
+    ASSERT(all.documents.size() > MAX_RESULT_DOCUMENT_COUNT);
+    for (size_t i = 1; i < all.documents.size(); ++i) {
+        const Document& lhs = all.documents[i - 1];
+        const Document& rhs = all.documents[i];
+        ASSERT(tie(lhs.relevance, lhs.rating, rhs.id) > tie(rhs.relevance, rhs.rating, lhs.id));
+    }
+
+    // Курсор передаётся через токен, как его получил бы клиент
+    vector<Document> paged;
+    string token = SearchCursor().ToToken();
+    while (true) {
+        const SearchPage page = server.FindTopDocumentsPage("cat fish -bird"s, 4, SearchCursor::FromToken(token));
+        ASSERT(page.documents.size() <= 4);
+        paged.insert(paged.end(), page.documents.begin(), page.documents.end());
+        if (page.next.IsEnd()) {
+            break;
+        }
+        token = page.next.ToToken();
+    }
+    ASSERT_EQUAL(paged.size(), all.documents.size());
+    for (size_t i = 0; i < paged.size(); ++i) {
+        ASSERT_EQUAL(paged[i].id, all.documents[i].id);
+        ASSERT(paged[i].relevance == all.documents[i].relevance);
+    }
+
+    const SearchPage banned = server.FindTopDocumentsPage("cat"s, DocumentStatus::BANNED, 10);
+    ASSERT(banned.documents.size() == 1 && banned.documents[0].id == 100 && banned.next.IsEnd());
+    ASSERT(server.FindTopDocumentsPage("cat"s, DocumentStatus::BANNED, 10, banned.next).documents.empty());
+
+    const SearchCursor cursor = server.FindTopDocumentsPage("cat"s, 2).next;
+    for (const auto& [query, status] : {pair{"dog"s, DocumentStatus::ACTUAL}, pair{"cat"s, DocumentStatus::BANNED}}) {
+        try {
+            server.FindTopDocumentsPage(query, status, 2, cursor);
+            ASSERT_HINT(false, "cursor of another query must be rejected"s);
+        } catch (const invalid_argument&) {
+        }
+    }
+    for (const string_view bad : {""sv, "1.2.3"sv, "1.2.3.4.5.6"sv, "7.0.0.0.0"sv, "1.x.0.0.0"sv}) {
+        try {
+            SearchCursor::FromToken(bad);
+            ASSERT_HINT(false, string(bad));
+        } catch (const invalid_argument&) {
+        }
+    }
+}
+
+void TestConcurrentMap() {
+    ConcurrentMap<string, int> words(4);
+    words["cat"s].ref_to_value = 1;
+    words.Update("dog"s, [](int& value) { value += 2; });
+    // Поиск по string_view и const char* без построения std::string
+    ASSERT(words.Find("cat"sv) == optional<int>(1));
+    ASSERT(words.Contains("dog"));
+    ASSERT(!words.Find("bird"sv));
+    int visited = 0;
+    ASSERT(words.Visit("dog"sv, [&visited](const int& value) { visited = value; }) && visited == 2);
+    ASSERT_EQUAL(words.Erase("cat"sv), 1u);
+    ASSERT_EQUAL(words.Erase("cat"sv), 0u);
+    ASSERT_EQUAL(words.Size(), 1u);
+
+    // Много ключей в немногих полосах - проверка перехеширования
+    ConcurrentMap<int, int> numbers(3);
+    for (int i = 0; i < 10000; i += 2) {
+        numbers[i].ref_to_value = i;
+    }
+    for (int i = 0; i < 10000; i += 4) {
+        numbers.Erase(i);
+    }
+    ASSERT_EQUAL(numbers.Size(), 2500u);
+    long long sum = 0;
+    numbers.ForEach(std::execution::par, [&sum](int key, int value) {
+        ASSERT_EQUAL(key, value);
+        // Полосы обходятся параллельно
+        static mutex sum_mutex;
+        lock_guard guard(sum_mutex);
+        sum += value;
+    });
+    ASSERT_EQUAL(sum, 2500LL * 5000);
+    const map<int, int> ordinary = numbers.BuildOrdinaryMap();
+    ASSERT(ordinary.size() == 2500u && ordinary.begin()->first == 2 && ordinary.rbegin()->first == 9998);
+
+    ConcurrentMap<int, int> counters(8);
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&counters] {
+            for (int i = 0; i < 10000; ++i) {
+                counters[i % 100].ref_to_value += 1;
+                counters.Find(i % 100);
+            }
+        });
+    }
+    for (thread& thread : threads) {
+        thread.join();
+    }
+    counters.ForEach([](int, int value) {
+        ASSERT_EQUAL(value, 400);
+    });
+}
+
+void TestRoaringBitmap() {
+    RoaringBitmap bitmap;
+    ASSERT(bitmap.IsEmpty());
+    // Массивный контейнер, переполнение в битовую карту и второй контейнер
+    for (uint32_t value = 0; value < 10000; value += 2) {
+        bitmap.Add(value);
+    }
+    bitmap.Add(70000);
+    bitmap.Add(4);
+    ASSERT_EQUAL(bitmap.GetCardinality(), 5001u);
+    ASSERT(bitmap.Contains(9998) && !bitmap.Contains(9999) && bitmap.Contains(70000) && !bitmap.Contains(70002));
+
+    RoaringBitmap other;
+    other.Add(3);
+    other.Add(70000);
+    other.Add(200000);
+    bitmap |= other;
+    ASSERT_EQUAL(bitmap.GetCardinality(), 5003u);
+    ASSERT(bitmap.Contains(3) && bitmap.Contains(200000));
+
+    RoaringBitmap::SequentialReader reader(other);
+    ASSERT(!reader.Contains(1) && reader.Contains(3) && !reader.Contains(69999));
+    ASSERT(reader.Contains(70000) && reader.Contains(200000) && !reader.Contains(300000));
+
+    SearchServer server("and"s);
+    server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "black cat"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "white dog"s, DocumentStatus::ACTUAL, {3});
+    // Повторные запросы идут через кэш битовых карт минус-слов
+    for (int i = 0; i < 3; ++i) {
+        const auto documents = server.FindTopDocuments("cat dog -white"s);
+        ASSERT(documents.size() == 1u && documents[0].id == 2);
+        ASSERT(server.FindTopDocuments(std::execution::par, "cat dog -white -black"s).empty());
+    }
+    // Кэш сбрасывается при изменении индекса
+    server.AddDocument(4, "white cat"s, DocumentStatus::ACTUAL, {4});
+    server.AddDocument(5, "grey cat"s, DocumentStatus::ACTUAL, {5});
+    server.RemoveDocument(2);
+    const auto documents = server.FindTopDocuments(std::execution::par, "cat dog -white"s);
+    ASSERT(documents.size() == 1u && documents[0].id == 5);
+    ASSERT_EQUAL(server.FindTopDocuments("cat -white"s).size(), 1u);
+}
+
+void TestAttributeFilter() {
+    SearchServer server("and"s);
+    // Больше одного блока индекса атрибутов, рейтинг растёт с id
+    const int document_count = 3000;
+    for (int id = 0; id < document_count; ++id) {
+        const DocumentStatus status = id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        server.AddDocument(id, id % 2 ? "white cat"s : "black dog"s, status, {id});
+    }
+
+    const AttributeFilter filter = AttributeFilter().RatingBetween(1000, 1200).StatusIn({DocumentStatus::ACTUAL});
+    const auto predicate = [](int, DocumentStatus status, int rating) {
+        return status == DocumentStatus::ACTUAL && rating >= 1000 && rating <= 1200;
+    };
+    for (const string query : {"cat"s, "cat dog"s, "dog -black"s}) {
+        const auto expected = server.FindTopDocuments(query, predicate);
+        const auto documents = server.FindTopDocuments(query, filter);
+        ASSERT_EQUAL(documents.size(), expected.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ASSERT_EQUAL(documents[i].id, expected[i].id);
+        }
+        const auto par_documents = server.FindTopDocuments(std::execution::par, query, filter);
+        ASSERT_EQUAL(par_documents.size(), expected.size());
+    }
+    ASSERT(server.FindTopDocuments("cat"s, AttributeFilter().RatingBetween(5000, 6000)).empty());
+
+    // Постингов меньше, чем блоков: атрибуты проверяются для каждого постинга
+    server.AddDocument(5000, "rare parrot"s, DocumentStatus::ACTUAL, {1100});
+    server.AddDocument(5001, "rare parrot"s, DocumentStatus::BANNED, {1100});
+    server.AddDocument(5002, "rare parrot"s, DocumentStatus::ACTUAL, {1300});
+    const auto rare = server.FindTopDocuments("parrot"s, filter);
+    ASSERT(rare.size() == 1u && rare[0].id == 5000);
+    ASSERT(server.FindTopDocuments("parrot -rare"s, filter).empty());
+    ASSERT_EQUAL(server.FindTopDocuments(std::execution::par, "parrot"s, filter).size(), 1u);
+    for (const int id : {5000, 5001, 5002}) {
+        server.RemoveDocument(id);
+    }
+
+    const auto by_rating = server.FindTopDocumentsByRating("cat dog"s, filter);
+    ASSERT_EQUAL(by_rating.size(), 5u);
+    ASSERT_EQUAL(by_rating[0].id, 1199);
+    ASSERT_EQUAL(by_rating[1].id, 1198);
+    ASSERT_EQUAL(by_rating[4].id, 1193);
+
+    // Удалённые документы не выбираются, в том числе после уплотнения индекса
+    server.RemoveDocument(1199);
+    ASSERT_EQUAL(server.FindTopDocumentsByRating("cat dog"s, filter)[0].id, 1198);
+    for (int id = 0; id < 2000; ++id) {
+        server.RemoveDocument(id);
+    }
+    ASSERT(server.FindTopDocuments("cat dog"s, filter).empty());
+    const auto remaining = server.FindTopDocumentsByRating("cat"s, AttributeFilter().RatingBetween(2990, 3000));
+    ASSERT(remaining.size() == 5u && remaining[0].id == 2999);
+}
+
+void TestQueryPlanner() {
+    SearchServer server("and"s);
+    // common - во всех документах, cat - в каждом десятом, rare - в одном
+    for (int id = 0; id < 100; ++id) {
+        string text = "common word"s + to_string(id);
+        if (id % 10 == 0) {
+            text += " cat"s;
+        }
+        if (id == 42) {
+            text += " rare"s;
+        }
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+    }
+
+    {
+        const QueryPlan plan = server.Explain("common cat rare"s);
+        ASSERT(plan.strategy == QueryStrategy::DOCUMENT_AT_A_TIME);
+        ASSERT_EQUAL(plan.steps.size(), 3u);
+        ASSERT(plan.steps[0].word == "rare"s && plan.steps[1].word == "cat"s && plan.steps[2].word == "common"s);
+        ASSERT_EQUAL(plan.steps[1].document_freq, 10u);
+        ASSERT_EQUAL(plan.steps[2].postings_scored, 100u);
+        // Кандидаты растут по шагам: документ rare, затем ещё 10 документов cat, затем все
+        ASSERT_EQUAL(plan.steps[0].candidates, 1u);
+        ASSERT_EQUAL(plan.steps[1].candidates, 11u);
+        ASSERT_EQUAL(plan.steps[2].candidates, 100u);
+        const auto documents = server.FindTopDocuments("common cat rare"s);
+        ASSERT_EQUAL(plan.documents.size(), documents.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ASSERT(plan.documents[i].id == documents[i].id && plan.documents[i].relevance == documents[i].relevance);
+        }
+    }
+    {
+        // Редкое plus-слово и частое минус-слово: кандидат проверяется после подсчёта
+        const QueryPlan plan = server.Explain("rare -common"s);
+        ASSERT(!plan.minus_words_first);
+        ASSERT(plan.steps.back().kind == QueryStepKind::MINUS);
+        ASSERT_EQUAL(plan.steps.back().erasures, 1u);
+        ASSERT(plan.documents.empty());
+        ASSERT(server.FindTopDocuments("rare -common"s).empty());
+    }
+    {
+        const QueryPlan plan = server.Explain("cat -word40"s);
+        ASSERT(plan.minus_words_first);
+        ASSERT_EQUAL(plan.steps[0].postings_scored, 9u);
+        ASSERT_EQUAL(plan.steps[0].candidates, 9u);
+    }
+    {
+        // Много слов из раскрытия префикса - обход по словам
+        const QueryPlan plan = server.Explain("word*"s);
+        ASSERT(plan.strategy == QueryStrategy::TERM_AT_A_TIME);
+        ASSERT_EQUAL(plan.steps.size(), static_cast<size_t>(MAX_PREFIX_EXPANSIONS));
+        ASSERT_EQUAL(plan.steps.back().candidates, static_cast<size_t>(MAX_PREFIX_EXPANSIONS));
+        ostringstream output;
+        output << plan;
+        ASSERT(output.str().find("strategy = term_at_a_time"s) == 0);
+    }
+}
+
+// Релевантность складывается по словам запроса в алфавитном порядке, как до
+// планировщика запросов, при любом порядке обхода и любой стратегии
+void TestRelevanceSummationOrder() {
+    // Частота слова убывает с номером, а имена перемешаны относительно частоты
+    const auto word_name = [](int k) {
+        return "t"s + to_string(k * 7 % 30);
+    };
+    uint32_t seed = 12345;
+    const auto next_random = [&seed](uint32_t bound) {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) % bound;
+    };
+
+    SearchServer server(""s);
+    map<int, map<string, double>> term_freqs;
+    map<string, int> document_freqs;
+    const int document_count = 600;
+    for (int id = 0; id < document_count; ++id) {
+        vector<string> words;
+        const int length = 3 + static_cast<int>(next_random(8));
+        for (int i = 0; i < length; ++i) {
+            const int k = static_cast<int>(next_random(30) * next_random(30) / 30);
+            words.push_back(word_name(k));
+        }
+        string text;
+        for (const string& word : words) {
+            text += word + " "s;
+            // Так же, как AddDocument: 1 / length на каждое вхождение
+            term_freqs[id][word] += 1.0 / words.size();
+        }
+        for (const auto& [word, _] : term_freqs[id]) {
+            ++document_freqs[word];
+        }
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 17});
+    }
+
+    set<QueryStrategy> strategies;
+    for (int query_index = 0; query_index < 300; ++query_index) {
+        set<string> words;
+        string query;
+        const int length = 2 + static_cast<int>(next_random(9));
+        for (int i = 0; i < length; ++i) {
+            const string word = word_name(static_cast<int>(next_random(30)));
+            const bool required = query_index % 5 == 0 && i == 0;
+            query += (required ? "+"s : ""s) + word + " "s;
+            words.insert(word);
+        }
+
+        vector<Document> expected;
+        for (const auto& [id, freqs] : term_freqs) {
+            const bool has_required = query_index % 5 != 0 || freqs.count(query.substr(1, query.find(' ') - 1)) > 0;
+            double relevance = 0.0;
+            bool matched = false;
+            for (const string& word : words) {
+                if (const auto it = freqs.find(word); it != freqs.end()) {
+                    relevance += it->second * log(document_count * 1.0 / document_freqs.at(word));
+                    matched = true;
+                }
+            }
+            if (matched && has_required) {
+                expected.push_back({id, relevance, id % 17});
+            }
+        }
+        SelectTopResults(expected, MAX_RESULT_DOCUMENT_COUNT);
+
+        const QueryPlan plan = server.Explain(query);
+        strategies.insert(plan.strategy);
+        for (const auto& found : {server.FindTopDocuments(query), server.FindTopDocumentsBatch({query})[0], plan.documents}) {
+            ASSERT_EQUAL_HINT(found.size(), expected.size(), query);
+            for (size_t i = 0; i < expected.size(); ++i) {
+                ASSERT_EQUAL_HINT(found[i].id, expected[i].id, query);
+                ASSERT_HINT(found[i].relevance == expected[i].relevance, query);
+            }
+        }
+    }
+    ASSERT_EQUAL(strategies.size(), 3u);
+}
+
+void TestRequiredWords() {
+    SearchServer server("and"s);
+    server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "black cat"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "white dog fluffy"s, DocumentStatus::ACTUAL, {3});
+    server.AddDocument(4, "white cat fluffy"s, DocumentStatus::ACTUAL, {4});
+
+    const auto ids = [](const vector<Document>& documents) {
+        set<int> result;
+        for (const Document& document : documents) {
+            result.insert(document.id);
+        }
+        return result;
+    };
+    ASSERT((ids(server.FindTopDocuments("+white +cat"s)) == set<int>{1, 4}));
+    ASSERT((ids(server.FindTopDocuments(std::execution::par, "+white +cat -fluffy"s)) == set<int>{1}));
+    ASSERT(server.FindTopDocuments("+missing cat"s).empty());
+
+    // Необязательные слова только добавляют релевантность документам пересечения
+    const auto required = server.FindTopDocuments("+white cat fluffy"s);
+    const auto optional = server.FindTopDocuments("white cat fluffy"s);
+    ASSERT((ids(required) == set<int>{1, 3, 4}));
+    for (const Document& document : required) {
+        const auto it = find_if(optional.begin(), optional.end(),
+                                [&document](const Document& other) { return other.id == document.id; });
+        ASSERT(it != optional.end() && it->relevance == document.relevance);
+    }
+    const auto batch = server.FindTopDocumentsBatch({"+white cat fluffy"s, "+cat +black"s});
+    ASSERT_EQUAL(batch[0].size(), required.size());
+    for (size_t i = 0; i < required.size(); ++i) {
+        ASSERT(batch[0][i].id == required[i].id && batch[0][i].relevance == required[i].relevance);
+    }
+    ASSERT((ids(batch[1]) == set<int>{2}));
+
+    ASSERT(get<0>(server.MatchDocument("+white cat"s, 2)).empty());
+    ASSERT_EQUAL(get<0>(server.MatchDocument("+white cat"s, 1)).size(), 2u);
+    for (const string query : {"+"s, "++cat"s, "-+cat"s, "+-cat"s, "+cat*"s}) {
+        try {
+            server.FindTopDocuments(query);
+            ASSERT_HINT(false, "invalid required word must throw"s);
+        } catch (const invalid_argument&) {
+        }
+    }
+
+    // Перескоки по длинным спискам: кратные 2, 3 и 7
+    SearchServer numbers(""s);
+    for (int id = 0; id < 1000; ++id) {
+        string text = "n"s;
+        text += id % 2 == 0 ? " two"s : ""s;
+        text += id % 3 == 0 ? " three"s : ""s;
+        text += id % 7 == 0 ? " seven"s : ""s;
+        numbers.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+    }
+    const QueryPlan plan = numbers.Explain("+two +three +seven n"s);
+    ASSERT(plan.strategy == QueryStrategy::INTERSECTION);
+    ASSERT(plan.steps[0].word == "seven"s && plan.steps[0].kind == QueryStepKind::REQUIRED);
+    ASSERT(plan.steps.back().word == "n"s && plan.steps.back().kind == QueryStepKind::PLUS);
+    // Каждый документ пересечения есть в списке первого шага
+    ASSERT_EQUAL(plan.steps[0].candidates, 24u);
+    ASSERT_EQUAL(plan.steps.back().candidates, 24u);
+    ASSERT_EQUAL(plan.steps.back().postings_scored, 24u);
+    // Ведущий список - самый короткий, перескоки не читают его целиком
+    ASSERT(plan.steps[0].postings_visited <= 143u);
+    ASSERT_EQUAL(plan.documents[0].id, 966);
+}
+
+void TestSearchBudget() {
+    SearchServer server(""s);
+    for (int id = 0; id < 5000; ++id) {
+        server.AddDocument(id, id % 500 == 0 ? "rare common"s : "common"s, DocumentStatus::ACTUAL, {id % 7});
+    }
+
+    // Без ограничений - тот же результат, что у обычного поиска
+    const SearchResult full = server.FindTopDocuments("rare common"s, SearchBudget{});
+    const vector<Document> expected = server.FindTopDocuments("rare common"s);
+    ASSERT(!full.truncated);
+    ASSERT_EQUAL(full.documents.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT(full.documents[i].id == expected[i].id && full.documents[i].relevance == expected[i].relevance);
+    }
+
+    // Лимит постингов: частичная выдача из прочитанной части списков
+    SearchBudget small;
+    small.max_postings = 2000;
+    const SearchResult partial = server.FindTopDocuments("rare common"s, small);
+    ASSERT(partial.truncated);
+    ASSERT(!partial.documents.empty() && partial.documents.size() <= static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+
+    // Срок уже прошёл - обход не начинается
+    SearchBudget expired;
+    expired.deadline = SearchBudget::Clock::now() - chrono::seconds(1);
+    const SearchResult empty = server.FindTopDocuments("rare common"s, expired);
+    ASSERT(empty.truncated && empty.documents.empty());
+
+    BudgetTracker tracker(small);
+    size_t consumed = 0;
+    while (tracker.Consume()) {
+        ++consumed;
+    }
+    ASSERT_EQUAL(consumed + 1, small.max_postings);
+    ASSERT(tracker.IsExhausted());
+
+    // Трекер из временного бюджета хранит свою копию
+    BudgetTracker timed(SearchBudget::WithTimeout(chrono::hours(1)));
+    ASSERT(timed.Consume(BudgetTracker::CHECK_INTERVAL * 3) && timed.Tick());
+
+    vector<exception_ptr> errors;
+    const vector<SearchResult> results = ProcessQueries(server, {"rare"s, "-"s, "rare common"s}, small, errors);
+    ASSERT(!results[0].truncated && results[0].documents.size() == 5u);
+    ASSERT(errors[0] == nullptr && errors[1] != nullptr && errors[2] == nullptr);
+    ASSERT(results[2].truncated);
+}
+
+void TestImpactIndex() {
+    SearchServer server("and in"s);
+    server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, {8, -3});
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+    server.AddDocument(4, "groomed starling evgeniy"s, DocumentStatus::BANNED, {9});
+    server.AddDocument(5, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+
+    const ImpactIndex index = server.BuildImpactIndex();
+    ASSERT_EQUAL(index.GetDocumentCount(), 4u);
+
+    // Порядок совпадает с точным поиском, релевантность - с точностью до квантования
+    for (const string query : {"fluffy groomed cat"s, "cat -collar"s, "groomed starling"s, "missing"s}) {
+        const vector<Document> expected = server.FindTopDocuments(query);
+        const SearchResult result = server.FindTopDocumentsByImpact(index, query);
+        ASSERT(!result.truncated);
+        ASSERT_EQUAL_HINT(result.documents.size(), expected.size(), query);
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL_HINT(result.documents[i].id, expected[i].id, query);
+            ASSERT(abs(result.documents[i].relevance - expected[i].relevance) <= index.GetImpactStep() * 3);
+        }
+    }
+
+    // Выдача фиксируется раньше, чем прочитаны все сегменты
+    SearchServer numbers(""s);
+    for (int id = 0; id < 2000; ++id) {
+        string text = "n"s;
+        for (int tf = 0; tf < id % 10; ++tf) {
+            text += " common"s;
+        }
+        text += id < 10 ? " rare rare rare"s : ""s;
+        numbers.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+    }
+    const ImpactIndex numbers_index = numbers.BuildImpactIndex();
+    // У запроса 1810 постингов; бюджет не исчерпан, значит обход остановился раньше
+    SearchBudget early;
+    early.max_postings = 1500;
+    const SearchResult rare = numbers.FindTopDocumentsByImpact(numbers_index, "rare common"s, early);
+    const vector<Document> expected = numbers.FindTopDocuments("rare common"s);
+    ASSERT(!rare.truncated);
+    ASSERT_EQUAL(rare.documents.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQUAL(rare.documents[i].id, expected[i].id);
+    }
+    SearchBudget small;
+    small.max_postings = 100;
+    const SearchResult partial = numbers.FindTopDocumentsByImpact(numbers_index, "n common"s, small);
+    ASSERT(partial.truncated);
+    ASSERT_EQUAL(partial.documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+
+    // Версии индексов равны, но индекс построен другим сервером
+    SearchServer other("and in"s);
+    for (int id = 11; id <= 15; ++id) {
+        other.AddDocument(id, "dog park"s, DocumentStatus::ACTUAL, {1});
+    }
+    try {
+        other.FindTopDocumentsByImpact(index, "cat"s);
+        ASSERT_HINT(false, "impact index of another server must throw"s);
+    } catch (const invalid_argument&) {
+    }
+    // Перемещение переносит индекс вместе с его снимками
+    const ImpactIndex other_index = other.BuildImpactIndex();
+    const SearchServer moved(std::move(other));
+    ASSERT_EQUAL(moved.FindTopDocumentsByImpact(other_index, "dog"s).documents.size(), 5u);
+
+    server.AddDocument(6, "cat"s, DocumentStatus::ACTUAL, {1});
+    try {
+        server.FindTopDocumentsByImpact(index, "cat"s);
+        ASSERT_HINT(false, "stale impact index must throw"s);
+    } catch (const invalid_argument&) {
+    }
+    try {
+        server.FindTopDocumentsByImpact(server.BuildImpactIndex(), "+cat"s);
+        ASSERT_HINT(false, "required words are not supported"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestCompactIndex() {
+    SearchServer server("and in"s);
+    const vector<string> words = {"cat"s, "dog"s, "tail"s, "collar"s, "eyes"s, "fluffy"s, "white"s, "city"s};
+    for (int id = 0; id < 3000; ++id) {
+        string text;
+        // Длина и состав документов различаются, "cat" есть в каждом втором
+        for (size_t i = 0; i <= static_cast<size_t>(id % 7); ++i) {
+            text += words[(id * 5 + i * i) % words.size()] + " "s;
+        }
+        text += id % 2 == 0 ? "cat"s : "bird"s;
+        server.AddDocument(id, text, id % 10 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id % 13});
+    }
+    const CompactIndex index = server.BuildCompactIndex();
+    ASSERT_EQUAL(index.GetDocumentCount(), 2700u);
+    // Постинги снимка компактнее постингов сервера, но хранятся вместе с ними
+    ASSERT(index.GetPostingBytes() * 2 <= server.GetMemoryStats().posting_bytes);
+
+    for (const string query : {"cat"s, "fluffy dog"s, "white tail -cat"s, "collar eyes city bird"s, "missing"s}) {
+        const vector<Document> expected = server.FindTopDocuments(query);
+        const vector<Document> compact = server.FindTopDocumentsCompact(index, query);
+        ASSERT_EQUAL_HINT(compact.size(), expected.size(), query);
+        const double bound = index.GetRelevanceErrorBound(SplitIntoWords(string_view(query)));
+        for (size_t i = 0; i < expected.size(); ++i) {
+            // На позиции i может стоять другой документ только при почти равной релевантности
+            ASSERT_HINT(abs(compact[i].relevance - expected[i].relevance) <= 2 * bound, query);
+        }
+    }
+
+    // Ядра дают побитово одинаковую релевантность
+    const vector<string_view> plus_words = {"fluffy"sv, "cat"sv, "collar"sv};
+    const vector<Document> scalar = index.FindAllDocuments(plus_words, {"dog"sv}, CompactIndex::Kernel::SCALAR);
+    const vector<Document> best = index.FindAllDocuments(plus_words, {"dog"sv});
+    ASSERT_EQUAL(scalar.size(), best.size());
+    for (size_t i = 0; i < scalar.size(); ++i) {
+        ASSERT(scalar[i].id == best[i].id && scalar[i].relevance == best[i].relevance);
+    }
+
+    server.RemoveDocument(1);
+    try {
+        server.FindTopDocumentsCompact(index, "cat"s);
+        ASSERT_HINT(false, "stale compact index must throw"s);
+    } catch (const invalid_argument&) {
+    }
+    // Версии индексов пустых серверов равны, но снимок чужой
+    const SearchServer first(""s);
+    const SearchServer second(""s);
+    try {
+        second.FindTopDocumentsCompact(first.BuildCompactIndex(), "cat"s);
+        ASSERT_HINT(false, "compact index of another server must throw"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestCompactPostingStorage() {
+    // Список хранит документы по возрастанию id при любом порядке вставки
+    MemoryCounter counter;
+    {
+        PostingList postings(PostingStorage::COMPACT, counter);
+        ASSERT(postings.emplace(7, 0.5));
+        ASSERT(postings.emplace(3, 0.25));
+        ASSERT(!postings.emplace(7, 0.1));
+        ASSERT(postings.emplace(5, 1.0));
+        ASSERT_EQUAL(postings.size(), 3u);
+        ASSERT_EQUAL(postings.begin()->first, 3);
+        ASSERT_EQUAL(postings.lower_bound(4)->first, 5);
+        ASSERT(abs(postings.find(7)->second - 0.5) <= 1.0 / PostingList::TF_LEVELS);
+        ASSERT_EQUAL(postings.erase(5), 1u);
+        ASSERT_EQUAL(postings.erase(5), 0u);
+        ASSERT_EQUAL(postings.count(5), 0u);
+        ASSERT(postings.find(4) == postings.end());
+    }
+    ASSERT_EQUAL(counter.GetBytes(), 0u);
+
+    const vector<string> words = {"cat"s, "dog"s, "tail"s, "collar"s, "eyes"s, "fluffy"s, "white"s, "city"s};
+    SearchServer exact("and in"s);
+    SearchServer compact("and in"s);
+    compact.SetPostingStorage(PostingStorage::COMPACT);
+    for (int id = 0; id < 3000; ++id) {
+        string text;
+        for (size_t i = 0; i <= static_cast<size_t>(id % 7); ++i) {
+            text += words[(id * 5 + i * i) % words.size()] + " "s;
+        }
+        text += id % 2 == 0 ? "cat"s : "bird"s;
+        const DocumentStatus status = id % 10 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        exact.AddDocument(id, text, status, {id % 13});
+        compact.AddDocument(id, text, status, {id % 13});
+    }
+
+    // Постинги по 6 байт вместо 48, прямого индекса нет
+    const IndexMemoryStats exact_stats = exact.GetMemoryStats();
+    const IndexMemoryStats compact_stats = compact.GetMemoryStats();
+    ASSERT_EQUAL(compact_stats.posting_count, exact_stats.posting_count);
+    ASSERT_EQUAL(compact_stats.reverse_index_bytes, 0u);
+    ASSERT(compact_stats.posting_bytes * 4 <= exact_stats.posting_bytes);
+    ASSERT(compact_stats.GetTotalBytes() * 2 <= exact_stats.GetTotalBytes());
+
+    for (const string query : {"cat"s, "fluffy dog"s, "white tail -cat"s, "collar eyes city bird"s, "+dog tail"s, "missing"s}) {
+        double inverse_document_freq_sum = 0.0;
+        for (const string_view word : SplitIntoWords(string_view(query))) {
+            const string_view term = word[0] == '-' || word[0] == '+' ? word.substr(1) : word;
+            if (const int document_freq = exact.GetDocumentFrequency(term); document_freq > 0) {
+                inverse_document_freq_sum += log(exact.GetDocumentCount() * 1.0 / document_freq);
+            }
+        }
+        const double bound = inverse_document_freq_sum / PostingList::TF_LEVELS;
+        const vector<Document> expected = exact.FindTopDocuments(query);
+        const vector<Document> found = compact.FindTopDocuments(query);
+        ASSERT_EQUAL_HINT(found.size(), expected.size(), query);
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_HINT(abs(found[i].relevance - expected[i].relevance) <= 2 * bound, query);
+        }
+        // Число вхождений для BM25 восстанавливается точно
+        const vector<Document> expected_bm25 = exact.FindTopDocuments(Bm25Scorer(), query);
+        const vector<Document> found_bm25 = compact.FindTopDocuments(Bm25Scorer(), query);
+        ASSERT_EQUAL_HINT(found_bm25.size(), expected_bm25.size(), query);
+        for (size_t i = 0; i < expected_bm25.size(); ++i) {
+            ASSERT_HINT(found_bm25[i].id == expected_bm25[i].id
+                        && found_bm25[i].relevance == expected_bm25[i].relevance, query);
+        }
+        ASSERT(compact.MatchDocument(query, 4) == exact.MatchDocument(query, 4));
+    }
+
+    const SearchServer::WordFrequencies exact_freqs = exact.GetWordFrequencies(12);
+    const SearchServer::WordFrequencies compact_freqs = compact.GetWordFrequencies(12);
+    ASSERT_EQUAL(compact_freqs.size(), exact_freqs.size());
+    for (const auto& [word, term_freq] : exact_freqs) {
+        ASSERT(abs(compact_freqs.at(word) - term_freq) <= 1.0 / PostingList::TF_LEVELS);
+    }
+
+    exact.RemoveDocument(12);
+    compact.RemoveDocument(execution::par, 12);
+    ASSERT(compact.GetWordFrequencies(12).empty());
+    ASSERT_EQUAL(compact.GetMemoryStats().posting_count, exact.GetMemoryStats().posting_count);
+
+    // Обратное переключение пересчитывает доли по текстам, снимки индекса устаревают
+    const ImpactIndex index = compact.BuildImpactIndex();
+    compact.SetPostingStorage(PostingStorage::EXACT);
+    try {
+        compact.FindTopDocumentsByImpact(index, "cat"s);
+        ASSERT_HINT(false, "impact index built before the storage change must throw"s);
+    } catch (const invalid_argument&) {
+    }
+    ASSERT(compact.GetWordFrequencies(14) == exact.GetWordFrequencies(14));
+    const vector<Document> expected = exact.FindTopDocuments("fluffy dog -eyes"s);
+    const vector<Document> found = compact.FindTopDocuments("fluffy dog -eyes"s);
+    ASSERT_EQUAL(found.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT(found[i].id == expected[i].id && found[i].relevance == expected[i].relevance);
+    }
+}
+
+void TestResultOrder() {
+    // Релевантности - кластеры с шагом 1e-5 и разбросом внутри кластера меньше
+    // ACCURACY: на таких данных сравнение с допуском задаёт строгий слабый порядок
+    vector<Document> documents;
+    for (int i = 0; i < 3000; ++i) {
+        const double relevance = (i * 37 % 400 - 50) * 1e-5 + (i % 7 - 3) * 1e-9;
+        documents.push_back({i * 7919 % 3001, relevance, i % 11 - 5});
+    }
+    vector<Document> expected = documents;
+    sort(expected.begin(), expected.end(), [](const Document& lhs, const Document& rhs) {
+        if (abs(lhs.relevance - rhs.relevance) < ACCURACY) {
+            return lhs.rating != rhs.rating ? lhs.rating > rhs.rating : lhs.id < rhs.id;
+        }
+        return lhs.relevance > rhs.relevance;
+    });
+    const auto assert_prefix = [&expected](const vector<Document>& found, size_t count, const string& hint) {
+        ASSERT_EQUAL_HINT(found.size(), count, hint);
+        for (size_t i = 0; i < count; ++i) {
+            ASSERT_EQUAL_HINT(found[i].id, expected[i].id, hint);
+        }
+    };
+
+    vector<Document> sorted = documents;
+    SortResults(sorted);
+    assert_prefix(sorted, expected.size(), "seq sort"s);
+    sorted = documents;
+    SortResults(execution::par, sorted);
+    assert_prefix(sorted, expected.size(), "par sort"s);
+    for (const size_t count : {0u, 1u, 5u, 300u, 3000u, 3003u}) {
+        vector<Document> top = documents;
+        SelectTopResults(top, count);
+        assert_prefix(top, min<size_t>(count, expected.size()), "select "s + to_string(count));
+    }
+
+    // Близкие релевантности по разные стороны границы округления упорядочены по рейтингу
+    {
+        const vector<Document> pair = {{1, 1.51e-6, 1}, {2, 1.49e-6, 5}};
+        vector<Document> ranked = pair;
+        SortResults(ranked);
+        ASSERT_EQUAL(ranked[0].id, 2);
+        ranked = pair;
+        SortResults(execution::par, ranked);
+        ASSERT_EQUAL(ranked[0].id, 2);
+        ranked = pair;
+        SelectTopResults(ranked, 1);
+        ASSERT_EQUAL(ranked.size(), 1u);
+        ASSERT_EQUAL(ranked[0].id, 2);
+    }
+    // Плотные релевантности: соседние документы не нарушают сравнение с допуском,
+    // а выбор совпадает с началом полной сортировки
+    {
+        vector<Document> dense;
+        for (int i = 0; i < 2000; ++i) {
+            dense.push_back({i, (i * 7919 % 2003) * 3e-9, i * 31 % 17});
+        }
+        vector<Document> ranked = dense;
+        SortResults(execution::par, ranked);
+        for (size_t i = 1; i < ranked.size(); ++i) {
+            const Document& previous = ranked[i - 1];
+            const Document& current = ranked[i];
+            if (abs(previous.relevance - current.relevance) < ACCURACY) {
+                ASSERT(previous.rating >= current.rating);
+            } else {
+                ASSERT(previous.relevance > current.relevance);
+            }
+        }
+        for (const size_t count : {1u, 5u, 100u}) {
+            vector<Document> top = dense;
+            SelectTopResults(top, count);
+            ASSERT_EQUAL(top.size(), count);
+            for (size_t i = 0; i < count; ++i) {
+                ASSERT_EQUAL_HINT(top[i].id, ranked[i].id, "dense select "s + to_string(count));
+            }
+        }
+    }
+
+    // Строгий порядок страниц: точная релевантность, -0.0 равен 0.0
+    for (size_t i = 0; i < documents.size(); ++i) {
+        documents[i].relevance = i % 5 == 0 ? (i % 2 == 0 ? 0.0 : -0.0) : documents[i].relevance;
+    }
+    expected = documents;
+    sort(expected.begin(), expected.end(), [](const Document& lhs, const Document& rhs) {
+        return tie(lhs.relevance, lhs.rating, rhs.id) > tie(rhs.relevance, rhs.rating, lhs.id);
+    });
+    sorted = documents;
+    SortResults(execution::par, sorted, ResultOrder::EXACT);
+    assert_prefix(sorted, expected.size(), "exact sort"s);
+    SelectTopResults(documents, 10, ResultOrder::EXACT);
+    assert_prefix(documents, 10, "exact select"s);
+
+    // Полный порядок объединённой выдачи нескольких запросов
+    SearchServer server("and in"s);
+    server.AddDocument(1, "white cat fluffy tail"s, DocumentStatus::ACTUAL, {7});
+    server.AddDocument(2, "black dog"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(3, "white dog collar"s, DocumentStatus::ACTUAL, {3});
+    vector<Document> joined = ProcessQueriesJoined(server, {"white cat"s, "dog"s, "collar tail"s});
+    SortResults(joined);
+    for (size_t i = 1; i < joined.size(); ++i) {
+        ASSERT(joined[i - 1].relevance > joined[i].relevance - ACCURACY);
+    }
+}
+
 // Функция TestSearchServer является точкой входа для запуска тестов
 void TestSearchServer() {
     TestExcludeStopWordsFromAddedDocumentContent();
@@ -628,6 +2007,33 @@ void TestSearchServer() {
     TestRemoveDocs();
     TestFindTopParWithLambda();
     TestFindTopParWithoutLambda();
+    TestLatencyHistogram();
+    TestMemoryStats();
+    TestMoveAssignment();
+    TestBm25Ranking();
+    TestStatusFilterFastPath();
+    TestMatchDocuments();
+    TestPhraseQueries();
+    TestPrefixQueries();
+    TestFuzzyQueries();
+    TestTextAnalyzer();
+    TestStopWordSet();
+    TestAsyncSearchServer();
+    TestFindTopDocumentsBatch();
+    TestQueryProtocol();
+    TestCorpusLoader();
+    TestSearchCursor();
+    TestConcurrentMap();
+    TestRoaringBitmap();
+    TestAttributeFilter();
+    TestQueryPlanner();
+    TestRelevanceSummationOrder();
+    TestRequiredWords();
+    TestSearchBudget();
+    TestImpactIndex();
+    TestCompactIndex();
+    TestCompactPostingStorage();
+    TestResultOrder();
 }
 
 int main() {
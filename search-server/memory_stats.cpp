@@ -0,0 +1,21 @@
+#include "memory_stats.h"
+
+#include <string>
+
+std::ostream& operator<<(std::ostream& os, const IndexMemoryStats& stats) {
+    using namespace std::string_literals;
+    return os << "{ documents = "s << stats.document_bytes << " B"s
+              << ", dictionary = "s << stats.dictionary_bytes << " B"s
+              << ", postings = "s << stats.posting_bytes << " B"s
+              << ", reverse_index = "s << stats.reverse_index_bytes << " B"s
+              << ", document_ids = "s << stats.document_id_bytes << " B"s
+              << ", positions = "s << stats.position_bytes << " B"s
+              << ", attributes = "s << stats.attribute_bytes << " B"s
+              << ", status_documents = "s << stats.status_document_bytes << " B"s
+              << ", minus_cache = "s << stats.minus_cache_bytes << " B"s
+              << ", total = "s << stats.GetTotalBytes() << " B"s
+              << ", document_count = "s << stats.document_count
+              << ", term_count = "s << stats.term_count
+              << ", posting_count = "s << stats.posting_count
+              << ", empty_posting_lists = "s << stats.empty_posting_lists << " }"s;
+}
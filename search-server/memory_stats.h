@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <type_traits>
+
+// Счётчик байт, выделенных через CountingAllocator. Атомарный, т.к. контейнеры
+// индекса меняются параллельно (RemoveDocument с std::execution::par).
+class MemoryCounter {
+public:
+    void Allocate(size_t bytes) {
+        bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void Deallocate(size_t bytes) {
+        bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    size_t GetBytes() const {
+        return bytes_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<size_t> bytes_ = 0;
+};
+
+// Аллокатор поверх std::allocator, учитывающий выделенную память в MemoryCounter.
+// Конструктора по умолчанию нет намеренно: контейнер без счётчика не скомпилируется.
+template <typename T>
+class CountingAllocator {
+public:
+    using value_type = T;
+    // Присваивание и обмен контейнеров переносят и счётчик вместе с узлами,
+    // иначе освобождение узлов ушло бы в чужой (или уже удалённый) счётчик
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    explicit CountingAllocator(MemoryCounter& counter) noexcept
+        : counter_(&counter)
+    {}
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) noexcept
+        : counter_(other.GetCounter())
+    {}
+
+    T* allocate(size_t n) {
+        T* result = std::allocator<T>().allocate(n);
+        counter_->Allocate(n * sizeof(T));
+        return result;
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        counter_->Deallocate(n * sizeof(T));
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    MemoryCounter* GetCounter() const noexcept {
+        return counter_;
+    }
+
+private:
+    MemoryCounter* counter_;
+};
+
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T>& lhs, const CountingAllocator<U>& rhs) noexcept {
+    return lhs.GetCounter() == rhs.GetCounter();
+}
+
+template <typename T, typename U>
+bool operator!=(const CountingAllocator<T>& lhs, const CountingAllocator<U>& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+struct IndexMemoryStats {
+    // Байты в куче по частям индекса
+    size_t document_bytes = 0;
+    size_t dictionary_bytes = 0;
+    size_t posting_bytes = 0;
+    size_t reverse_index_bytes = 0;
+    size_t document_id_bytes = 0;
+    size_t position_bytes = 0;
+    // Колонки рейтингов и статусов для фильтров
+    size_t attribute_bytes = 0;
+    // Битовые карты документов каждого статуса
+    size_t status_document_bytes = 0;
+    // Закэшированные битовые карты минус-слов
+    size_t minus_cache_bytes = 0;
+
+    size_t document_count = 0;
+    size_t term_count = 0;
+    size_t posting_count = 0;
+    // Слова, у которых после RemoveDocument не осталось документов
+    size_t empty_posting_lists = 0;
+
+    size_t GetTotalBytes() const {
+        return document_bytes + dictionary_bytes + posting_bytes + reverse_index_bytes + document_id_bytes + position_bytes
+               + attribute_bytes + status_document_bytes + minus_cache_bytes;
+    }
+};
+
+std::ostream& operator<<(std::ostream& os, const IndexMemoryStats& stats);
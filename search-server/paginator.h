@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <functional>
 #include <vector>
 #include <iostream>
 
@@ -61,6 +63,49 @@ private:
     size_t pages;
 };
 
+// Ленивый режим: страницы строятся по запросу, без сортировки всего диапазона.
+// Диапазон один раз превращается в кучу за O(N), каждая страница - page_size
+// извлечений из кучи за O(page_size * log N). Элементы переставляются на месте:
+// извлечённые страницы складываются в конец диапазона, следующая - перед предыдущей.
+template <typename Iterator, typename Compare = std::less<>>
+class LazyPaginator {
+public:
+    // comp(lhs, rhs) - lhs идёт в выдаче раньше rhs
+    LazyPaginator(const size_t page_size, Iterator begin, Iterator end, Compare comp = {})
+        : page_size_(std::max<size_t>(page_size, 1)), begin_(begin), heap_end_(end), comp_(comp)
+    {
+        std::make_heap(begin_, heap_end_, HeapCompare());
+    }
+
+    bool HasNextPage() const {
+        return begin_ != heap_end_;
+    }
+
+    // Следующая страница в порядке comp; пустая, когда элементы кончились
+    IteratorRange<Iterator> NextPage() {
+        const Iterator page_end = heap_end_;
+        const auto count = std::min<size_t>(page_size_, std::distance(begin_, heap_end_));
+        for (size_t i = 0; i < count; ++i) {
+            std::pop_heap(begin_, heap_end_, HeapCompare());
+            --heap_end_;
+        }
+        // pop_heap кладёт первый по порядку элемент последним
+        std::reverse(heap_end_, page_end);
+        return IteratorRange<Iterator>(heap_end_, page_end);
+    }
+
+private:
+    size_t page_size_;
+    Iterator begin_;
+    Iterator heap_end_;
+    Compare comp_;
+
+    // На вершине кучи - элемент, идущий раньше всех
+    auto HeapCompare() const {
+        return [this](const auto& lhs, const auto& rhs) { return comp_(rhs, lhs); };
+    }
+};
+
 template <typename Iterator>
 IteratorRange<Iterator>& operator++(IteratorRange<Iterator>& it) {
     return { it.begin() + it.size(), it.end() + it.size() };
@@ -77,4 +122,9 @@ std::ostream& operator<<(std::ostream& output, const IteratorRange<Iterator>& it
 template <typename Container>
 auto Paginate(const Container& c, size_t page_size) {
     return Paginator(page_size, c.begin(), c.end());
-}
\ No newline at end of file
+}
+
+template <typename Container, typename Compare = std::less<>>
+auto PaginateLazily(Container& c, size_t page_size, Compare comp = {}) {
+    return LazyPaginator(page_size, c.begin(), c.end(), comp);
+}
@@ -0,0 +1,67 @@
+#include "positional_index.h"
+
+#include <algorithm>
+
+void EncodedPositions::Append(int position) {
+    auto delta = static_cast<uint32_t>(position - last_position_);
+    last_position_ = position;
+    while (delta >= 0x80) {
+        bytes_.push_back(static_cast<uint8_t>(delta | 0x80));
+        delta >>= 7;
+    }
+    bytes_.push_back(static_cast<uint8_t>(delta));
+}
+
+PositionDecoder::PositionDecoder(const EncodedPositions& positions)
+    : current_(positions.GetBytes().data()),
+    end_(positions.GetBytes().data() + positions.GetBytes().size())
+{
+    Next();
+}
+
+void PositionDecoder::Next() {
+    if (current_ == end_) {
+        valid_ = false;
+        return;
+    }
+    uint32_t delta = 0;
+    int shift = 0;
+    while (*current_ & 0x80) {
+        delta |= static_cast<uint32_t>(*current_++ & 0x7F) << shift;
+        shift += 7;
+    }
+    delta |= static_cast<uint32_t>(*current_++) << shift;
+    position_ += static_cast<int>(delta);
+}
+
+std::optional<int> FindMinimalPhraseGap(std::vector<PositionDecoder>& decoders) {
+    if (decoders.empty()) {
+        return std::nullopt;
+    }
+
+    const int inner_words = static_cast<int>(decoders.size()) - 1;
+    std::optional<int> best_gap;
+    for (PositionDecoder& first = decoders.front(); first.IsValid(); first.Next()) {
+        // Жадно берём для каждого следующего слова ближайшую позицию после предыдущего.
+        // С ростом первой позиции выбор для остальных слов не уменьшается,
+        // поэтому их декодеры тоже двигаются только вперёд.
+        int previous = first.Get();
+        for (size_t i = 1; i < decoders.size(); ++i) {
+            PositionDecoder& decoder = decoders[i];
+            while (decoder.IsValid() && decoder.Get() <= previous) {
+                decoder.Next();
+            }
+            if (!decoder.IsValid()) {
+                return best_gap;
+            }
+            previous = decoder.Get();
+        }
+
+        const int gap = previous - first.Get() - inner_words;
+        best_gap = best_gap ? std::min(*best_gap, gap) : gap;
+        if (best_gap == 0) {
+            break;
+        }
+    }
+    return best_gap;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "memory_stats.h"
+
+// Позиции слова в документе по возрастанию, сжатые дельта-кодированием
+// в varint (LEB128): соседние позиции обычно близки, и дельта занимает один байт.
+class EncodedPositions {
+public:
+    using Bytes = std::vector<uint8_t, CountingAllocator<uint8_t>>;
+
+    explicit EncodedPositions(const Bytes::allocator_type& allocator)
+        : bytes_(allocator)
+    {}
+
+    // Позиции должны добавляться по возрастанию
+    void Append(int position);
+
+    const Bytes& GetBytes() const {
+        return bytes_;
+    }
+
+private:
+    Bytes bytes_;
+    int last_position_ = -1;
+};
+
+// Ленивый декодер: следующая позиция распаковывается только по запросу,
+// поэтому проверка фразы останавливается, не дочитав список
+class PositionDecoder {
+public:
+    explicit PositionDecoder(const EncodedPositions& positions);
+
+    bool IsValid() const {
+        return valid_;
+    }
+
+    int Get() const {
+        return position_;
+    }
+
+    void Next();
+
+private:
+    const uint8_t* current_;
+    const uint8_t* end_;
+    int position_ = -1;
+    bool valid_ = true;
+};
+
+// Ищет вхождение слов фразы по порядку с минимальным числом "лишних" слов между
+// ними: 0 - точная фраза. nullopt - слова ни разу не встречаются в нужном порядке.
+// Декодеры только продвигаются вперёд; поиск прекращается, как только найден 0.
+std::optional<int> FindMinimalPhraseGap(std::vector<PositionDecoder>& decoders);
@@ -0,0 +1,115 @@
+#include "posting_list.h"
+
+#include <algorithm>
+#include <cmath>
+
+PostingList::CompactPostings::CompactPostings(MemoryCounter& counter)
+    : ids(CountingAllocator<int>(counter)),
+      levels(CountingAllocator<uint16_t>(counter))
+{}
+
+PostingList::PostingList(PostingStorage storage, MemoryCounter& counter)
+    : postings_(std::in_place_type<ExactPostings>, ExactPostings::allocator_type(counter))
+{
+    if (storage == PostingStorage::COMPACT) {
+        postings_.emplace<CompactPostings>(counter);
+    }
+}
+
+PostingStorage PostingList::GetStorage() const {
+    return std::holds_alternative<CompactPostings>(postings_) ? PostingStorage::COMPACT : PostingStorage::EXACT;
+}
+
+PostingList::const_iterator PostingList::begin() const {
+    if (std::holds_alternative<CompactPostings>(postings_)) {
+        return MakeIterator(size_t{0});
+    }
+    return MakeIterator(std::get<ExactPostings>(postings_).begin());
+}
+
+PostingList::const_iterator PostingList::end() const {
+    if (const auto* compact = std::get_if<CompactPostings>(&postings_)) {
+        return MakeIterator(compact->ids.size());
+    }
+    return MakeIterator(std::get<ExactPostings>(postings_).end());
+}
+
+size_t PostingList::size() const {
+    if (const auto* compact = std::get_if<CompactPostings>(&postings_)) {
+        return compact->ids.size();
+    }
+    return std::get<ExactPostings>(postings_).size();
+}
+
+bool PostingList::empty() const {
+    return size() == 0;
+}
+
+size_t PostingList::count(int document_id) const {
+    if (const auto* compact = std::get_if<CompactPostings>(&postings_)) {
+        return std::binary_search(compact->ids.begin(), compact->ids.end(), document_id) ? 1 : 0;
+    }
+    return std::get<ExactPostings>(postings_).count(document_id);
+}
+
+PostingList::const_iterator PostingList::find(int document_id) const {
+    const const_iterator it = lower_bound(document_id);
+    return it != end() && it->first == document_id ? it : end();
+}
+
+PostingList::const_iterator PostingList::lower_bound(int document_id) const {
+    if (const auto* compact = std::get_if<CompactPostings>(&postings_)) {
+        const auto it = std::lower_bound(compact->ids.begin(), compact->ids.end(), document_id);
+        return MakeIterator(it - compact->ids.begin());
+    }
+    return MakeIterator(std::get<ExactPostings>(postings_).lower_bound(document_id));
+}
+
+bool PostingList::emplace(int document_id, double term_freq) {
+    auto* compact = std::get_if<CompactPostings>(&postings_);
+    if (!compact) {
+        return std::get<ExactPostings>(postings_).emplace(document_id, term_freq).second;
+    }
+    // Документы обычно добавляются по возрастанию id - тогда это дописывание в конец
+    const auto it = std::lower_bound(compact->ids.begin(), compact->ids.end(), document_id);
+    if (it != compact->ids.end() && *it == document_id) {
+        return false;
+    }
+    const auto position = it - compact->ids.begin();
+    compact->ids.insert(it, document_id);
+    compact->levels.insert(compact->levels.begin() + position, EncodeTermFreq(term_freq));
+    return true;
+}
+
+size_t PostingList::erase(int document_id) {
+    auto* compact = std::get_if<CompactPostings>(&postings_);
+    if (!compact) {
+        return std::get<ExactPostings>(postings_).erase(document_id);
+    }
+    const auto it = std::lower_bound(compact->ids.begin(), compact->ids.end(), document_id);
+    if (it == compact->ids.end() || *it != document_id) {
+        return 0;
+    }
+    compact->levels.erase(compact->levels.begin() + (it - compact->ids.begin()));
+    compact->ids.erase(it);
+    return 1;
+}
+
+uint16_t PostingList::EncodeTermFreq(double term_freq) {
+    return static_cast<uint16_t>(std::clamp(std::lround(term_freq * TF_LEVELS), 1L, static_cast<long>(TF_LEVELS)));
+}
+
+PostingList::const_iterator PostingList::MakeIterator(ExactPostings::const_iterator node) const {
+    const_iterator it;
+    it.node_ = node;
+    return it;
+}
+
+PostingList::const_iterator PostingList::MakeIterator(size_t position) const {
+    const CompactPostings& compact = std::get<CompactPostings>(postings_);
+    const_iterator it;
+    it.compact_ = true;
+    it.id_ = compact.ids.data() + position;
+    it.level_ = compact.levels.data() + position;
+    return it;
+}
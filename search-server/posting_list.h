@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "memory_stats.h"
+
+// Как хранится доля слова в документе в списках постингов сервера
+enum class PostingStorage {
+    // double в std::map: вставка и удаление документа за O(log df)
+    EXACT,
+    // 16-битный уровень доли в отсортированных массивах: 6 байт на постинг
+    // вместо 48, но вставка не в конец списка и удаление сдвигают его хвост
+    COMPACT,
+};
+
+// Список постингов слова: пары (id документа, доля слова в документе) по
+// возрастанию id. Интерфейс - подмножество std::map<int, double>, которую он
+// заменяет; итератор возвращает пары по значению, доля в COMPACT уже раскодирована.
+// Раскодированная доля отличается от точной не больше чем на 1 / TF_LEVELS
+// (на половину уровня для документов короче 2 * TF_LEVELS слов).
+class PostingList {
+    using ExactPostings = std::map<int, double, std::less<int>, CountingAllocator<std::pair<const int, double>>>;
+
+public:
+    static constexpr int TF_LEVELS = 65535;
+
+    using value_type = std::pair<int, double>;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = PostingList::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type *;
+        using reference = value_type;
+
+        // Для it->first и it->second, как у итератора std::map
+        struct ArrowProxy {
+            value_type value;
+
+            const value_type *operator->() const {
+                return &value;
+            }
+        };
+
+        const_iterator() = default;
+
+        value_type operator*() const {
+            if (compact_) {
+                return {*id_, DecodeTermFreq(*level_)};
+            }
+            return {node_->first, node_->second};
+        }
+
+        ArrowProxy operator->() const {
+            return {**this};
+        }
+
+        const_iterator &operator++() {
+            if (compact_) {
+                ++id_;
+                ++level_;
+            } else {
+                ++node_;
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const const_iterator &other) const {
+            return compact_ ? id_ == other.id_ : node_ == other.node_;
+        }
+
+        bool operator!=(const const_iterator &other) const {
+            return !(*this == other);
+        }
+
+    private:
+        friend class PostingList;
+
+        bool compact_ = false;
+        ExactPostings::const_iterator node_;
+        const int *id_ = nullptr;
+        const uint16_t *level_ = nullptr;
+    };
+
+    PostingList(PostingStorage storage, MemoryCounter &counter);
+
+    PostingStorage GetStorage() const;
+
+    const_iterator begin() const;
+
+    const_iterator end() const;
+
+    size_t size() const;
+
+    bool empty() const;
+
+    size_t count(int document_id) const;
+
+    const_iterator find(int document_id) const;
+
+    // Первый постинг с id не меньше document_id
+    const_iterator lower_bound(int document_id) const;
+
+    // false, если документ уже есть в списке
+    bool emplace(int document_id, double term_freq);
+
+    size_t erase(int document_id);
+
+    // Уровень 0 не используется: у документа со словом доля всегда положительна
+    static uint16_t EncodeTermFreq(double term_freq);
+
+    static double DecodeTermFreq(uint16_t level) {
+        return level * (1.0 / TF_LEVELS);
+    }
+
+private:
+    // ids и levels - параллельные массивы по возрастанию id
+    struct CompactPostings {
+        explicit CompactPostings(MemoryCounter &counter);
+
+        std::vector<int, CountingAllocator<int>> ids;
+        std::vector<uint16_t, CountingAllocator<uint16_t>> levels;
+    };
+
+    std::variant<ExactPostings, CompactPostings> postings_;
+
+    const_iterator MakeIterator(ExactPostings::const_iterator node) const;
+
+    const_iterator MakeIterator(size_t position) const;
+};
@@ -9,16 +9,45 @@
 std::vector<std::vector<Document>> ProcessQueries(
         const SearchServer& search_server,
         const std::vector<std::string>& queries) {
-    std::vector<std::vector<Document>> documents(queries.size());
+    return search_server.FindTopDocumentsBatch(std::execution::par, queries);
+}
+
+std::vector<std::vector<Document>> ProcessQueries(
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries,
+        std::vector<std::exception_ptr>& errors) {
+    return search_server.FindTopDocumentsBatch(std::execution::par, queries, errors);
+}
 
+std::vector<SearchResult> ProcessQueries(
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries,
+        const SearchBudget& budget,
+        std::vector<std::exception_ptr>& errors) {
+    using Outcome = std::pair<SearchResult, std::exception_ptr>;
+    std::vector<Outcome> outcomes(queries.size());
+
+    // Пакетный режим делит обход постингов между запросами, и бюджет одного
+    // запроса в нём не выделить, поэтому запросы выполняются по одному
     std::transform(std::execution::par,
                    queries.cbegin(),
                    queries.cend(),
-                   documents.begin(),
-                   [&search_server](const std::string& q) {
-        return search_server.FindTopDocuments(q);
+                   outcomes.begin(),
+                   [&search_server, &budget](const std::string& q) {
+        try {
+            return Outcome{search_server.FindTopDocuments(q, budget), nullptr};
+        } catch (...) {
+            return Outcome{{}, std::current_exception()};
+        }
     });
-    return documents;
+
+    std::vector<SearchResult> results(queries.size());
+    errors.resize(queries.size());
+    for (size_t i = 0; i < outcomes.size(); ++i) {
+        results[i] = std::move(outcomes[i].first);
+        errors[i] = outcomes[i].second;
+    }
+    return results;
 }
 
 std::vector<Document> ProcessQueriesJoined(
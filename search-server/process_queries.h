@@ -7,12 +7,29 @@
 #include "document.h"
 #include "search_server.h"
 
+#include <exception>
 #include <vector>
 
 std::vector<std::vector<Document>> ProcessQueries(
         const SearchServer& search_server,
         const std::vector<std::string>& queries);
 
+// Исключение внутри параллельного алгоритма вызывает std::terminate, поэтому
+// ошибка каждого запроса сохраняется в errors[i], а его результат остаётся пустым
+std::vector<std::vector<Document>> ProcessQueries(
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries,
+        std::vector<std::exception_ptr>& errors);
+
+// Каждый запрос выполняется с budget: срок общий для всех запросов, лимит
+// постингов - у каждого свой. Ошибки - как у варианта выше.
+std::vector<SearchResult> ProcessQueries(
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries,
+        const SearchBudget& budget,
+        std::vector<std::exception_ptr>& errors);
+
+// Выдачи всех запросов подряд, каждая в своём порядке; общий порядок - SortResults
 std::vector<Document> ProcessQueriesJoined(
         const SearchServer& search_server,
         const std::vector<std::string>& queries);
\ No newline at end of file
@@ -0,0 +1,41 @@
+#include "query_plan.h"
+
+std::string_view GetQueryStrategyName(QueryStrategy strategy) {
+    switch (strategy) {
+        case QueryStrategy::TERM_AT_A_TIME:
+            return "term_at_a_time";
+        case QueryStrategy::DOCUMENT_AT_A_TIME:
+            return "document_at_a_time";
+        case QueryStrategy::INTERSECTION:
+            return "intersection";
+    }
+    return "unknown";
+}
+
+std::string_view GetQueryStepKindName(QueryStepKind kind) {
+    switch (kind) {
+        case QueryStepKind::PLUS:
+            return "plus";
+        case QueryStepKind::REQUIRED:
+            return "required";
+        case QueryStepKind::FUZZY:
+            return "fuzzy";
+        case QueryStepKind::MINUS:
+            return "minus";
+    }
+    return "unknown";
+}
+
+std::ostream& operator<<(std::ostream& output, const QueryPlan& plan) {
+    output << "strategy = " << GetQueryStrategyName(plan.strategy)
+           << ", minus_words = " << (plan.minus_words_first ? "first" : "last") << '\n';
+    for (const QueryPlanStep& step : plan.steps) {
+        output << "  " << GetQueryStepKindName(step.kind) << ' ' << step.word
+               << ": df = " << step.document_freq
+               << ", visited = " << step.postings_visited
+               << ", scored = " << step.postings_scored
+               << ", candidates = " << step.candidates
+               << ", erasures = " << step.erasures << '\n';
+    }
+    return output << "  documents = " << plan.documents.size() << '\n';
+}
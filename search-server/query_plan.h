@@ -0,0 +1,61 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+
+// Как FindAllDocuments обходит списки постингов
+enum class QueryStrategy {
+    // По словам: вклады каждого слова добавляются в накопитель по id
+    TERM_AT_A_TIME,
+    // По документам: курсоры всех слов идут вместе по возрастанию id,
+    // релевантность документа складывается целиком без накопителя
+    DOCUMENT_AT_A_TIME,
+    // Пересечение списков обязательных слов (+word): самый короткий список ведёт,
+    // в остальных документ ищется переходом вперёд, релевантность считается
+    // только для документов пересечения
+    INTERSECTION,
+};
+
+enum class QueryStepKind {
+    PLUS,
+    REQUIRED,
+    FUZZY,
+    MINUS,
+};
+
+std::string_view GetQueryStrategyName(QueryStrategy strategy);
+
+std::string_view GetQueryStepKindName(QueryStepKind kind);
+
+// Одно слово плана и счётчики его выполнения
+struct QueryPlanStep {
+    QueryStepKind kind = QueryStepKind::PLUS;
+    std::string word;
+    size_t document_freq = 0;
+    size_t postings_visited = 0;
+    // Постинги, давшие вклад в релевантность
+    size_t postings_scored = 0;
+    // Кандидаты после шага: документы, получившие вклад на этом или предыдущих
+    // шагах. При обходе по документам и пересечении слова идут вместе, и документ
+    // относится к первому шагу плана, в списке которого он есть.
+    size_t candidates = 0;
+    // Кандидаты, удалённые минус-словом после подсчёта релевантности
+    size_t erasures = 0;
+};
+
+// План запроса, выбранный по частотам слов, см. SearchServer::Explain
+struct QueryPlan {
+    QueryStrategy strategy = QueryStrategy::TERM_AT_A_TIME;
+    // true - документы минус-слов исключаются битовой картой до обхода постингов,
+    // false - кандидаты проверяются по спискам минус-слов после подсчёта
+    bool minus_words_first = true;
+    // В порядке выполнения: plus-слова от редких к частым, исправления опечаток, минус-слова
+    std::vector<QueryPlanStep> steps;
+    std::vector<Document> documents;
+};
+
+std::ostream& operator<<(std::ostream& output, const QueryPlan& plan);
@@ -0,0 +1,135 @@
+#include "query_protocol.h"
+
+#include <charconv>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+namespace {
+
+// Отрезает от line первое слово
+std::string_view NextToken(std::string_view& line) {
+    const size_t begin = std::min(line.find_first_not_of(' '), line.size());
+    const size_t end = std::min(line.find(' ', begin), line.size());
+    const std::string_view token = line.substr(begin, end - begin);
+    line.remove_prefix(end);
+    line.remove_prefix(std::min(line.find_first_not_of(' '), line.size()));
+    return token;
+}
+
+int ParseInt(std::string_view token, const char* what) {
+    int value = 0;
+    const auto [ptr, error] = std::from_chars(token.data(), token.data() + token.size(), value);
+    if (token.empty() || error != std::errc() || ptr != token.data() + token.size())
+        throw std::invalid_argument("ParseCommand: bad "s + what + " '"s + std::string(token) + "'"s);
+    return value;
+}
+
+std::vector<int> ParseRatings(std::string_view token) {
+    std::vector<int> ratings;
+    if (token == "-") {
+        return ratings;
+    }
+    while (!token.empty()) {
+        const size_t comma = std::min(token.find(','), token.size());
+        ratings.push_back(ParseInt(token.substr(0, comma), "rating"));
+        token.remove_prefix(std::min(comma + 1, token.size()));
+    }
+    return ratings;
+}
+
+} // namespace
+
+Command ParseCommand(std::string_view line) {
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+
+    Command command;
+    const std::string_view name = NextToken(line);
+    if (name == "ADD") {
+        command.type = CommandType::ADD;
+        command.document_id = ParseInt(NextToken(line), "document id");
+        command.status = ParseDocumentStatus(NextToken(line));
+        command.ratings = ParseRatings(NextToken(line));
+    } else if (name == "REMOVE") {
+        command.type = CommandType::REMOVE;
+        command.document_id = ParseInt(NextToken(line), "document id");
+        if (!line.empty())
+            throw std::invalid_argument("ParseCommand: REMOVE takes only a document id");
+    } else if (name == "QUERY") {
+        command.type = CommandType::QUERY;
+    } else if (name == "MATCH") {
+        command.type = CommandType::MATCH;
+        command.document_id = ParseInt(NextToken(line), "document id");
+    } else {
+        throw std::invalid_argument("ParseCommand: unknown command '"s + std::string(name) + "'"s);
+    }
+    command.text = line;
+    return command;
+}
+
+bool IsWriteCommand(CommandType type) {
+    return type == CommandType::ADD || type == CommandType::REMOVE;
+}
+
+std::string FormatAddCommand(int document_id, DocumentStatus status, const std::vector<int>& ratings,
+                             std::string_view text) {
+    std::string line = "ADD "s + std::to_string(document_id) + ' ' + std::string(GetDocumentStatusName(status)) + ' ';
+    if (ratings.empty()) {
+        line += '-';
+    }
+    for (size_t i = 0; i < ratings.size(); ++i) {
+        if (i > 0) {
+            line += ',';
+        }
+        line += std::to_string(ratings[i]);
+    }
+    line += ' ';
+    line += text;
+    line += '\n';
+    return line;
+}
+
+std::string FormatQueryResponse(const std::vector<Document>& documents) {
+    std::ostringstream out;
+    out << "OK "s << documents.size();
+    for (const Document& document : documents) {
+        out << ' ' << document.id << ':' << document.relevance << ':' << document.rating;
+    }
+    out << '\n';
+    return out.str();
+}
+
+std::string FormatErrorResponse(std::string_view message) {
+    return "ERROR "s + std::string(message) + '\n';
+}
+
+std::string ExecuteCommand(SearchServer& server, const Command& command) {
+    try {
+        switch (command.type) {
+            case CommandType::ADD:
+                server.AddDocument(command.document_id, command.text, command.status, command.ratings);
+                return "OK\n"s;
+            case CommandType::REMOVE:
+                server.RemoveDocument(command.document_id);
+                return "OK\n"s;
+            case CommandType::QUERY:
+                return FormatQueryResponse(server.FindTopDocuments(command.text));
+            case CommandType::MATCH: {
+                const auto [words, status] = server.MatchDocument(command.text, command.document_id);
+                std::string response = "OK "s + std::string(GetDocumentStatusName(status));
+                for (const std::string_view word : words) {
+                    response += ' ';
+                    response += word;
+                }
+                response += '\n';
+                return response;
+            }
+        }
+    } catch (const std::exception& e) {
+        return FormatErrorResponse(e.what());
+    }
+    return FormatErrorResponse("unknown command");
+}
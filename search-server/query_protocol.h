@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+#include "string_processing.h"
+
+// Строковый протокол сервера запросов, одна команда на строку:
+//     ADD <id> <status> <rating,rating,...|-> <text>   -> OK
+//     REMOVE <id>                                      -> OK (и для неизвестного id)
+//     QUERY <raw query>                                -> OK <n> <id>:<relevance>:<rating> ...
+//     MATCH <id> <raw query>                           -> OK <status> <word> ...
+// Ошибка - ERROR <сообщение>. Строка может заканчиваться на "\r\n".
+enum class CommandType {
+    ADD,
+    REMOVE,
+    QUERY,
+    MATCH,
+};
+
+// Поля ссылаются на разобранную строку, копий текста нет
+struct Command {
+    CommandType type = CommandType::QUERY;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view text;
+};
+
+// Бросает std::invalid_argument, если строка не является командой
+Command ParseCommand(std::string_view line);
+
+// ADD и REMOVE меняют индекс и требуют монопольного доступа к серверу
+bool IsWriteCommand(CommandType type);
+
+// Строка команды ADD с '\n' - обратная к ParseCommand
+std::string FormatAddCommand(int document_id, DocumentStatus status, const std::vector<int>& ratings,
+                             std::string_view text);
+
+// Ответ на QUERY по готовому результату поиска
+std::string FormatQueryResponse(const std::vector<Document>& documents);
+
+std::string FormatErrorResponse(std::string_view message);
+
+// Ответ с завершающим '\n'; исключения сервера превращаются в ERROR
+std::string ExecuteCommand(SearchServer& server, const Command& command);
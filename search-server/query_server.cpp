@@ -0,0 +1,423 @@
+#include "query_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include "process_queries.h"
+#include "query_protocol.h"
+
+using namespace std::string_literals;
+
+namespace {
+
+constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+constexpr int MAX_EVENTS = 64;
+
+[[noreturn]] void ThrowSystemError(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), "QueryServer: "s + what);
+}
+
+} // namespace
+
+QueryServer::QueryServer(SearchServer& search_server, QueryServerOptions options)
+    : search_server_(search_server),
+    options_(std::move(options))
+{
+    if (!options_.tcp_port && options_.unix_path.empty())
+        throw std::invalid_argument("QueryServer: neither TCP port nor Unix socket path is set");
+    if (options_.worker_count == 0)
+        throw std::invalid_argument("QueryServer: worker count must be positive");
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        const int error = errno;
+        if (epoll_fd_ >= 0) {
+            close(epoll_fd_);
+        }
+        errno = error;
+        ThrowSystemError("epoll/eventfd");
+    }
+
+    try {
+        Listen();
+    } catch (...) {
+        for (const int fd : {tcp_fd_, unix_fd_, wake_fd_, epoll_fd_}) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        throw;
+    }
+
+    for (size_t i = 0; i < options_.worker_count; ++i) {
+        workers_.emplace_back([this] { RunWorker(); });
+    }
+}
+
+QueryServer::~QueryServer() {
+    {
+        std::lock_guard lock(tasks_mutex_);
+        stopping_ = true;
+    }
+    has_tasks_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+
+    for (const auto& [fd, connection] : connections_) {
+        close(fd);
+    }
+    for (const int fd : {tcp_fd_, unix_fd_, wake_fd_, epoll_fd_}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    if (unix_fd_ >= 0) {
+        unlink(options_.unix_path.c_str());
+    }
+}
+
+std::optional<uint16_t> QueryServer::GetTcpPort() const {
+    return tcp_port_;
+}
+
+void QueryServer::Run() {
+    epoll_event events[MAX_EVENTS];
+    while (!stop_requested_) {
+        const int count = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("epoll_wait");
+        }
+
+        for (int i = 0; i < count; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == wake_fd_) {
+                uint64_t value;
+                [[maybe_unused]] const ssize_t ignored = read(wake_fd_, &value, sizeof(value));
+                ApplyCompletions();
+                continue;
+            }
+            if (fd == tcp_fd_ || fd == unix_fd_) {
+                Accept(fd);
+                continue;
+            }
+
+            // Соединение могло быть закрыто обработкой предыдущего события
+            const auto it = connections_.find(fd);
+            if (it == connections_.end()) {
+                continue;
+            }
+            if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                // Клиент больше не примет ответов
+                Close(fd);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                WriteTo(it->second);
+            }
+            if (connections_.count(fd) && (events[i].events & EPOLLIN)) {
+                ReadFrom(it->second);
+            }
+            CloseIfFinished(fd);
+        }
+    }
+}
+
+void QueryServer::Stop() {
+    // Только async-signal-safe операции
+    stop_requested_ = true;
+    const uint64_t one = 1;
+    [[maybe_unused]] const ssize_t ignored = write(wake_fd_, &one, sizeof(one));
+}
+
+void QueryServer::Listen() {
+    const auto add_listener = [this](int fd) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (listen(fd, SOMAXCONN) < 0 || epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+            ThrowSystemError("listen");
+        }
+    };
+
+    epoll_event wake_event{};
+    wake_event.events = EPOLLIN;
+    wake_event.data.fd = wake_fd_;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &wake_event) < 0) {
+        ThrowSystemError("epoll_ctl");
+    }
+
+    if (options_.tcp_port) {
+        tcp_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (tcp_fd_ < 0) {
+            ThrowSystemError("socket");
+        }
+        const int enable = 1;
+        setsockopt(tcp_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(*options_.tcp_port);
+        if (bind(tcp_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            ThrowSystemError("bind to port "s + std::to_string(*options_.tcp_port));
+        }
+        socklen_t length = sizeof(address);
+        getsockname(tcp_fd_, reinterpret_cast<sockaddr*>(&address), &length);
+        tcp_port_ = ntohs(address.sin_port);
+        add_listener(tcp_fd_);
+    }
+
+    if (!options_.unix_path.empty()) {
+        sockaddr_un address{};
+        if (options_.unix_path.size() >= sizeof(address.sun_path))
+            throw std::invalid_argument("QueryServer: Unix socket path is too long");
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, options_.unix_path.c_str(), options_.unix_path.size() + 1);
+
+        unix_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (unix_fd_ < 0) {
+            ThrowSystemError("socket");
+        }
+        unlink(options_.unix_path.c_str());
+        if (bind(unix_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            ThrowSystemError("bind to "s + options_.unix_path);
+        }
+        add_listener(unix_fd_);
+    }
+}
+
+void QueryServer::Accept(int listen_fd) {
+    while (true) {
+        const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            // EAGAIN - очередь пуста; прочие ошибки относятся к одному клиенту
+            return;
+        }
+        if (listen_fd == tcp_fd_) {
+            const int enable = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        }
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+            close(fd);
+            continue;
+        }
+        Connection& connection = connections_[fd];
+        connection.fd = fd;
+        connection.generation = ++next_generation_;
+    }
+}
+
+void QueryServer::ReadFrom(Connection& connection) {
+    char buffer[READ_CHUNK_SIZE];
+    while (AcceptsInput(connection)) {
+        const ssize_t size = read(connection.fd, buffer, sizeof(buffer));
+        if (size > 0) {
+            connection.input.append(buffer, static_cast<size_t>(size));
+        } else if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else if (size < 0 && errno == EINTR) {
+            continue;
+        } else {
+            // Конец потока или ошибка: дописываем ответы на уже полученные строки
+            connection.is_read_closed = true;
+        }
+    }
+
+    // Незавершённый хвост длиннее предела - клиент прислал мусор
+    const size_t last_newline = connection.input.rfind('\n');
+    const size_t tail_size = last_newline == std::string::npos
+        ? connection.input.size()
+        : connection.input.size() - last_newline - 1;
+    if (tail_size > options_.max_line_length) {
+        Close(connection.fd);
+        return;
+    }
+    Dispatch(connection);
+}
+
+void QueryServer::WriteTo(Connection& connection) {
+    size_t written = 0;
+    while (written < connection.output.size()) {
+        const ssize_t size = send(connection.fd, connection.output.data() + written,
+                                  connection.output.size() - written, MSG_NOSIGNAL);
+        if (size >= 0) {
+            written += static_cast<size_t>(size);
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            Close(connection.fd);
+            return;
+        }
+    }
+    connection.output.erase(0, written);
+    // Ответы ушли - можно взять строки, отложенные из-за переполненного вывода
+    Dispatch(connection);
+}
+
+void QueryServer::Dispatch(Connection& connection) {
+    const size_t last_newline = connection.input.rfind('\n');
+    if (!connection.is_busy && last_newline != std::string::npos
+        && connection.output.size() <= options_.max_pending_output) {
+        Task task{connection.fd, connection.generation, connection.input.substr(0, last_newline + 1)};
+        connection.input.erase(0, last_newline + 1);
+        connection.is_busy = true;
+        {
+            std::lock_guard lock(tasks_mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        has_tasks_.notify_one();
+    }
+    UpdateInterest(connection);
+}
+
+void QueryServer::ApplyCompletions() {
+    std::vector<Completion> completions;
+    {
+        std::lock_guard lock(completions_mutex_);
+        completions.swap(completions_);
+    }
+
+    for (Completion& completion : completions) {
+        const auto it = connections_.find(completion.fd);
+        if (it == connections_.end() || it->second.generation != completion.generation) {
+            continue;
+        }
+        Connection& connection = it->second;
+        connection.is_busy = false;
+        connection.output += completion.output;
+        // WriteTo ставит следующую задачу соединения
+        WriteTo(connection);
+        CloseIfFinished(completion.fd);
+    }
+}
+
+void QueryServer::CloseIfFinished(int fd) {
+    const auto it = connections_.find(fd);
+    if (it == connections_.end()) {
+        return;
+    }
+    const Connection& connection = it->second;
+    if (connection.is_read_closed && !connection.is_busy && connection.output.empty()) {
+        Close(fd);
+    }
+}
+
+bool QueryServer::AcceptsInput(const Connection& connection) const {
+    return !connection.is_read_closed && !connection.is_busy
+           && connection.input.size() <= options_.max_line_length
+           && connection.output.size() <= options_.max_pending_output;
+}
+
+void QueryServer::UpdateInterest(const Connection& connection) {
+    // Без EPOLLIN данные остаются в буфере ядра, и отправитель блокируется
+    epoll_event event{};
+    event.events = (AcceptsInput(connection) ? EPOLLIN : 0) | (connection.output.empty() ? 0 : EPOLLOUT);
+    event.data.fd = connection.fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+}
+
+void QueryServer::Close(int fd) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections_.erase(fd);
+}
+
+void QueryServer::RunWorker() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock lock(tasks_mutex_);
+            has_tasks_.wait(lock, [this] { return !tasks_.empty() || stopping_; });
+            if (stopping_) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        std::string output = ExecuteLines(task.lines);
+        {
+            std::lock_guard lock(completions_mutex_);
+            completions_.push_back({task.fd, task.generation, std::move(output)});
+        }
+        const uint64_t one = 1;
+        [[maybe_unused]] const ssize_t ignored = write(wake_fd_, &one, sizeof(one));
+    }
+}
+
+std::string QueryServer::ExecuteLines(std::string_view lines) {
+    std::string output;
+    // Идущие подряд QUERY выполняются одним пакетом с общим обходом индекса
+    std::vector<std::string> queries;
+    const auto flush_queries = [this, &output, &queries] {
+        if (queries.empty()) {
+            return;
+        }
+        std::vector<std::exception_ptr> errors;
+        std::vector<std::vector<Document>> results;
+        {
+            std::shared_lock lock(index_mutex_);
+            results = ProcessQueries(search_server_, queries, errors);
+        }
+        for (size_t i = 0; i < queries.size(); ++i) {
+            if (!errors[i]) {
+                output += FormatQueryResponse(results[i]);
+                continue;
+            }
+            try {
+                std::rethrow_exception(errors[i]);
+            } catch (const std::exception& e) {
+                output += FormatErrorResponse(e.what());
+            }
+        }
+        queries.clear();
+    };
+
+    ForEachLine(lines, [&](std::string_view line) {
+        Command command;
+        try {
+            command = ParseCommand(line);
+        } catch (const std::invalid_argument& e) {
+            flush_queries();
+            output += FormatErrorResponse(e.what());
+            return;
+        }
+
+        if (command.type == CommandType::QUERY) {
+            queries.emplace_back(command.text);
+            return;
+        }
+        flush_queries();
+        if (IsWriteCommand(command.type)) {
+            std::unique_lock lock(index_mutex_);
+            output += ExecuteCommand(search_server_, command);
+        } else {
+            std::shared_lock lock(index_mutex_);
+            output += ExecuteCommand(search_server_, command);
+        }
+    });
+    flush_queries();
+    return output;
+}
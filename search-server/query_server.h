@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "search_server.h"
+
+struct QueryServerOptions {
+    // Порт TCP на 127.0.0.1 (0 - выбрать свободный); nullopt - без TCP
+    std::optional<uint16_t> tcp_port;
+    // Путь Unix-сокета; пустой - без Unix-сокета
+    std::string unix_path;
+    size_t worker_count = std::max(1u, std::thread::hardware_concurrency());
+    // Строка длиннее этого считается ошибкой клиента, соединение закрывается.
+    // Больше этого объёма прочитанных строк соединение не копит: чтение
+    // приостанавливается до окончания текущей задачи.
+    size_t max_line_length = 1 << 20;
+    // Пока неотправленных ответов больше этого, у соединения не читаются и не
+    // выполняются новые строки
+    size_t max_pending_output = 16 << 20;
+};
+
+// Сервер строкового протокола (query_protocol.h) на epoll, только Linux.
+// Поток Run принимает соединения, читает и пишет неблокирующие сокеты;
+// разбор и выполнение команд идут в пуле рабочих потоков. Полные строки,
+// прочитанные из соединения, уходят одной задачей, и пока она выполняется,
+// следующая задача того же соединения не ставится - ответы идут в порядке запросов.
+// Пока задача выполняется или клиент не забирает ответы, сокет не читается,
+// и клиент упирается в буфер ядра вместо памяти сервера.
+// QUERY и MATCH выполняются параллельно, ADD и REMOVE - монопольно;
+// идущие подряд QUERY одной задачи выполняются пакетом через ProcessQueries.
+class QueryServer {
+public:
+    QueryServer(SearchServer& search_server, QueryServerOptions options);
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    ~QueryServer();
+
+    // Порт, на котором реально слушает TCP-сокет
+    std::optional<uint16_t> GetTcpPort() const;
+
+    // Блокирует до вызова Stop
+    void Run();
+
+    // Можно вызывать из любого потока и из обработчика сигнала
+    void Stop();
+
+private:
+    struct Connection {
+        int fd = -1;
+        // Отличает соединение от более позднего с тем же fd
+        uint64_t generation = 0;
+        std::string input;
+        std::string output;
+        bool is_busy = false;
+        bool is_read_closed = false;
+    };
+
+    struct Task {
+        int fd;
+        uint64_t generation;
+        std::string lines;
+    };
+
+    struct Completion {
+        int fd;
+        uint64_t generation;
+        std::string output;
+    };
+
+    SearchServer& search_server_;
+    const QueryServerOptions options_;
+    std::shared_mutex index_mutex_;
+
+    int epoll_fd_ = -1;
+    // eventfd: пробуждает цикл для завершённых задач и остановки
+    int wake_fd_ = -1;
+    int tcp_fd_ = -1;
+    int unix_fd_ = -1;
+    std::optional<uint16_t> tcp_port_;
+
+    std::unordered_map<int, Connection> connections_;
+    uint64_t next_generation_ = 0;
+
+    std::mutex tasks_mutex_;
+    std::condition_variable has_tasks_;
+    std::deque<Task> tasks_;
+    bool stopping_ = false;
+    std::atomic<bool> stop_requested_ = false;
+
+    std::mutex completions_mutex_;
+    std::vector<Completion> completions_;
+
+    std::vector<std::thread> workers_;
+
+    void Listen();
+
+    void Accept(int listen_fd);
+
+    void ReadFrom(Connection& connection);
+
+    void WriteTo(Connection& connection);
+
+    void Dispatch(Connection& connection);
+
+    void ApplyCompletions();
+
+    // Закрывает соединение, если клиент ушёл и всё ему отправлено
+    void CloseIfFinished(int fd);
+
+    // Можно ли читать из соединения: оно не занято и буферы не превышены
+    bool AcceptsInput(const Connection& connection) const;
+
+    void UpdateInterest(const Connection& connection);
+
+    void Close(int fd);
+
+    void RunWorker();
+
+    std::string ExecuteLines(std::string_view lines);
+};
@@ -0,0 +1,69 @@
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "query_server.h"
+#include "search_server.h"
+
+using namespace std;
+
+namespace {
+
+QueryServer* running_server = nullptr;
+
+void HandleSignal(int) {
+    if (running_server) {
+        running_server->Stop();
+    }
+}
+
+} // namespace
+
+// Параметры:
+//   --port=<порт TCP на 127.0.0.1, 0 - любой свободный>
+//   --unix=<путь Unix-сокета>
+//   --workers=<число рабочих потоков>
+//   --stop_words=<стоп-слова через пробел>
+int main(int argc, char* argv[]) {
+    QueryServerOptions options;
+    string stop_words;
+
+    for (int i = 1; i < argc; ++i) {
+        const string_view arg = argv[i];
+        const auto value = [arg](string_view prefix) {
+            return string(arg.substr(prefix.size()));
+        };
+        if (arg.rfind("--port="sv, 0) == 0) {
+            options.tcp_port = static_cast<uint16_t>(stoul(value("--port="sv)));
+        } else if (arg.rfind("--unix="sv, 0) == 0) {
+            options.unix_path = value("--unix="sv);
+        } else if (arg.rfind("--workers="sv, 0) == 0) {
+            options.worker_count = stoul(value("--workers="sv));
+        } else if (arg.rfind("--stop_words="sv, 0) == 0) {
+            stop_words = value("--stop_words="sv);
+        } else {
+            cerr << "Unknown argument: "s << arg << endl;
+            return 1;
+        }
+    }
+    if (!options.tcp_port && options.unix_path.empty()) {
+        options.tcp_port = 7700;
+    }
+
+    SearchServer search_server(stop_words);
+    QueryServer server(search_server, options);
+    running_server = &server;
+    signal(SIGINT, HandleSignal);
+    signal(SIGTERM, HandleSignal);
+
+    if (const auto port = server.GetTcpPort()) {
+        cerr << "Listening on 127.0.0.1:"s << *port << endl;
+    }
+    if (!options.unix_path.empty()) {
+        cerr << "Listening on "s << options.unix_path << endl;
+    }
+    server.Run();
+    running_server = nullptr;
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include "query_trace.h"
+
+#include <algorithm>
+#include <cmath>
+
+const char* QueryStageName(QueryStage stage) {
+    switch (stage) {
+        case QueryStage::PARSE:
+            return "parse";
+        case QueryStage::PLAN:
+            return "plan";
+        case QueryStage::POSTINGS:
+            return "postings";
+        case QueryStage::MINUS_FILTER:
+            return "minus_filter";
+        case QueryStage::ATTRIBUTE_FILTER:
+            return "attribute_filter";
+        case QueryStage::MERGE:
+            return "merge";
+        case QueryStage::TOP_K:
+            return "top_k";
+    }
+    return "unknown";
+}
+
+void LatencyHistogram::Reset() {
+    for (auto& counter : counts_) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t LatencyHistogram::BucketIndex(uint64_t value_ns) {
+    if (value_ns < 2 * SUB_BUCKET_COUNT) {
+        return value_ns;
+    }
+    int magnitude = 63;
+    while ((value_ns >> magnitude) == 0) {
+        --magnitude;
+    }
+    const int shift = std::min(magnitude - SUB_BUCKET_BITS, MAX_SHIFT);
+    const uint64_t sub_bucket = std::min(value_ns >> shift, 2 * SUB_BUCKET_COUNT - 1);
+    return SUB_BUCKET_COUNT + shift * SUB_BUCKET_COUNT + (sub_bucket - SUB_BUCKET_COUNT);
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t bucket) {
+    if (bucket < 2 * SUB_BUCKET_COUNT) {
+        return bucket;
+    }
+    const uint64_t shift = (bucket - SUB_BUCKET_COUNT) / SUB_BUCKET_COUNT;
+    const uint64_t sub_bucket = (bucket - SUB_BUCKET_COUNT) % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+void HistogramSnapshot::Add(const LatencyHistogram& histogram) {
+    for (size_t bucket = 0; bucket < counts_.size(); ++bucket) {
+        const uint64_t count = histogram.GetCount(bucket);
+        counts_[bucket] += count;
+        total_count_ += count;
+    }
+}
+
+void HistogramSnapshot::Record(uint64_t value_ns) {
+    ++counts_[LatencyHistogram::BucketIndex(value_ns)];
+    ++total_count_;
+}
+
+uint64_t HistogramSnapshot::GetTotalCount() const {
+    return total_count_;
+}
+
+uint64_t HistogramSnapshot::GetMax() const {
+    for (size_t bucket = counts_.size(); bucket > 0; --bucket) {
+        if (counts_[bucket - 1] > 0) {
+            return LatencyHistogram::BucketUpperBound(bucket - 1);
+        }
+    }
+    return 0;
+}
+
+uint64_t HistogramSnapshot::GetPercentile(double quantile) const {
+    if (total_count_ == 0) {
+        return 0;
+    }
+    const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * total_count_)));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < counts_.size(); ++bucket) {
+        seen += counts_[bucket];
+        if (seen >= rank) {
+            return LatencyHistogram::BucketUpperBound(bucket);
+        }
+    }
+    return GetMax();
+}
+
+QueryTracer& QueryTracer::Instance() {
+    static QueryTracer tracer;
+    return tracer;
+}
+
+std::shared_ptr<QueryTracer::StageHistograms> QueryTracer::Register() {
+    auto histograms = std::make_shared<StageHistograms>();
+    std::lock_guard guard(mutex_);
+    histograms_.push_back(histograms);
+    return histograms;
+}
+
+std::array<HistogramSnapshot, QUERY_STAGE_COUNT> QueryTracer::Snapshot() const {
+    std::array<HistogramSnapshot, QUERY_STAGE_COUNT> result;
+    std::lock_guard guard(mutex_);
+    for (const auto& histograms : histograms_) {
+        for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+            result[stage].Add((*histograms)[stage]);
+        }
+    }
+    return result;
+}
+
+void QueryTracer::Reset() {
+    std::lock_guard guard(mutex_);
+    for (const auto& histograms : histograms_) {
+        for (auto& histogram : *histograms) {
+            histogram.Reset();
+        }
+    }
+}
+
+void QueryTracer::Dump(std::ostream& os) const {
+    using namespace std::literals;
+
+    const auto snapshot = Snapshot();
+    for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+        const HistogramSnapshot& histogram = snapshot[stage];
+        os << QueryStageName(static_cast<QueryStage>(stage))
+           << ": count = "s << histogram.GetTotalCount()
+           << ", p50 = "s << histogram.GetPercentile(0.5) << " ns"s
+           << ", p99 = "s << histogram.GetPercentile(0.99) << " ns"s
+           << ", p999 = "s << histogram.GetPercentile(0.999) << " ns"s
+           << ", max = "s << histogram.GetMax() << " ns"s << std::endl;
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "log_duration.h"
+
+enum class QueryStage {
+    PARSE,
+    PLAN,
+    POSTINGS,
+    MINUS_FILTER,
+    ATTRIBUTE_FILTER,
+    MERGE,
+    TOP_K,
+};
+
+constexpr size_t QUERY_STAGE_COUNT = 7;
+
+const char* QueryStageName(QueryStage stage);
+
+// Лог-линейная гистограмма в стиле HDR: точные значения до 64 нс,
+// дальше по 32 корзины на каждую степень двойки (погрешность < 3%).
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr uint64_t SUB_BUCKET_COUNT = 1u << SUB_BUCKET_BITS;
+    static constexpr int MAX_SHIFT = 40;
+    static constexpr size_t BUCKET_COUNT = 2 * SUB_BUCKET_COUNT + MAX_SHIFT * SUB_BUCKET_COUNT;
+
+    // Пишет только поток-владелец, поэтому обходимся без read-modify-write.
+    void Record(uint64_t value_ns) {
+        auto& counter = counts_[BucketIndex(value_ns)];
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    uint64_t GetCount(size_t bucket) const {
+        return counts_[bucket].load(std::memory_order_relaxed);
+    }
+
+    void Reset();
+
+    static size_t BucketIndex(uint64_t value_ns);
+
+    static uint64_t BucketUpperBound(size_t bucket);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts_{};
+};
+
+// Сводная (не атомарная) копия гистограммы, по которой считаются перцентили.
+class HistogramSnapshot {
+public:
+    void Add(const LatencyHistogram& histogram);
+
+    void Record(uint64_t value_ns);
+
+    uint64_t GetTotalCount() const;
+
+    uint64_t GetMax() const;
+
+    // quantile в диапазоне [0, 1], результат - верхняя граница корзины в нс.
+    uint64_t GetPercentile(double quantile) const;
+
+private:
+    std::array<uint64_t, LatencyHistogram::BUCKET_COUNT> counts_{};
+    uint64_t total_count_ = 0;
+};
+
+class QueryTracer {
+public:
+    static QueryTracer& Instance();
+
+    void Record(QueryStage stage, uint64_t value_ns) {
+        LocalHistograms()[static_cast<size_t>(stage)].Record(value_ns);
+    }
+
+    std::array<HistogramSnapshot, QUERY_STAGE_COUNT> Snapshot() const;
+
+    void Reset();
+
+    // Выводит count/p50/p99/p999/max по каждой стадии.
+    void Dump(std::ostream& os = std::cerr) const;
+
+private:
+    using StageHistograms = std::array<LatencyHistogram, QUERY_STAGE_COUNT>;
+
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<StageHistograms>> histograms_;
+
+    QueryTracer() = default;
+
+    StageHistograms& LocalHistograms() {
+        thread_local std::shared_ptr<StageHistograms> local = Register();
+        return *local;
+    }
+
+    std::shared_ptr<StageHistograms> Register();
+};
+
+class QueryStageTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit QueryStageTimer(QueryStage stage)
+        : stage_(stage)
+    {}
+
+    ~QueryStageTimer() {
+        const auto dur = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_time_);
+        QueryTracer::Instance().Record(stage_, static_cast<uint64_t>(dur.count()));
+    }
+
+private:
+    const QueryStage stage_;
+    const Clock::time_point start_time_ = Clock::now();
+};
+
+#ifdef SEARCH_SERVER_TRACING
+#define TRACE_QUERY_STAGE(stage) QueryStageTimer UNIQUE_VAR_NAME_PROFILE(stage)
+#else
+#define TRACE_QUERY_STAGE(stage)
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+
+// Статистика коллекции, общая для всех слов запроса
+struct CollectionStats {
+    int document_count = 0;
+    double average_document_length = 0.0;
+};
+
+// Ранжирующая функция подставляется в FindTopDocuments шаблонным параметром.
+// ForTerm вызывается один раз на слово запроса и возвращает функтор,
+// который считает вклад слова в релевантность документа:
+//     term_scorer(term_freq, document_length)
+// term_freq - доля слова среди слов документа (как в индексе), document_length -
+// число слов документа без стоп-слов. Функтор не ветвится и встраивается в цикл
+// по постингам. NEEDS_DOCUMENT_LENGTH = false позволяет не читать данные
+// документа ради длины.
+struct ScorerTag {};
+
+template <typename T>
+inline constexpr bool IS_SCORER_V = std::is_base_of_v<ScorerTag, std::decay_t<T>>;
+
+struct TfIdfScorer : ScorerTag {
+    static constexpr bool NEEDS_DOCUMENT_LENGTH = false;
+
+    struct TermScorer {
+        double inverse_document_freq;
+
+        double operator()(double term_freq, int /*document_length*/) const {
+            return term_freq * inverse_document_freq;
+        }
+    };
+
+    TermScorer ForTerm(const CollectionStats& stats, size_t document_freq) const {
+        return {std::log(stats.document_count * 1.0 / document_freq)};
+    }
+};
+
+// Okapi BM25 с idf = ln(1 + (N - n + 0.5) / (n + 0.5)), который не бывает отрицательным
+struct Bm25Scorer : ScorerTag {
+    static constexpr bool NEEDS_DOCUMENT_LENGTH = true;
+
+    double k1 = 1.2;
+    double b = 0.75;
+
+    Bm25Scorer() = default;
+
+    Bm25Scorer(double k1, double b)
+        : k1(k1), b(b)
+    {}
+
+    struct TermScorer {
+        // score = weight * tf / (tf + norm_base + norm_per_word * document_length)
+        double weight;
+        double norm_base;
+        double norm_per_word;
+
+        double operator()(double term_freq, int document_length) const {
+            const double tf = std::nearbyint(term_freq * document_length);
+            return weight * tf / (tf + norm_base + norm_per_word * document_length);
+        }
+    };
+
+    TermScorer ForTerm(const CollectionStats& stats, size_t document_freq) const {
+        const double n = static_cast<double>(document_freq);
+        const double inverse_document_freq = std::log(1.0 + (stats.document_count - n + 0.5) / (n + 0.5));
+        const double average_length = stats.average_document_length > 0.0 ? stats.average_document_length : 1.0;
+        return {inverse_document_freq * (k1 + 1.0), k1 * (1.0 - b), k1 * b / average_length};
+    }
+};
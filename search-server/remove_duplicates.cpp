@@ -3,12 +3,12 @@
 #include "remove_duplicates.h"
 
 void RemoveDuplicates(SearchServer& search_server) {
-    std::map<std::vector<std::string>, int> doc_words;
+    std::map<std::vector<std::string_view>, int> doc_words;
     std::vector<int> duplicate_ids;
 
     for (const int doc_id : search_server) {
-        const std::map<std::string, double> word_freqs = search_server.GetWordFrequencies(doc_id);
-        std::vector<std::string> words;
+        const auto& word_freqs = search_server.GetWordFrequencies(doc_id);
+        std::vector<std::string_view> words;
         words.reserve(word_freqs.size());
 
         for (const auto& [key, val] : word_freqs) {
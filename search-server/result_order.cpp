@@ -0,0 +1,285 @@
+#include "result_order.h"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+constexpr int DIGIT_COUNT = 16;
+constexpr int DIGIT_VALUES = 256;
+// На меньшем числе ключей std::sort быстрее подсчёта гистограмм
+constexpr size_t RADIX_SORT_MIN_SIZE = 256;
+constexpr uint64_t SIGN_BIT = uint64_t{1} << 63;
+
+using DigitCounts = std::array<size_t, DIGIT_VALUES>;
+
+// Разряд 0 - младший байт low, разряд 15 - старший байт high
+uint8_t GetDigit(uint64_t high, uint64_t low, int digit) {
+    return static_cast<uint8_t>(digit < 8 ? low >> (8 * digit) : high >> (8 * (digit - 8)));
+}
+
+uint8_t GetDigit(const ResultKey& key, int digit) {
+    return GetDigit(key.high, key.low, digit);
+}
+
+bool KeyLess(const ResultKey& lhs, const ResultKey& rhs) {
+    return lhs.high != rhs.high ? lhs.high < rhs.high : lhs.low < rhs.low;
+}
+
+// Сравнение FindTopDocuments до упаковки в ключи
+bool RankedLess(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < ACCURACY) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+// Битовая маска разрядов, в которых ключи [first, last) различаются
+uint32_t FindVaryingDigits(const ResultKey* first, const ResultKey* last) {
+    if (first == last) {
+        return 0;
+    }
+    uint64_t high = 0;
+    uint64_t low = 0;
+    for (const ResultKey* it = first; it != last; ++it) {
+        high |= it->high ^ first->high;
+        low |= it->low ^ first->low;
+    }
+    uint32_t digits = 0;
+    for (int digit = 0; digit < DIGIT_COUNT; ++digit) {
+        if (GetDigit(high, low, digit) != 0) {
+            digits |= uint32_t{1} << digit;
+        }
+    }
+    return digits;
+}
+
+// Раскладывает [source, source + size) в target по разряду digit, сохраняя порядок
+// внутри корзины; counts - число ключей каждого значения разряда
+void ScatterByDigit(const ResultKey* source, size_t size, ResultKey* target, int digit, DigitCounts counts) {
+    size_t offset = 0;
+    for (size_t& count : counts) {
+        offset += std::exchange(count, offset);
+    }
+    for (size_t i = 0; i < size; ++i) {
+        target[counts[GetDigit(source[i], digit)]++] = source[i];
+    }
+}
+
+// LSD по разрядам digits; результат в [first, last), buffer не короче диапазона
+void RadixSort(ResultKey* first, ResultKey* last, ResultKey* buffer, uint32_t digits) {
+    const auto size = static_cast<size_t>(last - first);
+    if (size < RADIX_SORT_MIN_SIZE) {
+        std::sort(first, last, KeyLess);
+        return;
+    }
+    std::vector<int> sorted_digits;
+    for (int digit = 0; digit < DIGIT_COUNT; ++digit) {
+        if (digits >> digit & 1) {
+            sorted_digits.push_back(digit);
+        }
+    }
+    // Гистограммы всех разрядов за один проход
+    std::vector<DigitCounts> counts(sorted_digits.size(), DigitCounts{});
+    for (const ResultKey* it = first; it != last; ++it) {
+        for (size_t i = 0; i < sorted_digits.size(); ++i) {
+            ++counts[i][GetDigit(*it, sorted_digits[i])];
+        }
+    }
+
+    ResultKey* source = first;
+    ResultKey* target = buffer;
+    for (size_t i = 0; i < sorted_digits.size(); ++i) {
+        ScatterByDigit(source, size, target, sorted_digits[i], counts[i]);
+        std::swap(source, target);
+    }
+    if (source != first) {
+        std::copy(source, source + size, first);
+    }
+}
+
+} // namespace
+
+ResultKey MakeResultKey(const Document& document, ResultOrder order, uint32_t index) {
+    // Отображение релевантности в число без знака с тем же порядком
+    uint64_t relevance;
+    if (order == ResultOrder::RANKED) {
+        // Границы округления лежат посередине между кратными ACCURACY, поэтому одно
+        // и то же значение, посчитанное с разной погрешностью, попадает в один шаг.
+        // Округление через отбрасывание дробной части - одна инструкция, std::round
+        // без SSE4.1 - вызов libm.
+        constexpr double LIMIT = 0x1p62;
+        const double step = document.relevance / ACCURACY;
+        int64_t quantized;
+        if (std::abs(step) < LIMIT) {
+            quantized = static_cast<int64_t>(step < 0.0 ? step - 0.5 : step + 0.5);
+        } else {
+            quantized = static_cast<int64_t>(step > 0.0 ? LIMIT : -LIMIT);
+        }
+        relevance = static_cast<uint64_t>(quantized) ^ SIGN_BIT;
+    } else if (std::isnan(document.relevance)) {
+        relevance = 0;
+    } else {
+        // -0.0 == 0.0 при сравнении double, поэтому ноль приводится к одному виду
+        const double value = document.relevance == 0.0 ? 0.0 : document.relevance;
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        relevance = (bits & SIGN_BIT) != 0 ? ~bits : bits | SIGN_BIT;
+    }
+    const uint32_t rating = static_cast<uint32_t>(document.rating) ^ 0x80000000u;
+    const uint32_t id = static_cast<uint32_t>(document.id) ^ 0x80000000u;
+    // Ключи идут по возрастанию, поэтому поля, упорядоченные по убыванию, инвертируются
+    return {~relevance, static_cast<uint64_t>(~rating) << 32 | id, index};
+}
+
+void SortResultKeys(const std::execution::sequenced_policy&, std::vector<ResultKey>& keys) {
+    if (keys.size() < RADIX_SORT_MIN_SIZE) {
+        std::sort(keys.begin(), keys.end(), KeyLess);
+        return;
+    }
+    std::vector<ResultKey> buffer(keys.size());
+    RadixSort(keys.data(), keys.data() + keys.size(), buffer.data(), FindVaryingDigits(keys.data(), keys.data() + keys.size()));
+}
+
+void SortResultKeys(const std::execution::parallel_policy&, std::vector<ResultKey>& keys) {
+    const uint32_t digits = FindVaryingDigits(keys.data(), keys.data() + keys.size());
+    if (keys.size() < RADIX_SORT_MIN_SIZE || digits == 0) {
+        SortResultKeys(std::execution::seq, keys);
+        return;
+    }
+    int top_digit = DIGIT_COUNT - 1;
+    while ((digits >> top_digit & 1) == 0) {
+        --top_digit;
+    }
+    DigitCounts counts{};
+    for (const ResultKey& key : keys) {
+        ++counts[GetDigit(key, top_digit)];
+    }
+    std::vector<ResultKey> buffer(keys.size());
+    ScatterByDigit(keys.data(), keys.size(), buffer.data(), top_digit, counts);
+
+    // Корзины старшего разряда не пересекаются, исходный вектор служит им буфером
+    std::array<size_t, DIGIT_VALUES + 1> bounds{};
+    for (int value = 0; value < DIGIT_VALUES; ++value) {
+        bounds[value + 1] = bounds[value] + counts[value];
+    }
+    std::array<int, DIGIT_VALUES> values;
+    for (int value = 0; value < DIGIT_VALUES; ++value) {
+        values[value] = value;
+    }
+    const uint32_t low_digits = digits & ~(uint32_t{1} << top_digit);
+    std::for_each(std::execution::par, values.begin(), values.end(),
+                  [&keys, &buffer, &bounds, low_digits](int value) {
+                      RadixSort(buffer.data() + bounds[value], buffer.data() + bounds[value + 1],
+                                keys.data() + bounds[value], low_digits);
+                  });
+    keys.swap(buffer);
+}
+
+void SelectResultKeys(std::vector<ResultKey>& keys, size_t count) {
+    if (count >= keys.size()) {
+        SortResultKeys(std::execution::seq, keys);
+        return;
+    }
+    std::vector<ResultKey> selected;
+    selected.reserve(count);
+    // Кандидаты - [keys.begin(), last); среди них нужно выбрать ещё needed наименьших
+    auto last = keys.end();
+    size_t needed = count;
+    const uint32_t digits = FindVaryingDigits(keys.data(), keys.data() + keys.size());
+    for (int digit = DIGIT_COUNT - 1; digit >= 0 && needed > 0 && static_cast<size_t>(last - keys.begin()) > needed;
+         --digit) {
+        if ((digits >> digit & 1) == 0) {
+            continue;
+        }
+        DigitCounts counts{};
+        for (auto it = keys.begin(); it != last; ++it) {
+            ++counts[GetDigit(*it, digit)];
+        }
+        // boundary - значение разряда, в корзину которого попал needed-й ключ
+        size_t before = 0;
+        int boundary = 0;
+        while (before + counts[boundary] < needed) {
+            before += counts[boundary++];
+        }
+        // Меньшие корзины выбраны целиком, в кандидатах остаётся только граничная
+        auto kept = keys.begin();
+        for (auto it = keys.begin(); it != last; ++it) {
+            const int value = GetDigit(*it, digit);
+            if (value < boundary) {
+                selected.push_back(*it);
+            } else if (value == boundary) {
+                *kept++ = *it;
+            }
+        }
+        last = kept;
+        needed -= before;
+    }
+    // Кандидатов либо не больше needed, либо все разряды пройдены и их ключи равны
+    selected.insert(selected.end(), keys.begin(), keys.begin() + std::min(needed, static_cast<size_t>(last - keys.begin())));
+    SortResultKeys(std::execution::seq, selected);
+    keys = std::move(selected);
+}
+
+void SelectRankedResultKeys(const std::vector<Document>& documents, std::vector<ResultKey>& keys, size_t count) {
+    if (count >= keys.size()) {
+        SortResultKeys(std::execution::seq, keys);
+        RepairRankedOrder(documents, keys);
+        return;
+    }
+    if (count == 0) {
+        keys.clear();
+        return;
+    }
+    std::vector<ResultKey> selected = keys;
+    SelectResultKeys(selected, count);
+    // Документ следующего шага округления может обойти выбранные документы
+    // граничного шага, поэтому кандидатами становятся оба шага целиком
+    const uint64_t last_high = selected.back().high;
+    selected.clear();
+    for (const ResultKey& key : keys) {
+        if (key.high <= last_high || key.high - last_high == 1) {
+            selected.push_back(key);
+        }
+    }
+    SortResultKeys(std::execution::seq, selected);
+    RepairRankedOrder(documents, selected);
+    selected.resize(count);
+    keys = std::move(selected);
+}
+
+void RepairRankedOrder(const std::vector<Document>& documents, std::vector<ResultKey>& keys) {
+    // Сортировка вставками: документ сдвигается назад, пока старое сравнение ставит
+    // его раньше предыдущего. Внутри шага порядок ключей с ним совпадает, а документы
+    // через шаг различаются больше чем на ACCURACY, поэтому сдвиг не выходит
+    // за пределы соседнего шага
+    for (size_t i = 1; i < keys.size(); ++i) {
+        const ResultKey key = keys[i];
+        size_t j = i;
+        while (j > 0 && key.high - keys[j - 1].high <= 1
+               && RankedLess(documents[key.index], documents[keys[j - 1].index])) {
+            keys[j] = keys[j - 1];
+            --j;
+        }
+        keys[j] = key;
+    }
+}
+
+void ApplyResultKeys(std::vector<Document>& documents, const std::vector<ResultKey>& keys) {
+    std::vector<Document> ordered;
+    ordered.reserve(keys.size());
+    for (const ResultKey& key : keys) {
+        ordered.push_back(documents[key.index]);
+    }
+    documents = std::move(ordered);
+}
+
+void SortResults(std::vector<Document>& documents, ResultOrder order) {
+    SortResults(std::execution::seq, documents, order);
+}
+
+void SelectTopResults(std::vector<Document>& documents, size_t count, ResultOrder order) {
+    SelectTopResults(std::execution::seq, documents, count, order);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <execution>
+#include <vector>
+
+#include "document.h"
+
+const double ACCURACY = 1e-6;
+
+// Порядок документов выдачи. При равных релевантности и рейтинге раньше идёт
+// меньший id, поэтому оба порядка строгие и не зависят от алгоритма сортировки.
+enum class ResultOrder {
+    // FindTopDocuments: релевантность, округлённая до ACCURACY, по убыванию, затем
+    // рейтинг по убыванию. Округление разделяет и близкие релевантности: 1.51e-6
+    // и 1.49e-6 попадают в шаги 2 и 1, хотя сравнение abs(lhs - rhs) < ACCURACY
+    // упорядочило бы их по рейтингу. Поэтому после сортировки ключей документы
+    // соседних шагов переставляются этим сравнением (RepairRankedOrder), и любые
+    // два соседних документа выдачи упорядочены так же, как им. Само сравнение
+    // нетранзитивно (a ~ b, b ~ c, но не a ~ c), и для таких цепочек единственного
+    // порядка, с которым можно было бы совпасть во всей выдаче, нет.
+    RANKED,
+    // FindTopDocumentsPage: точная релевантность по убыванию, затем рейтинг по убыванию
+    EXACT,
+};
+
+// Документ, упакованный в 128-битный ключ: документы идут в выдаче в порядке
+// возрастания (high, low) как беззнаковых чисел. index - позиция документа
+// в исходном векторе.
+struct ResultKey {
+    uint64_t high;
+    uint64_t low;
+    uint32_t index;
+};
+
+ResultKey MakeResultKey(const Document &document, ResultOrder order, uint32_t index);
+
+// Поразрядная сортировка LSD по байтам ключа; байты, одинаковые у всех ключей,
+// пропускаются. Параллельный вариант раскладывает ключи по старшему различающемуся
+// байту и сортирует корзины независимо.
+void SortResultKeys(const std::execution::sequenced_policy &, std::vector<ResultKey> &keys);
+
+void SortResultKeys(const std::execution::parallel_policy &, std::vector<ResultKey> &keys);
+
+// Оставляет count наименьших ключей по возрастанию. Поразрядный выбор от старшего
+// байта: на каждом шаге остаются только ключи корзины, в которую попал count-й.
+void SelectResultKeys(std::vector<ResultKey> &keys, size_t count);
+
+// Как SelectResultKeys для ключей ResultOrder::RANKED, но с перестановкой
+// RepairRankedOrder: кандидатами выбора служат ещё документы шага округления,
+// следующего за граничным, - они могут обойти выбранные
+void SelectRankedResultKeys(const std::vector<Document> &documents, std::vector<ResultKey> &keys, size_t count);
+
+// Переставляет отсортированные ключи ResultOrder::RANKED так, чтобы каждый документ
+// стоял не раньше предыдущего по сравнению abs(lhs - rhs) < ACCURACY, затем рейтинг.
+// Сдвигаются только документы соседних шагов округления с почти равной
+// релевантностью; время - O(n) плюс число таких перестановок.
+void RepairRankedOrder(const std::vector<Document> &documents, std::vector<ResultKey> &keys);
+
+// Переставляет documents в порядок keys и оставляет keys.size() документов
+void ApplyResultKeys(std::vector<Document> &documents, const std::vector<ResultKey> &keys);
+
+template <typename ExecutionPolicy>
+std::vector<ResultKey> MakeResultKeys(ExecutionPolicy &&policy, const std::vector<Document> &documents,
+                                      ResultOrder order);
+
+// Все документы в порядке order
+template <typename ExecutionPolicy>
+void SortResults(ExecutionPolicy &&policy, std::vector<Document> &documents, ResultOrder order = ResultOrder::RANKED);
+
+void SortResults(std::vector<Document> &documents, ResultOrder order = ResultOrder::RANKED);
+
+// Первые count документов в порядке order, остальные удаляются
+template <typename ExecutionPolicy>
+void SelectTopResults(ExecutionPolicy &&policy, std::vector<Document> &documents, size_t count,
+                      ResultOrder order = ResultOrder::RANKED);
+
+void SelectTopResults(std::vector<Document> &documents, size_t count, ResultOrder order = ResultOrder::RANKED);
+
+template <typename ExecutionPolicy>
+std::vector<ResultKey> MakeResultKeys(ExecutionPolicy&& policy, const std::vector<Document>& documents,
+                                      ResultOrder order) {
+    std::vector<ResultKey> keys(documents.size());
+    std::transform(policy, documents.begin(), documents.end(), keys.begin(),
+                   [&documents, order](const Document& document) {
+                       return MakeResultKey(document, order, static_cast<uint32_t>(&document - documents.data()));
+                   });
+    return keys;
+}
+
+template <typename ExecutionPolicy>
+void SortResults(ExecutionPolicy&& policy, std::vector<Document>& documents, ResultOrder order) {
+    std::vector<ResultKey> keys = MakeResultKeys(policy, documents, order);
+    SortResultKeys(policy, keys);
+    if (order == ResultOrder::RANKED) {
+        RepairRankedOrder(documents, keys);
+    }
+    ApplyResultKeys(documents, keys);
+}
+
+template <typename ExecutionPolicy>
+void SelectTopResults(ExecutionPolicy&& policy, std::vector<Document>& documents, size_t count, ResultOrder order) {
+    std::vector<ResultKey> keys = MakeResultKeys(policy, documents, order);
+    if (order == ResultOrder::RANKED) {
+        SelectRankedResultKeys(documents, keys, count);
+    } else {
+        SelectResultKeys(keys, count);
+    }
+    ApplyResultKeys(documents, keys);
+}
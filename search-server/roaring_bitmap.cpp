@@ -0,0 +1,164 @@
+#include "roaring_bitmap.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+uint16_t HighBits(uint32_t value) {
+    return static_cast<uint16_t>(value >> 16);
+}
+
+uint16_t LowBits(uint32_t value) {
+    return static_cast<uint16_t>(value & 0xFFFF);
+}
+
+} // namespace
+
+bool RoaringBitmap::Container::Contains(uint16_t low) const {
+    if (IsBitmap()) {
+        return (bits[low >> 6] >> (low & 63)) & 1;
+    }
+    return std::binary_search(array.begin(), array.end(), low);
+}
+
+void RoaringBitmap::Container::ConvertToBitmap() {
+    bits.assign(BITMAP_WORDS, 0);
+    for (const uint16_t low : array) {
+        bits[low >> 6] |= uint64_t(1) << (low & 63);
+    }
+    array.clear();
+    array.shrink_to_fit();
+}
+
+RoaringBitmap::Container& RoaringBitmap::GetOrInsertContainer(uint16_t key) {
+    // Значения обычно добавляются по возрастанию - сначала проверяем последний контейнер
+    if (!containers_.empty() && containers_.back().key == key) {
+        return containers_.back();
+    }
+    const auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+                                     [](const Container& container, uint16_t k) { return container.key < k; });
+    if (it != containers_.end() && it->key == key) {
+        return *it;
+    }
+    Container container;
+    container.key = key;
+    return *containers_.insert(it, std::move(container));
+}
+
+void RoaringBitmap::Add(uint32_t value) {
+    Container& container = GetOrInsertContainer(HighBits(value));
+    const uint16_t low = LowBits(value);
+    if (container.IsBitmap()) {
+        uint64_t& word = container.bits[low >> 6];
+        const uint64_t mask = uint64_t(1) << (low & 63);
+        container.cardinality += (word & mask) == 0;
+        word |= mask;
+        return;
+    }
+
+    auto& array = container.array;
+    if (array.empty() || array.back() < low) {
+        array.push_back(low);
+    } else {
+        const auto it = std::lower_bound(array.begin(), array.end(), low);
+        if (*it == low) {
+            return;
+        }
+        array.insert(it, low);
+    }
+    ++container.cardinality;
+    if (container.cardinality > ARRAY_LIMIT) {
+        container.ConvertToBitmap();
+    }
+}
+
+bool RoaringBitmap::Contains(uint32_t value) const {
+    const uint16_t key = HighBits(value);
+    const auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+                                     [](const Container& container, uint16_t k) { return container.key < k; });
+    return it != containers_.end() && it->key == key && it->Contains(LowBits(value));
+}
+
+RoaringBitmap& RoaringBitmap::operator|=(const RoaringBitmap& other) {
+    for (const Container& source : other.containers_) {
+        Container& target = GetOrInsertContainer(source.key);
+        if (!target.IsBitmap() && !source.IsBitmap()) {
+            std::vector<uint16_t> merged;
+            merged.reserve(target.array.size() + source.array.size());
+            std::set_union(target.array.begin(), target.array.end(),
+                           source.array.begin(), source.array.end(), std::back_inserter(merged));
+            target.array = std::move(merged);
+            target.cardinality = static_cast<uint32_t>(target.array.size());
+            if (target.cardinality > ARRAY_LIMIT) {
+                target.ConvertToBitmap();
+            }
+            continue;
+        }
+
+        if (!target.IsBitmap()) {
+            target.ConvertToBitmap();
+        }
+        if (source.IsBitmap()) {
+            for (size_t i = 0; i < BITMAP_WORDS; ++i) {
+                target.bits[i] |= source.bits[i];
+            }
+        } else {
+            for (const uint16_t low : source.array) {
+                target.bits[low >> 6] |= uint64_t(1) << (low & 63);
+            }
+        }
+        target.cardinality = 0;
+        for (const uint64_t word : target.bits) {
+            target.cardinality += static_cast<uint32_t>(__builtin_popcountll(word));
+        }
+    }
+    return *this;
+}
+
+bool RoaringBitmap::IsEmpty() const {
+    return containers_.empty();
+}
+
+size_t RoaringBitmap::GetCardinality() const {
+    size_t cardinality = 0;
+    for (const Container& container : containers_) {
+        cardinality += container.cardinality;
+    }
+    return cardinality;
+}
+
+size_t RoaringBitmap::GetMemoryBytes() const {
+    size_t bytes = containers_.capacity() * sizeof(Container);
+    for (const Container& container : containers_) {
+        bytes += container.array.capacity() * sizeof(uint16_t) + container.bits.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+RoaringBitmap::SequentialReader::SequentialReader(const RoaringBitmap& bitmap)
+    : bitmap_(bitmap)
+{}
+
+bool RoaringBitmap::SequentialReader::Contains(uint32_t value) {
+    const auto& containers = bitmap_.containers_;
+    const uint16_t key = HighBits(value);
+    while (container_ < containers.size() && containers[container_].key < key) {
+        ++container_;
+        position_ = 0;
+    }
+    if (container_ == containers.size() || containers[container_].key != key) {
+        return false;
+    }
+
+    const Container& container = containers[container_];
+    const uint16_t low = LowBits(value);
+    if (container.IsBitmap()) {
+        return container.Contains(low);
+    }
+    const auto& array = container.array;
+    while (position_ < array.size() && array[position_] < low) {
+        ++position_;
+    }
+    return position_ < array.size() && array[position_] == low;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Сжатое множество 32-битных чисел в духе Roaring: старшие 16 бит выбирают
+// контейнер, младшие хранятся в нём отсортированным массивом uint16_t, пока
+// значений не больше ARRAY_LIMIT, иначе - битовой картой на 65536 бит (8 КиБ).
+// Редкие множества занимают 2 байта на элемент, плотные - 1 бит.
+class RoaringBitmap {
+public:
+    // Дальше этого массив занимает больше места, чем битовая карта
+    static constexpr size_t ARRAY_LIMIT = 4096;
+
+    void Add(uint32_t value);
+
+    bool Contains(uint32_t value) const;
+
+    RoaringBitmap& operator|=(const RoaringBitmap& other);
+
+    bool IsEmpty() const;
+
+    size_t GetCardinality() const;
+
+    size_t GetMemoryBytes() const;
+
+    // Проверка неубывающей последовательности значений, например id из списка
+    // постингов: помнит текущий контейнер и позицию в массиве, поэтому весь
+    // проход стоит O(длина последовательности + размер карты)
+    class SequentialReader {
+    public:
+        explicit SequentialReader(const RoaringBitmap& bitmap);
+
+        bool Contains(uint32_t value);
+
+    private:
+        const RoaringBitmap& bitmap_;
+        size_t container_ = 0;
+        size_t position_ = 0;
+    };
+
+private:
+    static constexpr size_t BITMAP_WORDS = 65536 / 64;
+
+    struct Container {
+        uint16_t key = 0;
+        uint32_t cardinality = 0;
+        // Заполнено что-то одно: array, пока cardinality <= ARRAY_LIMIT, иначе bits
+        std::vector<uint16_t> array;
+        std::vector<uint64_t> bits;
+
+        bool IsBitmap() const {
+            return !bits.empty();
+        }
+
+        bool Contains(uint16_t low) const;
+
+        void ConvertToBitmap();
+    };
+
+    // Отсортированы по key
+    std::vector<Container> containers_;
+
+    Container& GetOrInsertContainer(uint16_t key);
+};
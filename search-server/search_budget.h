@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "document.h"
+
+// Ограничение работы одного запроса; значения по умолчанию ничего не ограничивают
+struct SearchBudget {
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point deadline = Clock::time_point::max();
+    // Сколько постингов запрос может прочитать
+    size_t max_postings = std::numeric_limits<size_t>::max();
+
+    static SearchBudget WithTimeout(Clock::duration timeout) {
+        SearchBudget budget;
+        budget.deadline = Clock::now() + timeout;
+        return budget;
+    }
+};
+
+struct SearchResult {
+    std::vector<Document> documents;
+    // Бюджет исчерпан: documents - лучшие среди документов прочитанных постингов
+    bool truncated = false;
+};
+
+// Учёт работы запроса. Постинги считаются по одному, а лимит и часы проверяются
+// раз в CHECK_INTERVAL постингов: прочитать часы дороже, чем обработать постинг.
+class BudgetTracker {
+public:
+    static constexpr size_t CHECK_INTERVAL = 1024;
+
+    // Бюджет копируется: трекер можно создать и из временного SearchBudget
+    explicit BudgetTracker(const SearchBudget& budget)
+        : budget_(budget)
+    {}
+
+    // Учитывает count прочитанных постингов; false - бюджет исчерпан, обход пора прекращать
+    bool Consume(size_t count = 1) {
+        consumed_ += count;
+        return consumed_ < next_check_ || Check();
+    }
+
+    // Работа вне постингов, например проверка кандидатов: лимит постингов не
+    // расходует, срок проверяется раз в CHECK_INTERVAL вызовов; false - срок истёк
+    bool Tick() {
+        if (++ticks_ % CHECK_INTERVAL == 0 && !expired_) {
+            expired_ = SearchBudget::Clock::now() >= budget_.deadline;
+            exhausted_ = exhausted_ || expired_;
+        }
+        return !expired_;
+    }
+
+    bool IsExhausted() const {
+        return exhausted_;
+    }
+
+    size_t GetConsumed() const {
+        return consumed_;
+    }
+
+private:
+    const SearchBudget budget_;
+    size_t consumed_ = 0;
+    size_t next_check_ = 0;
+    size_t ticks_ = 0;
+    bool exhausted_ = false;
+    bool expired_ = false;
+
+    bool Check() {
+        expired_ = expired_ || SearchBudget::Clock::now() >= budget_.deadline;
+        exhausted_ = exhausted_ || expired_ || consumed_ >= budget_.max_postings;
+        // После исчерпания каждый вызов Consume снова приходит сюда и получает false
+        next_check_ = exhausted_ ? consumed_ : std::min(consumed_ + CHECK_INTERVAL, budget_.max_postings);
+        return !exhausted_;
+    }
+};
@@ -1,15 +1,50 @@
 #include "search_server.h"
 
+#include <charconv>
+#include <cstring>
 #include <numeric>
+#include <optional>
+#include <tuple>
 
-SearchServer::SearchServer(const std::string& stop_words_text)
-    : SearchServer(SplitIntoWords(std::string_view(stop_words_text)))
+SearchServer::SearchServer(const std::string& stop_words_text, AnalyzerFunction analyzer)
+    : SearchServer(SplitIntoWords(std::string_view(stop_words_text)), analyzer)
 {}
 
-SearchServer::SearchServer(const std::string_view stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text))
+SearchServer::SearchServer(const std::string_view stop_words_text, AnalyzerFunction analyzer)
+    : SearchServer(SplitIntoWords(stop_words_text), analyzer)
 {}
 
+SearchServer& SearchServer::operator=(SearchServer&& other) noexcept {
+    // Поэлементное присваивание сначала освободило бы memory_, а контейнеры
+    // вернули бы свои узлы уже в удалённые счётчики. Обмен переносит контейнеры
+    // вместе со счётчиками, старое состояние уходит в moved и удаляется там.
+    SearchServer moved(std::move(other));
+    Swap(moved);
+    return *this;
+}
+
+void SearchServer::Swap(SearchServer& other) noexcept {
+    using std::swap;
+    swap(memory_, other.memory_);
+    swap(analyzer_, other.analyzer_);
+    swap(stop_words_, other.stop_words_);
+    swap(dictionary_, other.dictionary_);
+    swap(word_to_document_freqs_, other.word_to_document_freqs_);
+    swap(document_to_word_freqs_, other.document_to_word_freqs_);
+    swap(documents_, other.documents_);
+    swap(docs_id_, other.docs_id_);
+    swap(total_word_count_, other.total_word_count_);
+    swap(status_documents_, other.status_documents_);
+    swap(attributes_, other.attributes_);
+    swap(posting_storage_, other.posting_storage_);
+    swap(positions_enabled_, other.positions_enabled_);
+    swap(fuzzy_, other.fuzzy_);
+    swap(document_to_word_positions_, other.document_to_word_positions_);
+    swap(server_id_, other.server_id_);
+    swap(index_version_, other.index_version_);
+    swap(minus_cache_, other.minus_cache_);
+}
+
 void SearchServer::AddDocument(int document_id,
                                const std::string_view document,
                                DocumentStatus status,
@@ -19,21 +54,19 @@ void SearchServer::AddDocument(int document_id,
     if (documents_.count(document_id) > 0)
         throw std::invalid_argument("document id - " + std::to_string(document_id) + " already exists");
 
-    // Save string
-    const std::string current_document_string = std::string(document);
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status, current_document_string});
+    InsertDocument(document_id, status, ratings, PrepareDocument(document));
+}
 
-    // Use saved string through string_view
-    const std::vector<std::string_view> words = SplitIntoWordsNoStop(documents_.at(document_id).data);
+void SearchServer::AddDocuments(const std::vector<DocumentRecord>& records) {
+    AddDocuments(std::execution::seq, records);
+}
 
-    for (const std::string_view word : words) {
-        if (!IsValidWord(word))
-            throw std::invalid_argument("AddDocument word : contains an invalid character");
+void SearchServer::AddDocuments(const std::execution::sequenced_policy&, const std::vector<DocumentRecord>& records) {
+    AddDocumentsImpl(std::execution::seq, records);
+}
 
-        word_to_document_freqs_[word][document_id] += 1.0 / words.size();
-        document_to_word_freqs_[document_id][word] += 1.0 / words.size();
-    }
-    docs_id_.insert(document_id);
+void SearchServer::AddDocuments(const std::execution::parallel_policy&, const std::vector<DocumentRecord>& records) {
+    AddDocumentsImpl(std::execution::par, records);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query) const {
@@ -41,47 +74,180 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus needed_status) const {
-    return FindTopDocuments(raw_query, [needed_status](int document_id, DocumentStatus status, int rating) {
-        return status == needed_status;
-    });
+    return FindTopDocuments(raw_query, DocumentStatusFilter{needed_status});
+}
+
+SearchResult SearchServer::FindTopDocuments(const std::string_view raw_query, const SearchBudget& budget,
+                                            DocumentStatus needed_status) const {
+    const Query query = ParseQuery(raw_query);
+    BudgetTracker tracker(budget);
+    SearchResult result;
+    result.documents = FindAllDocuments(TfIdfScorer(), query, DocumentStatusFilter{needed_status}, nullptr, &tracker);
+    result.truncated = tracker.IsExhausted();
+
+    TRACE_QUERY_STAGE(QueryStage::TOP_K);
+    SelectTopDocuments(result.documents);
+    return result;
+}
+
+IndexSource SearchServer::GetIndexSource() const {
+    return {server_id_.Get(), index_version_};
+}
+
+ImpactIndex SearchServer::BuildImpactIndex(DocumentStatus status) const {
+    const CollectionStats stats = GetCollectionStats();
+    const TfIdfScorer scorer;
+    const StatusDocuments& documents = status_documents_[static_cast<size_t>(status)];
+
+    // Шаг квантования зависит от наибольшего вклада, поэтому вклады сначала
+    // собираются за один проход по индексу, а квантуются потом
+    std::vector<std::pair<int, double>> impacts;
+    std::vector<std::pair<std::string_view, size_t>> term_ends;
+    double max_impact = 0.0;
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        if (postings.empty()) {
+            continue;
+        }
+        const auto term_scorer = scorer.ForTerm(stats, postings.size());
+        for (const auto [document_id, term_freq] : postings) {
+            if (documents.Test(document_id)) {
+                impacts.emplace_back(document_id, term_scorer(term_freq, 0));
+                max_impact = std::max(max_impact, impacts.back().second);
+            }
+        }
+        term_ends.emplace_back(word, impacts.size());
+    }
+
+    ImpactIndex index(max_impact, GetIndexSource());
+    for (const int document_id : docs_id_) {
+        if (documents.Test(document_id)) {
+            index.AddDocument(document_id, documents_.at(document_id).rating);
+        }
+    }
+    size_t term_begin = 0;
+    for (const auto [word, term_end] : term_ends) {
+        index.AddTerm(word, impacts.begin() + term_begin, impacts.begin() + term_end);
+        term_begin = term_end;
+    }
+    return index;
+}
+
+SearchResult SearchServer::FindTopDocumentsByImpact(const ImpactIndex& index, const std::string_view raw_query,
+                                                    const SearchBudget& budget) const {
+    if (index.GetSource() != GetIndexSource())
+        throw std::invalid_argument("FindTopDocumentsByImpact: impact index is out of date or built by another server");
+    const Query query = ParseQuery(raw_query);
+    if (!query.phrases.empty() || !query.required_words.empty())
+        throw std::invalid_argument("FindTopDocumentsByImpact: phrases and required words are not supported");
+
+    TRACE_QUERY_STAGE(QueryStage::POSTINGS);
+    return index.FindTopDocuments(query.plus_words, query.minus_words, MAX_RESULT_DOCUMENT_COUNT, budget);
+}
+
+CompactIndex SearchServer::BuildCompactIndex(DocumentStatus status) const {
+    const StatusDocuments& documents = status_documents_[static_cast<size_t>(status)];
+    CompactIndex index(GetDocumentCount(), GetIndexSource());
+    for (const int document_id : docs_id_) {
+        if (documents.Test(document_id)) {
+            index.AddDocument(document_id, documents_.at(document_id).rating);
+        }
+    }
+    std::vector<std::pair<int, double>> term_freqs;
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        term_freqs.clear();
+        for (const auto [document_id, term_freq] : postings) {
+            if (documents.Test(document_id)) {
+                term_freqs.emplace_back(document_id, term_freq);
+            }
+        }
+        index.AddTerm(word, postings.size(), term_freqs.begin(), term_freqs.end());
+    }
+    return index;
+}
+
+std::vector<Document> SearchServer::FindTopDocumentsCompact(const CompactIndex& index, const std::string_view raw_query,
+                                                           CompactIndex::Kernel kernel) const {
+    if (index.GetSource() != GetIndexSource())
+        throw std::invalid_argument("FindTopDocumentsCompact: compact index is out of date or built by another server");
+    const Query query = ParseQuery(raw_query);
+    if (!query.phrases.empty() || !query.required_words.empty())
+        throw std::invalid_argument("FindTopDocumentsCompact: phrases and required words are not supported");
+
+    std::vector<Document> matched_documents;
+    {
+        TRACE_QUERY_STAGE(QueryStage::POSTINGS);
+        matched_documents = index.FindAllDocuments(query.plus_words, query.minus_words, kernel);
+    }
+    TRACE_QUERY_STAGE(QueryStage::TOP_K);
+    SelectTopDocuments(matched_documents);
+    return matched_documents;
+}
+
+QueryPlan SearchServer::Explain(const std::string_view raw_query, DocumentStatus status) const {
+    const Query query = ParseQuery(raw_query);
+    QueryPlan plan;
+    plan.documents = FindAllDocuments(TfIdfScorer(), query, DocumentStatusFilter{status}, &plan);
+
+    TRACE_QUERY_STAGE(QueryStage::TOP_K);
+    SelectTopDocuments(plan.documents);
+    return plan;
+}
+
+std::vector<Document> SearchServer::FindTopDocumentsByRating(const std::string_view raw_query,
+                                                             const AttributeFilter& filter) const {
+    const Query query = ParseQuery(raw_query);
+    std::vector<Document> matched_documents = FindAllDocuments(TfIdfScorer(), query, filter);
+
+    TRACE_QUERY_STAGE(QueryStage::TOP_K);
+    const size_t count = std::min(matched_documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    std::partial_sort(matched_documents.begin(), matched_documents.begin() + count, matched_documents.end(),
+                      [](const Document& lhs, const Document& rhs) {
+                          return std::tie(rhs.rating, rhs.relevance, lhs.id) < std::tie(lhs.rating, lhs.relevance, rhs.id);
+                      });
+    matched_documents.resize(count);
+    return matched_documents;
 }
 
 int SearchServer::GetDocumentCount() const {
     return documents_.size();
 }
 
-const std::set<int>::const_iterator SearchServer::begin() const {
+SearchServer::DocumentIds::const_iterator SearchServer::begin() const {
     return docs_id_.begin();
 }
 
-const std::set<int>::const_iterator SearchServer::end() const {
+SearchServer::DocumentIds::const_iterator SearchServer::end() const {
     return docs_id_.end();
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
-    if (!docs_id_.count(document_id))
-        throw std::out_of_range("MatchDocument out_of_range - передан не сущ. id ");
+IndexMemoryStats SearchServer::GetMemoryStats() const {
+    IndexMemoryStats stats;
+    stats.document_bytes = memory_->documents.GetBytes();
+    stats.dictionary_bytes = memory_->dictionary.GetBytes();
+    stats.posting_bytes = memory_->postings.GetBytes();
+    stats.reverse_index_bytes = memory_->reverse_index.GetBytes();
+    stats.document_id_bytes = memory_->document_ids.GetBytes();
+    stats.position_bytes = memory_->positions.GetBytes();
+    stats.attribute_bytes = memory_->attributes.GetBytes();
+    stats.status_document_bytes = memory_->status_documents.GetBytes();
+    stats.minus_cache_bytes = memory_->minus_cache.GetBytes();
 
-    const Query query = ParseQuery(raw_query);
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0)
-            continue;
-
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return {{}, documents_.at(document_id).status};
+    stats.document_count = documents_.size();
+    stats.term_count = word_to_document_freqs_.size();
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        stats.posting_count += postings.size();
+        if (postings.empty()) {
+            ++stats.empty_posting_lists;
         }
     }
+    return stats;
+}
 
-    std::vector<std::string_view> matched_words;
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0)
-            continue;
-
-        if (word_to_document_freqs_.at(word).count(document_id))
-            matched_words.push_back(word);
-    }
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
+    if (!docs_id_.count(document_id))
+        throw std::out_of_range("MatchDocument out_of_range - передан не сущ. id ");
 
-    return {matched_words, documents_.at(document_id).status};
+    return MatchQuery(ParseQuery(raw_query), document_id);
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy&,
@@ -90,56 +256,94 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
     return MatchDocument(raw_query, document_id);
 }
 
+// Слияние слов запроса с прямым индексом линейно и последовательно по природе,
+// параллелить его внутри одного документа нет смысла - параллельна пакетная версия MatchDocuments
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy&,
                                                                                       const std::string_view raw_query,
                                                                                       int document_id) const {
-    if (!docs_id_.count(document_id))
-        throw std::out_of_range("MatchDocument out_of_range - передан не сущ. id ");
+    return MatchDocument(raw_query, document_id);
+}
 
-    const Query query = ParseQuery(raw_query);
-    if (std::any_of(std::execution::par,
-                    query.minus_words.cbegin(),
-                    query.minus_words.cend(),
-                    [this, document_id](const std::string_view word) {
-                        return (word_to_document_freqs_.count(word) > 0 &&
-                                word_to_document_freqs_.at(word).count(document_id) > 0);
-                    })) {
-        return { {}, documents_.at(document_id).status };
-    }
+std::vector<SearchServer::MatchResult> SearchServer::MatchDocuments(const std::string_view raw_query,
+                                                                   const std::vector<int>& document_ids) const {
+    return MatchDocuments(std::execution::seq, raw_query, document_ids);
+}
 
-    std::vector<std::string_view> matched_words;
-    matched_words.reserve(query.plus_words.size());
+SearchServer::MatchResult SearchServer::MatchQuery(const Query& query, int document_id) const {
+    const DocumentStatus status = documents_.at(document_id).status;
+    const std::vector<std::string_view> document_words = GetDocumentTerms(document_id);
 
-    const auto& it = std::copy_if(std::execution::par,
-                                  query.plus_words.cbegin(),
-                                  query.plus_words.cend(),
-                                  matched_words.begin(),
-                                  [this, document_id](const std::string_view word) {
-                                      return (word_to_document_freqs_.count(word) > 0 && word_to_document_freqs_.at(word).count(document_id) > 0);
-                                  });
+    // Обе последовательности отсортированы по std::less<std::string_view>
+    auto document_it = document_words.begin();
+    for (const std::string_view word : query.minus_words) {
+        while (document_it != document_words.end() && *document_it < word) {
+            ++document_it;
+        }
+        if (document_it == document_words.end()) {
+            break;
+        }
+        if (*document_it == word) {
+            return {std::vector<std::string_view>{}, status};
+        }
+    }
 
-    matched_words.erase(it, matched_words.end());
+    document_it = document_words.begin();
+    for (const std::string_view word : query.required_words) {
+        while (document_it != document_words.end() && *document_it < word) {
+            ++document_it;
+        }
+        if (document_it == document_words.end() || *document_it != word) {
+            return {std::vector<std::string_view>{}, status};
+        }
+    }
+
+    double relevance = 0.0;
+    if (!query.phrases.empty() && !MatchPhrases(query, document_id, relevance)) {
+        return {std::vector<std::string_view>{}, status};
+    }
 
-    std::sort(std::execution::par, matched_words.begin(), matched_words.end());
-    const auto& itr = std::unique(matched_words.begin(), matched_words.end());
-    matched_words.erase(itr, matched_words.end());
+    std::vector<std::string_view> matched_words;
+    document_it = document_words.begin();
+    for (const std::string_view word : query.plus_words) {
+        while (document_it != document_words.end() && *document_it < word) {
+            ++document_it;
+        }
+        if (document_it == document_words.end()) {
+            break;
+        }
+        if (*document_it == word) {
+            // Слова документа ссылаются на словарь сервера, а не на текст запроса
+            matched_words.push_back(*document_it);
+        }
+    }
 
-    return { matched_words, documents_.at(document_id).status };
+    if (!query.fuzzy_words.empty()) {
+        for (const FuzzyWord& fuzzy : query.fuzzy_words) {
+            if (std::binary_search(document_words.begin(), document_words.end(), fuzzy.word)) {
+                matched_words.push_back(fuzzy.word);
+            }
+        }
+        std::sort(matched_words.begin(), matched_words.end());
+    }
+    return {matched_words, status};
 }
 
 bool SearchServer::IsStopWord(const std::string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
+}
+
+std::string_view SearchServer::InternWord(const std::string_view word) {
+    if (const auto it = word_to_document_freqs_.find(word); it != word_to_document_freqs_.end()) {
+        return it->first;
+    }
+    return dictionary_.Store(word);
 }
 
 void SearchServer::RemoveDocument(int document_id) {
-    if (document_to_word_freqs_.count(document_id) == 1) {
-        for (const auto& [word, freq] : document_to_word_freqs_.at(document_id)) {
-            word_to_document_freqs_.at(word).erase(document_id);
-        }
+    for (const std::string_view word : GetDocumentTerms(document_id)) {
+        word_to_document_freqs_.at(word).erase(document_id);
     }
-    document_to_word_freqs_.erase(document_id);
-    documents_.erase(document_id);
-    docs_id_.erase(document_id);
+    EraseDocumentData(document_id);
 }
 
 void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int document_id) {
@@ -147,47 +351,853 @@ void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int d
 }
 
 void SearchServer::RemoveDocument(const std::execution::parallel_policy&, int document_id) {
-    if (document_to_word_freqs_.count(document_id) == 1) {
-        std::vector<std::string_view> words_to_erase(document_to_word_freqs_.at(document_id).size());
-
-        std::transform(std::execution::par,
-                       document_to_word_freqs_.at(document_id).cbegin(),
-                       document_to_word_freqs_.at(document_id).cend(),
-                       words_to_erase.begin(),
-                       [](const auto words) {
-                           return words.first;
-                       });
-
-        std::for_each(std::execution::par,
-                      words_to_erase.cbegin(),
-                      words_to_erase.cend(),
-                      [this, document_id](const auto word) {
-                          word_to_document_freqs_.at(word).erase(document_id);
-                      });
-    }
+    const std::vector<std::string_view> words_to_erase = GetDocumentTerms(document_id);
+    std::for_each(std::execution::par,
+                  words_to_erase.cbegin(),
+                  words_to_erase.cend(),
+                  [this, document_id](const auto word) {
+                      word_to_document_freqs_.at(word).erase(document_id);
+                  });
+    EraseDocumentData(document_id);
+}
+
+void SearchServer::EraseDocumentData(int document_id) {
     document_to_word_freqs_.erase(document_id);
-    documents_.erase(document_id);
+    document_to_word_positions_.erase(document_id);
+    if (const auto it = documents_.find(document_id); it != documents_.end()) {
+        total_word_count_ -= it->second.word_count;
+        status_documents_[static_cast<size_t>(it->second.status)].Reset(document_id);
+        attributes_.Remove(document_id);
+        documents_.erase(it);
+    }
     docs_id_.erase(document_id);
+    ++index_version_;
+}
+
+SearchServer::MinusWordCache::MinusWordCache(MemoryCounter& counter)
+    : counter(counter),
+      requests(TermMap<int>::allocator_type(counter)),
+      bitmaps(TermMap<std::shared_ptr<const RoaringBitmap>>::allocator_type(counter))
+{}
+
+void SearchServer::MinusWordCache::Insert(std::string_view term, std::shared_ptr<const RoaringBitmap> bitmap) {
+    if (bitmaps.size() >= MINUS_CACHE_CAPACITY) {
+        ClearBitmaps();
+    }
+    const size_t bytes = bitmap->GetMemoryBytes();
+    if (bitmaps.emplace(term, std::move(bitmap)).second) {
+        counter.Allocate(bytes);
+    }
+}
+
+void SearchServer::MinusWordCache::Clear() {
+    ClearBitmaps();
+    requests.clear();
+}
+
+void SearchServer::MinusWordCache::ClearBitmaps() {
+    for (const auto& [_, cached] : bitmaps) {
+        counter.Deallocate(cached->GetMemoryBytes());
+    }
+    bitmaps.clear();
+}
+
+std::shared_ptr<const RoaringBitmap> SearchServer::GetMinusWordBitmap(std::string_view term,
+                                                                      const PostingList& postings) const {
+    MinusWordCache& cache = *minus_cache_;
+    bool should_cache = false;
+    {
+        std::lock_guard guard(cache.mutex);
+        if (cache.index_version != index_version_) {
+            cache.Clear();
+            cache.index_version = index_version_;
+        }
+        if (const auto it = cache.bitmaps.find(term); it != cache.bitmaps.end()) {
+            return it->second;
+        }
+        should_cache = ++cache.requests[term] >= MINUS_CACHE_MIN_REQUESTS;
+    }
+
+    // Постинги отсортированы по id, поэтому вставка идёт в конец контейнеров
+    auto bitmap = std::make_shared<RoaringBitmap>();
+    for (const auto& [document_id, _] : postings) {
+        bitmap->Add(static_cast<uint32_t>(document_id));
+    }
+    if (should_cache) {
+        std::lock_guard guard(cache.mutex);
+        cache.Insert(term, bitmap);
+    }
+    return bitmap;
+}
+
+std::shared_ptr<const RoaringBitmap> SearchServer::BuildMinusFilter(const ExecutionPlan& plan) const {
+    static const auto empty_filter = std::make_shared<const RoaringBitmap>();
+    if (!plan.minus_words_first) {
+        return empty_filter;
+    }
+
+    std::shared_ptr<const RoaringBitmap> filter;
+    std::shared_ptr<RoaringBitmap> merged;
+    for (const PlannedTerm& term : plan.minus_terms) {
+        auto bitmap = GetMinusWordBitmap(term.word, *term.postings);
+        if (!filter) {
+            // Единственное минус-слово используется без копирования
+            filter = std::move(bitmap);
+            continue;
+        }
+        if (!merged) {
+            merged = std::make_shared<RoaringBitmap>(*filter);
+            filter = merged;
+        }
+        *merged |= *bitmap;
+    }
+    return filter ? filter : empty_filter;
+}
+
+bool SearchServer::IsExcludedByMinusWords(const ExecutionPlan& plan, int document_id, QueryPlan* explanation) const {
+    for (size_t i = 0; i < plan.minus_terms.size(); ++i) {
+        QueryPlanStep* counters = explanation ? &explanation->steps[plan.scored_terms.size() + i] : nullptr;
+        if (counters) {
+            ++counters->postings_visited;
+        }
+        if (plan.minus_terms[i].postings->count(document_id) > 0) {
+            if (counters) {
+                ++counters->erasures;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+SearchServer::ExecutionPlan SearchServer::PlanQuery(const Query& query) const {
+    ExecutionPlan plan;
+    const auto add_term = [this](std::vector<PlannedTerm>& terms, std::string_view word, double weight, QueryStepKind kind) {
+        // Ключ берётся из индекса: word может ссылаться на текст запроса
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end() && !it->second.empty()) {
+            // Слова добавляются в порядке сложения: plus-слова по алфавиту, затем исправления
+            terms.push_back({it->first, &it->second, weight, kind, static_cast<uint32_t>(terms.size())});
+        }
+    };
+    for (const std::string_view word : query.plus_words) {
+        const bool is_required = std::binary_search(query.required_words.begin(), query.required_words.end(), word);
+        add_term(plan.scored_terms, word, 1.0, is_required ? QueryStepKind::REQUIRED : QueryStepKind::PLUS);
+    }
+    // Редкие слова первыми: у них наибольший idf, основная часть релевантности
+    // набирается на первых шагах. Слова равной частоты остаются по алфавиту.
+    // Порядок обхода не меняет порядка сложения вкладов - он задан PlannedTerm::term.
+    std::stable_sort(plan.scored_terms.begin(), plan.scored_terms.end(),
+                     [](const PlannedTerm& lhs, const PlannedTerm& rhs) {
+                         return lhs.postings->size() < rhs.postings->size();
+                     });
+    for (const FuzzyWord& fuzzy : query.fuzzy_words) {
+        add_term(plan.scored_terms, fuzzy.word, fuzzy.weight, QueryStepKind::FUZZY);
+    }
+    for (const std::string_view word : query.minus_words) {
+        add_term(plan.minus_terms, word, 1.0, QueryStepKind::MINUS);
+    }
+
+    // По словам: каждый постинг - поиск в накопителе размером до числа кандидатов.
+    // По документам: каждый кандидат - проход по курсорам всех слов.
+    // Пересечение задано запросом, а не выбрано по стоимости: кандидатов не
+    // больше, чем в самом коротком списке обязательного слова.
+    double posting_count = 0.0;
+    double required_count = 0.0;
+    double shortest_required = static_cast<double>(documents_.size());
+    for (const PlannedTerm& term : plan.scored_terms) {
+        posting_count += static_cast<double>(term.postings->size());
+        if (term.kind == QueryStepKind::REQUIRED) {
+            required_count += 1.0;
+            shortest_required = std::min(shortest_required, static_cast<double>(term.postings->size()));
+        }
+    }
+    double candidate_estimate = std::min(posting_count, static_cast<double>(documents_.size()));
+    if (!query.required_words.empty()) {
+        plan.strategy = QueryStrategy::INTERSECTION;
+        // Обязательного слова нет в индексе - документов нет
+        plan.matches_nothing = required_count < static_cast<double>(query.required_words.size());
+        candidate_estimate = shortest_required;
+    } else {
+        const double term_at_a_time_cost = posting_count * std::log2(candidate_estimate + 2.0);
+        const double document_at_a_time_cost = posting_count
+                                               + candidate_estimate * static_cast<double>(plan.scored_terms.size());
+        plan.strategy = document_at_a_time_cost < term_at_a_time_cost ? QueryStrategy::DOCUMENT_AT_A_TIME
+                                                                      : QueryStrategy::TERM_AT_A_TIME;
+    }
+
+    // Минус-слова до обхода стоят их постингов, после - поиска каждого кандидата
+    // в их списках; частые минус-слова при редких plus-словах выгоднее проверять после
+    double minus_posting_count = 0.0;
+    double probe_cost = 0.0;
+    for (const PlannedTerm& term : plan.minus_terms) {
+        minus_posting_count += static_cast<double>(term.postings->size());
+        probe_cost += candidate_estimate * std::log2(static_cast<double>(term.postings->size()) + 2.0);
+    }
+    plan.minus_words_first = minus_posting_count <= probe_cost;
+    return plan;
+}
+
+void SearchServer::StartExplanation(const ExecutionPlan& plan, QueryPlan& explanation) {
+    explanation.strategy = plan.strategy;
+    explanation.minus_words_first = plan.minus_words_first;
+    explanation.steps.clear();
+    for (const PlannedTerm& term : plan.scored_terms) {
+        QueryPlanStep step;
+        step.kind = term.kind;
+        step.word = std::string(term.word);
+        step.document_freq = term.postings->size();
+        explanation.steps.push_back(std::move(step));
+    }
+    for (const PlannedTerm& term : plan.minus_terms) {
+        QueryPlanStep step;
+        step.kind = term.kind;
+        step.word = std::string(term.word);
+        step.document_freq = term.postings->size();
+        // Битовая карта строится по всему списку (или берётся из кэша)
+        step.postings_visited = plan.minus_words_first ? term.postings->size() : 0;
+        explanation.steps.push_back(std::move(step));
+    }
+}
+
+void SearchServer::SetPositionalIndexEnabled(bool enabled) {
+    if (enabled == positions_enabled_) {
+        return;
+    }
+    positions_enabled_ = enabled;
+    if (!enabled) {
+        document_to_word_positions_.clear();
+        return;
+    }
+    for (const auto& [document_id, data] : documents_) {
+        IndexPositions(document_id, SplitIntoWordsNoStop(data.data));
+    }
+}
+
+bool SearchServer::IsPositionalIndexEnabled() const {
+    return positions_enabled_;
+}
+
+void SearchServer::SetPostingStorage(PostingStorage storage) {
+    if (storage == posting_storage_) {
+        return;
+    }
+    posting_storage_ = storage;
+    document_to_word_freqs_.clear();
+    // Слова словаря остаются, меняются только их списки
+    for (auto& [word, postings] : word_to_document_freqs_) {
+        postings = PostingList(storage, memory_->postings);
+    }
+    for (const auto& [document_id, data] : documents_) {
+        IndexTerms(document_id, SplitIntoWordsNoStop(data.data));
+    }
+    // Доли слов изменились, снимки индекса устарели
+    ++index_version_;
+}
+
+PostingStorage SearchServer::GetPostingStorage() const {
+    return posting_storage_;
+}
+
+void SearchServer::SetFuzzyOptions(const FuzzyOptions& options) {
+    if (options.max_edits < 0 || options.max_edits > 2)
+        throw std::invalid_argument("SetFuzzyOptions: max_edits must be in [0, 2]");
+    if (options.max_expansions < 0)
+        throw std::invalid_argument("SetFuzzyOptions: max_expansions < 0");
+    if (!(options.weight > 0.0 && options.weight <= 1.0))
+        throw std::invalid_argument("SetFuzzyOptions: weight must be in (0, 1]");
+    fuzzy_ = options;
+}
+
+const FuzzyOptions& SearchServer::GetFuzzyOptions() const {
+    return fuzzy_;
+}
+
+void SearchServer::IndexTerms(int document_id, const std::vector<std::string_view>& words) {
+    std::vector<std::string_view> sorted_words = words;
+    std::sort(sorted_words.begin(), sorted_words.end());
+    DocumentFrequencies* document_freqs = posting_storage_ == PostingStorage::EXACT && !words.empty()
+            ? &document_to_word_freqs_.try_emplace(document_id, DocumentFrequencies::allocator_type(memory_->reverse_index))
+                      .first->second
+            : nullptr;
+    for (auto first = sorted_words.begin(); first != sorted_words.end();) {
+        const auto last = std::upper_bound(first, sorted_words.end(), *first);
+        // Доля набирается по вхождениям, а в список записывается один раз:
+        // 16-битный уровень накапливать нельзя
+        double term_freq = 0.0;
+        for (auto it = first; it != last; ++it) {
+            term_freq += 1.0 / words.size();
+        }
+        const std::string_view term = InternWord(*first);
+        word_to_document_freqs_.try_emplace(term, posting_storage_, memory_->postings)
+                .first->second.emplace(document_id, term_freq);
+        if (document_freqs) {
+            document_freqs->emplace_hint(document_freqs->end(), term, term_freq);
+        }
+        first = last;
+    }
+}
+
+std::vector<std::string_view> SearchServer::GetDocumentTerms(int document_id) const {
+    std::vector<std::string_view> terms;
+    if (posting_storage_ == PostingStorage::EXACT) {
+        if (const auto it = document_to_word_freqs_.find(document_id); it != document_to_word_freqs_.end()) {
+            terms.reserve(it->second.size());
+            for (const auto& [term, term_freq] : it->second) {
+                terms.push_back(term);
+            }
+        }
+        return terms;
+    }
+    const auto it = documents_.find(document_id);
+    if (it == documents_.end()) {
+        return terms;
+    }
+    terms = SplitIntoWordsNoStop(it->second.data);
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+    for (std::string_view& term : terms) {
+        term = word_to_document_freqs_.find(term)->first;
+    }
+    return terms;
+}
+
+void SearchServer::IndexPositions(int document_id, const std::vector<std::string_view>& words) {
+    PositionMap& positions = document_to_word_positions_
+            .try_emplace(document_id, PositionMap::allocator_type(memory_->positions)).first->second;
+    for (size_t position = 0; position < words.size(); ++position) {
+        positions.try_emplace(InternWord(words[position]), EncodedPositions::Bytes::allocator_type(memory_->positions))
+                .first->second.Append(static_cast<int>(position));
+    }
+}
+
+SearchServer::PreparedDocument SearchServer::PrepareDocument(std::string_view document) const {
+    PreparedDocument prepared{CountedString(document, CountedString::allocator_type(memory_->documents)), {}};
+    if (analyzer_) {
+        AnalyzeText(prepared.text);
+    }
+
+    const std::vector<std::string_view> words = SplitIntoWordsNoStop(prepared.text);
+    prepared.word_spans.reserve(words.size());
+    for (const std::string_view word : words) {
+        if (!IsValidWord(word))
+            throw std::invalid_argument("AddDocument word : contains an invalid character");
+        prepared.word_spans.emplace_back(word.data() - prepared.text.data(), word.size());
+    }
+    return prepared;
+}
+
+void SearchServer::InsertDocument(int document_id,
+                                  DocumentStatus status,
+                                  const std::vector<int>& ratings,
+                                  PreparedDocument prepared) {
+    const int word_count = static_cast<int>(prepared.word_spans.size());
+    DocumentData& document_data = documents_.emplace(
+            document_id,
+            DocumentData{ComputeAverageRating(ratings), status, std::move(prepared.text), word_count}).first->second;
+
+    // Use saved string through string_view
+    std::vector<std::string_view> words;
+    words.reserve(prepared.word_spans.size());
+    for (const auto [offset, size] : prepared.word_spans) {
+        words.emplace_back(document_data.data.data() + offset, size);
+    }
+    status_documents_[static_cast<size_t>(status)].Set(document_id);
+    attributes_.Add(document_id, status, document_data.rating);
+    total_word_count_ += word_count;
+
+    IndexTerms(document_id, words);
+    if (positions_enabled_) {
+        IndexPositions(document_id, words);
+    }
+    docs_id_.insert(document_id);
+    ++index_version_;
+}
+
+void SearchServer::CheckNewDocumentIds(const std::vector<DocumentRecord>& records) const {
+    std::vector<int> ids;
+    ids.reserve(records.size());
+    for (const DocumentRecord& record : records) {
+        if (record.id < 0)
+            throw std::invalid_argument("document id : " + std::to_string(record.id) + " < 0");
+        if (documents_.count(record.id) > 0)
+            throw std::invalid_argument("document id - " + std::to_string(record.id) + " already exists");
+        ids.push_back(record.id);
+    }
+    std::sort(ids.begin(), ids.end());
+    const auto duplicate = std::adjacent_find(ids.begin(), ids.end());
+    if (duplicate != ids.end())
+        throw std::invalid_argument("document id - " + std::to_string(*duplicate) + " repeats in the batch");
+}
+
+template<typename ExecutionPolicy>
+void SearchServer::AddDocumentsImpl(ExecutionPolicy&& policy, const std::vector<DocumentRecord>& records) {
+    CheckNewDocumentIds(records);
+
+    // Исключение внутри параллельного алгоритма вызвало бы std::terminate,
+    // поэтому ошибки разбора собираются и бросаются после него
+    std::vector<std::optional<PreparedDocument>> prepared(records.size());
+    std::vector<std::exception_ptr> errors(records.size());
+    std::vector<size_t> indexes(records.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(policy, indexes.begin(), indexes.end(), [this, &records, &prepared, &errors](size_t i) {
+        try {
+            prepared[i].emplace(PrepareDocument(records[i].text));
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    });
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    for (size_t i = 0; i < records.size(); ++i) {
+        InsertDocument(records[i].id, records[i].status, records[i].ratings, std::move(*prepared[i]));
+    }
+}
+
+bool SearchServer::MatchPhrases(const Query& query, int document_id, double& relevance) const {
+    const auto positions_it = document_to_word_positions_.find(document_id);
+    if (positions_it == document_to_word_positions_.end()) {
+        return false;
+    }
+    const PositionMap& positions = positions_it->second;
+
+    for (const Phrase& phrase : query.phrases) {
+        std::vector<PositionDecoder> decoders;
+        decoders.reserve(phrase.words.size());
+        for (const std::string_view word : phrase.words) {
+            const auto it = positions.find(word);
+            if (it == positions.end()) {
+                return false;
+            }
+            decoders.emplace_back(it->second);
+        }
+
+        const std::optional<int> gap = FindMinimalPhraseGap(decoders);
+        if (!gap || *gap > phrase.slop) {
+            return false;
+        }
+        relevance *= 1.0 + 1.0 / (1 + *gap);
+    }
+    return true;
 }
 
 std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view text) const {
     std::vector<std::string_view> words;
-    for (const std::string_view word : SplitIntoWords(text)) {
+    ForEachWord(text, [this, &words](std::string_view word) {
         if (!IsStopWord(word)) {
             words.push_back(word);
         }
-    }
+    });
     return words;
 }
 
-const std::map<std::string_view , double>& SearchServer::GetWordFrequencies(int document_id) const {
-    static const std::map<std::string_view , double> res;
-    if (document_to_word_freqs_.count(document_id) == 0) {
-        return res;
+int SearchServer::GetDocumentFrequency(const std::string_view word) const {
+    const auto it = word_to_document_freqs_.find(word);
+    return it == word_to_document_freqs_.end() ? 0 : static_cast<int>(it->second.size());
+}
+
+namespace {
+
+// FNV-1a по тексту запроса и статусу
+uint64_t QueryFingerprint(std::string_view raw_query, DocumentStatus status) {
+    uint64_t hash = 14695981039346656037ull;
+    const auto mix = [&hash](unsigned char byte) {
+        hash = (hash ^ byte) * 1099511628211ull;
+    };
+    for (const char c : raw_query) {
+        mix(static_cast<unsigned char>(c));
+    }
+    mix(static_cast<unsigned char>(status));
+    return hash;
+}
+
+// Строгий порядок страниц, как у ResultOrder::EXACT: lhs выдаётся раньше rhs
+bool PrecedesInPage(const Document& lhs, const Document& rhs) {
+    return std::tie(lhs.relevance, lhs.rating, rhs.id) > std::tie(rhs.relevance, rhs.rating, lhs.id);
+}
+
+} // namespace
+
+bool SearchCursor::IsEnd() const {
+    return position_ == Position::END;
+}
+
+// Токен: <позиция>.<отпечаток>.<биты relevance>.<rating>.<id>, числа в hex
+std::string SearchCursor::ToToken() const {
+    uint64_t relevance_bits;
+    std::memcpy(&relevance_bits, &relevance_, sizeof(relevance_bits));
+    std::string token;
+    // Каждое поле пишется в свой буфер, в который заведомо помещается
+    // 64-битное число в hex со знаком
+    const auto append = [&token](auto value) {
+        char digits[24];
+        const auto [end, error] = std::to_chars(digits, digits + sizeof(digits), value, 16);
+        if (error != std::errc())
+            throw std::logic_error("SearchCursor: token field does not fit");
+        if (!token.empty()) {
+            token += '.';
+        }
+        token.append(digits, end);
+    };
+    append(static_cast<int>(position_));
+    append(query_fingerprint_);
+    append(relevance_bits);
+    append(rating_);
+    append(id_);
+    return token;
+}
+
+SearchCursor SearchCursor::FromToken(std::string_view token) {
+    const auto next_field = [&token](auto& value) {
+        const auto [ptr, error] = std::from_chars(token.data(), token.data() + token.size(), value, 16);
+        if (error != std::errc())
+            throw std::invalid_argument("SearchCursor: malformed token");
+        token.remove_prefix(ptr - token.data());
+        if (!token.empty() && token.front() == '.') {
+            token.remove_prefix(1);
+        }
+    };
+    int position = 0;
+    uint64_t relevance_bits = 0;
+    SearchCursor cursor;
+    next_field(position);
+    next_field(cursor.query_fingerprint_);
+    next_field(relevance_bits);
+    next_field(cursor.rating_);
+    next_field(cursor.id_);
+    if (!token.empty() || position < 0 || position > static_cast<int>(Position::END))
+        throw std::invalid_argument("SearchCursor: malformed token");
+    cursor.position_ = static_cast<Position>(position);
+    std::memcpy(&cursor.relevance_, &relevance_bits, sizeof(relevance_bits));
+    return cursor;
+}
+
+SearchPage SearchServer::FindTopDocumentsPage(const std::string_view raw_query, size_t page_size,
+                                              const SearchCursor& after) const {
+    return FindTopDocumentsPage(raw_query, DocumentStatus::ACTUAL, page_size, after);
+}
+
+SearchPage SearchServer::FindTopDocumentsPage(const std::string_view raw_query, DocumentStatus needed_status,
+                                              size_t page_size, const SearchCursor& after) const {
+    using Position = SearchCursor::Position;
+    if (page_size == 0)
+        throw std::invalid_argument("FindTopDocumentsPage: page size must be positive");
+    const uint64_t fingerprint = QueryFingerprint(raw_query, needed_status);
+    if (after.position_ != Position::BEGIN && after.query_fingerprint_ != fingerprint)
+        throw std::invalid_argument("FindTopDocumentsPage: cursor belongs to another query");
+
+    SearchPage page;
+    page.next = after;
+    if (after.position_ == Position::END) {
+        return page;
+    }
+
+    const Query query = ParseQuery(raw_query);
+    std::vector<Document> matched_documents = FindAllDocuments(TfIdfScorer(), query, DocumentStatusFilter{needed_status});
+
+    TRACE_QUERY_STAGE(QueryStage::TOP_K);
+    if (after.position_ == Position::AFTER) {
+        const Document last(after.id_, after.relevance_, after.rating_);
+        matched_documents.erase(std::remove_if(matched_documents.begin(), matched_documents.end(),
+                                               [&last](const Document& document) {
+                                                   return !PrecedesInPage(last, document);
+                                               }),
+                                matched_documents.end());
+    }
+
+    const bool has_next_page = matched_documents.size() > page_size;
+    SelectTopResults(matched_documents, page_size, ResultOrder::EXACT);
+    page.documents = std::move(matched_documents);
+
+    page.next.query_fingerprint_ = fingerprint;
+    if (!has_next_page) {
+        page.next.position_ = Position::END;
+        return page;
+    }
+    const Document& last = page.documents.back();
+    page.next.position_ = Position::AFTER;
+    page.next.relevance_ = last.relevance;
+    page.next.rating_ = last.rating;
+    page.next.id_ = last.id;
+    return page;
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string>& raw_queries) const {
+    return FindTopDocumentsBatch(std::execution::seq, raw_queries);
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::execution::sequenced_policy&,
+                                                                       const std::vector<std::string>& raw_queries) const {
+    return ExecuteBatch(std::execution::seq, raw_queries, 1, nullptr);
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::execution::parallel_policy&,
+                                                                       const std::vector<std::string>& raw_queries) const {
+    return ExecuteBatch(std::execution::par, raw_queries, BATCH_SHARD_COUNT, nullptr);
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::execution::sequenced_policy&,
+                                                                       const std::vector<std::string>& raw_queries,
+                                                                       std::vector<std::exception_ptr>& errors) const {
+    return ExecuteBatch(std::execution::seq, raw_queries, 1, &errors);
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::execution::parallel_policy&,
+                                                                       const std::vector<std::string>& raw_queries,
+                                                                       std::vector<std::exception_ptr>& errors) const {
+    return ExecuteBatch(std::execution::par, raw_queries, BATCH_SHARD_COUNT, &errors);
+}
+
+void SearchServer::SelectTopDocuments(std::vector<Document>& matched_documents) {
+    SelectTopResults(matched_documents, MAX_RESULT_DOCUMENT_COUNT);
+}
+
+template<typename ExecutionPolicy>
+std::vector<std::vector<Document>> SearchServer::ExecuteBatch(ExecutionPolicy&& policy,
+                                                              const std::vector<std::string>& raw_queries,
+                                                              int shard_count,
+                                                              std::vector<std::exception_ptr>* errors) const {
+    if (errors) {
+        errors->assign(raw_queries.size(), nullptr);
+    }
+    std::vector<Query> queries;
+    queries.reserve(raw_queries.size());
+    for (size_t query_index = 0; query_index < raw_queries.size(); ++query_index) {
+        try {
+            queries.push_back(ParseQuery(raw_queries[query_index]));
+        } catch (...) {
+            if (!errors) {
+                throw;
+            }
+            // Пустой запрос не читает постингов и ничего не находит
+            (*errors)[query_index] = std::current_exception();
+            queries.emplace_back();
+        }
+    }
+    std::vector<std::vector<Document>> results(queries.size());
+    if (documents_.empty()) {
+        return results;
+    }
+
+    std::vector<BatchTerm> plus_terms = GroupBatchTerms(queries, &Query::plus_words);
+    // Обход как в плане запроса: по возрастанию частоты, при равной частоте по алфавиту
+    std::stable_sort(plus_terms.begin(), plus_terms.end(), [this](const BatchTerm& lhs, const BatchTerm& rhs) {
+        return GetDocumentFrequency(lhs.word) < GetDocumentFrequency(rhs.word);
+    });
+    const std::vector<BatchTerm> minus_terms = GroupBatchTerms(queries, &Query::minus_words);
+
+    // Диапазоны id равной ширины между первым и последним документом
+    const long long first_id = documents_.begin()->first;
+    const long long id_span = documents_.rbegin()->first - first_id + 1;
+    shard_count = static_cast<int>(std::min<long long>(shard_count, id_span));
+    std::vector<BatchRelevance> shards(shard_count, BatchRelevance(queries.size()));
+    {
+        TRACE_QUERY_STAGE(QueryStage::POSTINGS);
+        std::vector<int> shard_indexes(shard_count);
+        std::iota(shard_indexes.begin(), shard_indexes.end(), 0);
+        std::for_each(policy,
+                      shard_indexes.begin(),
+                      shard_indexes.end(),
+                      [&](int shard) {
+                          AccumulateBatch(queries, plus_terms, minus_terms,
+                                          static_cast<int>(first_id + id_span * shard / shard_count),
+                                          static_cast<int>(first_id + id_span * (shard + 1) / shard_count),
+                                          shards[shard]);
+                      });
+    }
+
+    TRACE_QUERY_STAGE(QueryStage::MERGE);
+    for (size_t query_index = 0; query_index < queries.size(); ++query_index) {
+        const Query& query = queries[query_index];
+        std::vector<Document>& matched_documents = results[query_index];
+        // Диапазоны идут по возрастанию id, как обход одного std::map в FindAllDocuments
+        for (BatchRelevance& shard : shards) {
+            CollectBatchDocuments(query, shard[query_index], matched_documents);
+        }
+        SelectTopDocuments(matched_documents);
+    }
+    return results;
+}
+
+std::vector<SearchServer::BatchTerm> SearchServer::GroupBatchTerms(const std::vector<Query>& queries,
+                                                                   std::vector<std::string_view> Query::*words) {
+    std::vector<std::pair<std::string_view, size_t>> occurrences;
+    for (size_t query_index = 0; query_index < queries.size(); ++query_index) {
+        for (const std::string_view word : queries[query_index].*words) {
+            occurrences.emplace_back(word, query_index);
+        }
+    }
+    std::sort(occurrences.begin(), occurrences.end());
+
+    std::vector<BatchTerm> terms;
+    for (const auto& [word, query_index] : occurrences) {
+        if (terms.empty() || terms.back().word != word) {
+            terms.push_back({word, {}, static_cast<uint32_t>(terms.size())});
+        }
+        terms.back().query_indexes.push_back(query_index);
+    }
+    return terms;
+}
+
+void SearchServer::AccumulateBatch(const std::vector<Query>& queries,
+                                   const std::vector<BatchTerm>& plus_terms,
+                                   const std::vector<BatchTerm>& minus_terms,
+                                   int first_id,
+                                   int last_id,
+                                   BatchRelevance& relevance) const {
+    // Пакет выполняет FindTopDocuments(query) - статус ACTUAL и TF-IDF
+    const DocumentStatusFilter filter{DocumentStatus::ACTUAL};
+    const TfIdfScorer scorer;
+    const CollectionStats stats = GetCollectionStats();
+
+    const auto for_each_posting = [first_id, last_id](const PostingList& postings, auto action) {
+        const auto end = postings.end();
+        for (auto it = postings.lower_bound(first_id); it != end && it->first < last_id; ++it) {
+            action(it->first, it->second);
+        }
+    };
+
+    for (const BatchTerm& term : plus_terms) {
+        const auto it = word_to_document_freqs_.find(term.word);
+        if (it == word_to_document_freqs_.end()) {
+            continue;
+        }
+        const auto term_scorer = scorer.ForTerm(stats, it->second.size());
+        for_each_posting(it->second, [&](int document_id, double term_freq) {
+            if (PassesStatusFilter(filter, document_id)) {
+                const double score = term_scorer(term_freq, 0);
+                for (const size_t query_index : term.query_indexes) {
+                    relevance[query_index].contributions.push_back({document_id, term.term, score});
+                }
+            }
+        });
+    }
+
+    // Исправления опечаток редки и складываются после всех plus-слов своего запроса
+    for (size_t query_index = 0; query_index < queries.size(); ++query_index) {
+        const std::vector<FuzzyWord>& fuzzy_words = queries[query_index].fuzzy_words;
+        for (size_t fuzzy_index = 0; fuzzy_index < fuzzy_words.size(); ++fuzzy_index) {
+            const FuzzyWord& fuzzy = fuzzy_words[fuzzy_index];
+            const auto term = static_cast<uint32_t>(plus_terms.size() + fuzzy_index);
+            const PostingList& postings = word_to_document_freqs_.at(fuzzy.word);
+            const auto term_scorer = scorer.ForTerm(stats, postings.size());
+            for_each_posting(postings, [&](int document_id, double term_freq) {
+                if (PassesStatusFilter(filter, document_id)) {
+                    relevance[query_index].contributions.push_back(
+                            {document_id, term, fuzzy.weight * term_scorer(term_freq, 0)});
+                }
+            });
+        }
+    }
+
+    for (const BatchTerm& term : minus_terms) {
+        const auto it = word_to_document_freqs_.find(term.word);
+        if (it == word_to_document_freqs_.end()) {
+            continue;
+        }
+        for_each_posting(it->second, [&](int document_id, double) {
+            for (const size_t query_index : term.query_indexes) {
+                relevance[query_index].excluded_documents.push_back(document_id);
+            }
+        });
+    }
+}
+
+std::vector<std::pair<int, double>> SearchServer::SumContributions(std::vector<TermContribution>& contributions) {
+    std::sort(contributions.begin(), contributions.end(),
+              [](const TermContribution& lhs, const TermContribution& rhs) {
+                  return std::tie(lhs.document_id, lhs.term) < std::tie(rhs.document_id, rhs.term);
+              });
+    std::vector<std::pair<int, double>> document_relevances;
+    for (auto it = contributions.begin(); it != contributions.end();) {
+        const int document_id = it->document_id;
+        double relevance = 0.0;
+        for (; it != contributions.end() && it->document_id == document_id; ++it) {
+            relevance += it->score;
+        }
+        document_relevances.emplace_back(document_id, relevance);
+    }
+    return document_relevances;
+}
+
+void SearchServer::CollectBatchDocuments(const Query& query, BatchAccumulator& accumulator,
+                                         std::vector<Document>& matched_documents) const {
+    std::vector<int>& excluded = accumulator.excluded_documents;
+    std::sort(excluded.begin(), excluded.end());
+
+    auto excluded_it = excluded.begin();
+    for (auto [document_id, relevance] : SumContributions(accumulator.contributions)) {
+        excluded_it = std::lower_bound(excluded_it, excluded.end(), document_id);
+        if (excluded_it != excluded.end() && *excluded_it == document_id) {
+            continue;
+        }
+        if (!ContainsRequiredWords(query, document_id)) {
+            continue;
+        }
+        if (query.phrases.empty() || MatchPhrases(query, document_id, relevance)) {
+            matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+        }
+    }
+}
+
+bool SearchServer::ContainsRequiredWords(const Query& query, int document_id) const {
+    for (const std::string_view word : query.required_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end() || it->second.count(document_id) == 0) {
+            return false;
+        }
     }
-    else {
-        return document_to_word_freqs_.at(document_id);
+    return true;
+}
+
+void SearchServer::AnalyzeText(CountedString& text) const {
+    // Слово сдвигается только влево и не удлиняется, поэтому запись не обгоняет чтение
+    size_t write = 0;
+    size_t read = text.find_first_not_of(' ');
+    while (read < text.size()) {
+        const size_t end = std::min(text.find(' ', read), text.size());
+        const size_t destination = write > 0 ? write + 1 : 0;
+        std::copy(text.begin() + read, text.begin() + end, text.begin() + destination);
+
+        const size_t size = analyzer_(text.data() + destination, end - read);
+        if (size > 0) {
+            if (write > 0) {
+                text[write] = ' ';
+            }
+            write = destination + size;
+        }
+        read = text.find_first_not_of(' ', end);
     }
+    text.resize(write);
+}
+
+std::string_view SearchServer::AnalyzeQueryWord(std::string_view word, Query& query) const {
+    if (!analyzer_) {
+        return word;
+    }
+    std::string& buffer = *query.normalized_words;
+    const size_t offset = buffer.size();
+    buffer.append(word);
+    buffer.resize(offset + analyzer_(buffer.data() + offset, word.size()));
+    return std::string_view(buffer).substr(offset);
+}
+
+SearchServer::WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+    WordFrequencies word_freqs;
+    if (posting_storage_ == PostingStorage::EXACT) {
+        if (const auto it = document_to_word_freqs_.find(document_id); it != document_to_word_freqs_.end()) {
+            word_freqs.insert(it->second.begin(), it->second.end());
+        }
+        return word_freqs;
+    }
+    for (const std::string_view term : GetDocumentTerms(document_id)) {
+        word_freqs.emplace_hint(word_freqs.end(), term, word_to_document_freqs_.at(term).find(document_id)->second);
+    }
+    return word_freqs;
 }
 
 
@@ -205,7 +1215,7 @@ bool SearchServer::IsValidWord(const std::string_view word) {
     });
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
+SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text, Query& query) const {
     if (text.size() == 1 && text[0] == '-') {
         throw std::invalid_argument("ParseQueryWord word: contains an invalid character");
     }
@@ -218,24 +1228,90 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
         is_minus = true;
         text = text.substr(1);
     }
-    return {text, is_minus, IsStopWord(text)};
+    bool is_required = false;
+    if (text[0] == '+') {
+        if (is_minus || text.size() == 1 || text[1] == '+' || text[1] == '-') {
+            throw std::invalid_argument("ParseQueryWord word: contains an invalid character");
+        }
+        is_required = true;
+        text = text.substr(1);
+    }
+    if (text == "*") {
+        throw std::invalid_argument("ParseQueryWord word: empty prefix");
+    }
+    const bool is_prefix = text.back() == '*';
+    if (is_prefix) {
+        if (is_required) {
+            throw std::invalid_argument("ParseQueryWord word: required prefixes are not supported");
+        }
+        text.remove_suffix(1);
+    }
+    text = AnalyzeQueryWord(text, query);
+    return {text, is_minus, is_required, is_prefix, IsStopWord(text)};
 }
 
 SearchServer::Query SearchServer::ParseQuery(const std::string_view text) const {
+    TRACE_QUERY_STAGE(QueryStage::PARSE);
     Query query;
-    for (const std::string_view word : SplitIntoWords(text)) {
+    if (analyzer_) {
+        // Нормализованные слова не длиннее исходных, перевыделений не будет
+        query.normalized_words = std::make_unique<std::string>();
+        query.normalized_words->reserve(text.size());
+    }
+    std::optional<Phrase> phrase;
+    for (std::string_view word : SplitIntoWords(text)) {
         if (!IsValidWord(word))
             throw std::invalid_argument("ParseQuery word: contains an invalid character");
 
-        const QueryWord query_word = ParseQueryWord(word);
+        if (!phrase && word.size() > 1 && word[0] == '-' && word[1] == '"')
+            throw std::invalid_argument("ParseQuery phrase: minus phrases are not supported");
+        if (!phrase && word[0] == '"') {
+            phrase.emplace();
+            word.remove_prefix(1);
+        }
+
+        if (phrase) {
+            const bool is_last = ParsePhraseEnd(word, *phrase);
+            if (!word.empty() && (word[0] == '-' || word[0] == '+' || word.back() == '*'))
+                throw std::invalid_argument("ParseQuery phrase: operators are not supported inside phrases");
+            word = AnalyzeQueryWord(word, query);
+            if (!word.empty() && !IsStopWord(word)) {
+                phrase->words.push_back(word);
+                query.plus_words.push_back(word);
+            }
+            if (is_last) {
+                if (phrase->words.size() > 1) {
+                    query.phrases.push_back(std::move(*phrase));
+                }
+                phrase.reset();
+            }
+            continue;
+        }
+
+        const QueryWord query_word = ParseQueryWord(word, query);
+        if (query_word.data.empty()) {
+            continue;
+        }
+        if (query_word.is_prefix) {
+            ExpandPrefix(query_word.data, query_word.is_minus ? query.minus_words : query.plus_words);
+            continue;
+        }
         if (!query_word.is_stop) {
             if (query_word.is_minus) {
                 query.minus_words.push_back(query_word.data);
             } else {
                 query.plus_words.push_back(query_word.data);
+                if (query_word.is_required) {
+                    query.required_words.push_back(query_word.data);
+                }
             }
         }
     }
+    if (phrase)
+        throw std::invalid_argument("ParseQuery phrase: missing closing quote");
+    if (!query.phrases.empty() && !positions_enabled_)
+        throw std::logic_error("ParseQuery phrase: positional index is disabled");
+
     std::sort(query.minus_words.begin(), query.minus_words.end());
     auto last_it = std::unique(query.minus_words.begin(), query.minus_words.end());
     query.minus_words.resize(std::distance(query.minus_words.begin(), last_it));
@@ -243,9 +1319,125 @@ SearchServer::Query SearchServer::ParseQuery(const std::string_view text) const
     std::sort(query.plus_words.begin(), query.plus_words.end());
     auto itp = std::unique(query.plus_words.begin(), query.plus_words.end());
     query.plus_words.resize(std::distance(query.plus_words.begin(), itp));
+
+    std::sort(query.required_words.begin(), query.required_words.end());
+    auto itr = std::unique(query.required_words.begin(), query.required_words.end());
+    query.required_words.resize(std::distance(query.required_words.begin(), itr));
+
+    if (fuzzy_.max_edits > 0) {
+        AddFuzzyWords(query);
+    }
     return query;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
-    return std::log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+void SearchServer::AddFuzzyWords(Query& query) const {
+    std::vector<FuzzyCandidate> candidates;
+    for (const std::string_view word : query.plus_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end() && !it->second.empty()) {
+            continue;
+        }
+        const int max_edits = std::min(fuzzy_.max_edits, static_cast<int>(word.size()) / 3);
+        if (max_edits > 0) {
+            CollectFuzzyTerms(word, max_edits, candidates);
+        }
+    }
+
+    // Сначала ближайшие, среди них - более частые
+    std::sort(candidates.begin(), candidates.end(),
+              [](const FuzzyCandidate& lhs, const FuzzyCandidate& rhs) {
+                  return std::tie(lhs.distance, rhs.document_freq, lhs.word)
+                         < std::tie(rhs.distance, lhs.document_freq, rhs.word);
+              });
+    for (const FuzzyCandidate& candidate : candidates) {
+        if (static_cast<int>(query.fuzzy_words.size()) == fuzzy_.max_expansions) {
+            break;
+        }
+        const bool is_plus_word = std::binary_search(query.plus_words.begin(), query.plus_words.end(), candidate.word);
+        const bool is_added = std::any_of(query.fuzzy_words.begin(), query.fuzzy_words.end(),
+                                          [&candidate](const FuzzyWord& fuzzy) { return fuzzy.word == candidate.word; });
+        if (!is_plus_word && !is_added) {
+            query.fuzzy_words.push_back({candidate.word, std::pow(fuzzy_.weight, candidate.distance)});
+        }
+    }
+}
+
+void SearchServer::CollectFuzzyTerms(std::string_view word, int max_edits, std::vector<FuzzyCandidate>& candidates) const {
+    const LevenshteinAutomaton automaton(word, max_edits);
+    const size_t state_size = automaton.GetStateSize();
+    // states[depth * state_size ...] - состояние после первых depth символов текущего слова
+    std::vector<int> states(state_size);
+    automaton.Start(states.data());
+
+    std::string_view previous;
+    auto it = word_to_document_freqs_.begin();
+    while (it != word_to_document_freqs_.end()) {
+        const std::string_view term = it->first;
+        const size_t common = std::mismatch(previous.begin(), previous.end(), term.begin(), term.end()).first - previous.begin();
+        size_t depth = std::min(common, states.size() / state_size - 1);
+        states.resize((depth + 1) * state_size);
+
+        bool can_match = true;
+        for (; depth < term.size(); ++depth) {
+            states.resize(states.size() + state_size);
+            int* next = states.data() + (depth + 1) * state_size;
+            automaton.Step(next - state_size, term[depth], next);
+            if (!automaton.CanMatch(next)) {
+                states.resize(states.size() - state_size);
+                can_match = false;
+                break;
+            }
+        }
+        previous = term;
+
+        if (!can_match) {
+            // Ни одно слово с этим префиксом не подойдёт
+            const std::string next_prefix = NextPrefix(term.substr(0, depth + 1));
+            it = next_prefix.empty() ? word_to_document_freqs_.end() : word_to_document_freqs_.lower_bound(next_prefix);
+            continue;
+        }
+        const int* state = states.data() + term.size() * state_size;
+        if (automaton.IsMatch(state) && !it->second.empty()) {
+            candidates.push_back({term, automaton.GetDistance(state), it->second.size()});
+        }
+        ++it;
+    }
+}
+
+void SearchServer::ExpandPrefix(std::string_view prefix, std::vector<std::string_view>& words) const {
+    int expansions = 0;
+    for (auto it = word_to_document_freqs_.lower_bound(prefix);
+         it != word_to_document_freqs_.end() && expansions < MAX_PREFIX_EXPANSIONS;
+         ++it) {
+        if (it->first.substr(0, prefix.size()) != prefix) {
+            break;
+        }
+        // Слова удалённых документов остаются в словаре с пустым списком
+        if (!it->second.empty()) {
+            words.push_back(it->first);
+            ++expansions;
+        }
+    }
+}
+
+bool SearchServer::ParsePhraseEnd(std::string_view& word, Phrase& phrase) {
+    const auto quote = word.find('"');
+    if (quote == std::string_view::npos) {
+        return false;
+    }
+
+    const std::string_view tail = word.substr(quote + 1);
+    word = word.substr(0, quote);
+    if (!tail.empty()) {
+        const char* const end = tail.data() + tail.size();
+        const auto [ptr, error] = std::from_chars(tail.data() + 1, end, phrase.slop);
+        if (tail[0] != '~' || error != std::errc() || ptr != end || phrase.slop < 0)
+            throw std::invalid_argument("ParseQuery phrase: expected ~<distance> after closing quote");
+    }
+    return true;
+}
+
+CollectionStats SearchServer::GetCollectionStats() const {
+    const int document_count = GetDocumentCount();
+    return {document_count, document_count > 0 ? static_cast<double>(total_word_count_) / document_count : 0.0};
 }
@@ -4,29 +4,139 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include <set>
+#include <array>
 #include <algorithm>
 #include <stdexcept>
 #include <cmath>
+#include <cstdint>
+#include <exception>
 #include <execution>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <utility>
 
+#include "attribute_index.h"
+#include "compact_index.h"
 #include "document.h"
 #include "concurrent_map.h"
+#include "document_bitset.h"
+#include "impact_index.h"
+#include "index_source.h"
+#include "levenshtein_automaton.h"
+#include "positional_index.h"
+#include "posting_list.h"
+#include "query_plan.h"
+#include "memory_stats.h"
+#include "query_trace.h"
+#include "ranking.h"
+#include "result_order.h"
+#include "roaring_bitmap.h"
+#include "search_budget.h"
+#include "stop_word_set.h"
 #include "string_processing.h"
+#include "term_arena.h"
+#include "text_analyzer.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const double ACCURACY = 1e-6;
+// Сколько слов словаря подставляется вместо одного префикса "term*"
+const int MAX_PREFIX_EXPANSIONS = 64;
+// На сколько диапазонов id делится пакет запросов при параллельном выполнении
+const int BATCH_SHARD_COUNT = 16;
+// Сколько соседних постингов пересечение просматривает подряд, прежде чем
+// искать документ в списке от корня дерева
+const int INTERSECTION_LINEAR_STEPS = 4;
+// Битовая карта минус-слова кэшируется со второго запроса с этим словом;
+// при переполнении кэш очищается целиком
+const int MINUS_CACHE_MIN_REQUESTS = 2;
+const size_t MINUS_CACHE_CAPACITY = 256;
+
+// Исправление опечаток: слово запроса без документов заменяется близкими словами
+// словаря, их вклад в релевантность умножается на weight за каждую правку
+struct FuzzyOptions {
+    // 0 - выключено; слова короче трёх символов не исправляются, короче шести - одной правкой
+    int max_edits = 0;
+    // Сколько слов словаря подставляется на весь запрос
+    int max_expansions = 8;
+    double weight = 0.5;
+};
+
+// Позиция в выдаче для постраничного поиска: последний отданный документ
+// и отпечаток запроса. Снаружи непрозрачна, передаётся клиенту токеном.
+class SearchCursor {
+public:
+    // Курсор начала выдачи
+    SearchCursor() = default;
+
+    // Выдача исчерпана, следующая страница будет пустой
+    bool IsEnd() const;
+
+    std::string ToToken() const;
+
+    // Бросает std::invalid_argument на испорченном токене
+    static SearchCursor FromToken(std::string_view token);
+
+private:
+    friend class SearchServer;
+
+    enum class Position : uint8_t {
+        BEGIN,
+        AFTER,
+        END,
+    };
+
+    Position position_ = Position::BEGIN;
+    uint64_t query_fingerprint_ = 0;
+    double relevance_ = 0.0;
+    int rating_ = 0;
+    int id_ = 0;
+};
+
+struct SearchPage {
+    std::vector<Document> documents;
+    // Передаётся в следующий вызов FindTopDocumentsPage
+    SearchCursor next;
+};
+
+template <typename T>
+using EnableIfExecutionPolicy = std::enable_if_t<std::is_execution_policy_v<std::decay_t<T>>, bool>;
+
+template <typename T>
+using EnableIfScorer = std::enable_if_t<IS_SCORER_V<T>, bool>;
 
 class SearchServer {
 public:
+    using WordFrequencies = std::map<std::string_view, double>;
+    using DocumentIds = std::set<int, std::less<int>, CountingAllocator<int>>;
+
+    // analyzer нормализует слова документов, запросов и стоп-слов,
+    // например DefaultTextAnalyzer::Analyze (см. text_analyzer.h)
     template<typename StringContainer>
-    explicit SearchServer(const StringContainer &stop_words);
+    explicit SearchServer(const StringContainer &stop_words, AnalyzerFunction analyzer = nullptr);
+
+    explicit SearchServer(const std::string &stop_words_text, AnalyzerFunction analyzer = nullptr);
+
+    explicit SearchServer(const std::string_view stop_words_text, AnalyzerFunction analyzer = nullptr);
 
-    explicit SearchServer(const std::string &stop_words_text);
+    SearchServer(SearchServer &&other) = default;
 
-    explicit SearchServer(const std::string_view stop_words_text);
+    // Прежнее состояние уничтожается целиком вместе со своими счётчиками памяти
+    SearchServer &operator=(SearchServer &&other) noexcept;
 
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int> &ratings);
 
+    // Результат тот же, что у AddDocument для каждой записи по порядку, но
+    // нормализация и разбиение текстов на слова выполняются до вставки в индекс,
+    // в параллельной версии - параллельно. Все записи проверяются заранее:
+    // при ошибке индекс не меняется.
+    void AddDocuments(const std::vector<DocumentRecord> &records);
+
+    void AddDocuments(const std::execution::sequenced_policy &, const std::vector<DocumentRecord> &records);
+
+    void AddDocuments(const std::execution::parallel_policy &, const std::vector<DocumentRecord> &records);
+
     void RemoveDocument(int document_id);
 
     void RemoveDocument(const std::execution::sequenced_policy &, int document_id);
@@ -36,29 +146,130 @@ public:
     template<typename Handler>
     std::vector<Document> FindTopDocuments(const std::string_view raw_query, Handler lambda) const;
 
-    template<typename Handler, typename ExecutionPolicy>
+    template<typename Handler, typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy> = true>
     std::vector<Document> FindTopDocuments(
             ExecutionPolicy &&policy,
             std::string_view raw_query,
             Handler lambda) const;
 
-    template<typename ExecutionPolicy>
+    template<typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy> = true>
     std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy, const std::string_view raw_query) const;
 
     std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
 
-    template<typename ExecutionPolicy>
+    template<typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy> = true>
     std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy, const std::string_view raw_query, DocumentStatus needed_status) const;
 
     std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus needed_status) const;
 
+    // Обход постингов останавливается, когда исчерпан budget, и возвращает лучшие
+    // документы среди прочитанных с truncated = true. Слова обходятся от редких
+    // к частым, поэтому при усечении первыми учтены самые весомые слова.
+    SearchResult FindTopDocuments(const std::string_view raw_query, const SearchBudget &budget,
+                                  DocumentStatus needed_status = DocumentStatus::ACTUAL) const;
+
+    // Выполняет запрос как FindTopDocuments(raw_query, status) и возвращает выбранный
+    // план со счётчиками каждого шага - для диагностики медленных запросов
+    QueryPlan Explain(const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+    // Документы запроса, прошедшие filter, по убыванию рейтинга, при равном
+    // рейтинге - по убыванию релевантности, затем по возрастанию id
+    std::vector<Document> FindTopDocumentsByRating(const std::string_view raw_query,
+                                                   const AttributeFilter &filter = {}) const;
+
+    // Индекс с постингами по убыванию вклада TF-IDF для документов со статусом
+    // status. Строится по текущему индексу и устаревает при его изменении;
+    // индекс, построенный другим сервером, этот сервер не принимает.
+    ImpactIndex BuildImpactIndex(DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+    // Приближённый поиск по index: сегменты с большим вкладом обрабатываются первыми,
+    // обход заканчивается, когда выдача уже не может измениться, или по budget.
+    // Фразы и обязательные слова не поддерживаются, исправления опечаток не применяются.
+    SearchResult FindTopDocumentsByImpact(const ImpactIndex &index, const std::string_view raw_query,
+                                          const SearchBudget &budget = {}) const;
+
+    // Снимок индекса для документов со статусом status с 16-битной частотой слова,
+    // см. CompactIndex. Память сервера он не освобождает, а добавляется к ней -
+    // её сокращает SetPostingStorage(PostingStorage::COMPACT). После изменения
+    // индекса сервера снимок нужно построить заново, снимок другого сервера этот
+    // сервер не принимает.
+    CompactIndex BuildCompactIndex(DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+    // Как FindTopDocuments(raw_query, status) для статуса index, но релевантность
+    // считается во float по квантованной частоте; отличие от точной ограничено
+    // CompactIndex::GetRelevanceErrorBound. Фразы и обязательные слова не поддерживаются.
+    std::vector<Document> FindTopDocumentsCompact(const CompactIndex &index, const std::string_view raw_query,
+                                                  CompactIndex::Kernel kernel = CompactIndex::GetBestKernel()) const;
+
+    // Те же варианты с явной ранжирующей функцией (TfIdfScorer, Bm25Scorer, см. ranking.h)
+    template<typename Scorer, typename Handler, EnableIfScorer<Scorer> = true>
+    std::vector<Document> FindTopDocuments(const Scorer &scorer, const std::string_view raw_query, Handler lambda) const;
+
+    template<typename Scorer, EnableIfScorer<Scorer> = true>
+    std::vector<Document> FindTopDocuments(const Scorer &scorer, const std::string_view raw_query) const;
+
+    template<typename Scorer, EnableIfScorer<Scorer> = true>
+    std::vector<Document> FindTopDocuments(const Scorer &scorer, const std::string_view raw_query, DocumentStatus needed_status) const;
+
+    template<typename ExecutionPolicy, typename Scorer, typename Handler,
+             EnableIfExecutionPolicy<ExecutionPolicy> = true, EnableIfScorer<Scorer> = true>
+    std::vector<Document> FindTopDocuments(
+            ExecutionPolicy &&policy,
+            const Scorer &scorer,
+            std::string_view raw_query,
+            Handler lambda) const;
+
+    template<typename ExecutionPolicy, typename Scorer,
+             EnableIfExecutionPolicy<ExecutionPolicy> = true, EnableIfScorer<Scorer> = true>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy, const Scorer &scorer, const std::string_view raw_query) const;
+
+    template<typename ExecutionPolicy, typename Scorer,
+             EnableIfExecutionPolicy<ExecutionPolicy> = true, EnableIfScorer<Scorer> = true>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &&policy,
+                                           const Scorer &scorer,
+                                           const std::string_view raw_query,
+                                           DocumentStatus needed_status) const;
+
     int GetDocumentCount() const;
 
-    const std::set<int>::const_iterator begin() const;
+    DocumentIds::const_iterator begin() const;
+
+    DocumentIds::const_iterator end() const;
 
-    const std::set<int>::const_iterator end() const;
+    // Копия, а не ссылка: в PostingStorage::COMPACT доли слов хранятся только
+    // в постингах и собираются из них
+    WordFrequencies GetWordFrequencies(int document_id) const;
 
-    const std::map<std::string_view, double> &GetWordFrequencies(int document_id) const;
+    // Число документов со словом; слово берётся как есть, без анализатора
+    int GetDocumentFrequency(const std::string_view word) const;
+
+    // Обходит словарь (O(число слов)), остальное берёт из счётчиков аллокаторов
+    IndexMemoryStats GetMemoryStats() const;
+
+    // Позиционный индекс нужен для запросов с фразами: "big cat" - точная фраза,
+    // "big cat"~2 - слова по порядку с не более чем двумя словами между ними.
+    // Минус-слова, обязательные слова и префиксы внутри фразы - std::invalid_argument.
+    // При включении строится по уже добавленным документам.
+    void SetPositionalIndexEnabled(bool enabled);
+
+    bool IsPositionalIndexEnabled() const;
+
+    // В PostingStorage::COMPACT доля слова в документе хранится 16-битным уровнем
+    // (см. PostingList), а прямого индекса нет: слова документа при удалении и
+    // MatchDocument берутся из его текста. Постинг занимает 6 байт вместо 48, и
+    // индекс целиком становится в несколько раз меньше; поиск идёт теми же путями.
+    // Релевантность TF-IDF отличается от точной не больше чем на
+    // sum(idf слов запроса) / PostingList::TF_LEVELS; число вхождений слова, по
+    // которому считает Bm25Scorer, восстанавливается точно для документов короче
+    // TF_LEVELS слов. Удаление документа стоит O(df) на каждое его слово.
+    // При смене постинги перестраиваются по текстам уже добавленных документов.
+    void SetPostingStorage(PostingStorage storage);
+
+    PostingStorage GetPostingStorage() const;
+
+    void SetFuzzyOptions(const FuzzyOptions &options);
+
+    const FuzzyOptions &GetFuzzyOptions() const;
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query, int document_id) const;
 
@@ -70,189 +281,1009 @@ public:
                                                                             const std::string_view raw_query,
                                                                             int document_id) const;
 
+    using MatchResult = std::tuple<std::vector<std::string_view>, DocumentStatus>;
+
+    // Разбирает запрос один раз и сопоставляет его со всеми документами из списка
+    std::vector<MatchResult> MatchDocuments(const std::string_view raw_query, const std::vector<int> &document_ids) const;
+
+    // Результат совпадает с FindTopDocuments(query) для каждого запроса, но каждый
+    // список постингов, нужный пакету, читается один раз: вклад документа
+    // раскладывается по всем запросам с этим словом. Параллельная версия делит
+    // id документов на диапазоны, у каждого диапазона свои накопители.
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string> &raw_queries) const;
+
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::execution::sequenced_policy &,
+                                                             const std::vector<std::string> &raw_queries) const;
+
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::execution::parallel_policy &,
+                                                             const std::vector<std::string> &raw_queries) const;
+
+    // Ошибка разбора запроса сохраняется в errors[i], его выдача остаётся пустой,
+    // а остальные запросы пакета по-прежнему читают постинги вместе
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::execution::sequenced_policy &,
+                                                             const std::vector<std::string> &raw_queries,
+                                                             std::vector<std::exception_ptr> &errors) const;
+
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::execution::parallel_policy &,
+                                                             const std::vector<std::string> &raw_queries,
+                                                             std::vector<std::exception_ptr> &errors) const;
+
+    // Постраничная выдача без ограничения MAX_RESULT_DOCUMENT_COUNT. Документы идут
+    // в порядке ResultOrder::EXACT: точная релевантность, рейтинг, id, - поэтому при
+    // равной с точностью ACCURACY релевантности он может отличаться от
+    // FindTopDocuments. Курсор хранит только позицию, а не найденные документы,
+    // поэтому каждая страница заново выполняет весь поиск (FindAllDocuments по всем
+    // постингам запроса) и экономит лишь на упорядочивании: выбирает и сортирует
+    // только page_size документов, следующих за курсором. Курсор другого запроса
+    // или статуса - std::invalid_argument.
+    SearchPage FindTopDocumentsPage(const std::string_view raw_query, size_t page_size,
+                                    const SearchCursor &after = {}) const;
+
+    SearchPage FindTopDocumentsPage(const std::string_view raw_query, DocumentStatus needed_status, size_t page_size,
+                                    const SearchCursor &after = {}) const;
+
+    template<typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy> = true>
+    std::vector<MatchResult> MatchDocuments(ExecutionPolicy &&policy,
+                                            const std::string_view raw_query,
+                                            const std::vector<int> &document_ids) const;
+
 private:
+    using CountedString = std::basic_string<char, std::char_traits<char>, CountingAllocator<char>>;
+
     struct DocumentData {
+        // Конструктор по умолчанию не объявлен: в C++20 std::pair проверяет
+        // его наличие, и для агрегата это инстанцирует CountedString() без аллокатора
+        DocumentData(int rating, DocumentStatus status, CountedString data, int word_count)
+            : rating(rating), status(status), data(std::move(data)), word_count(word_count)
+        {}
+
         int rating;
         DocumentStatus status;
-        std::string data;
+        CountedString data;
+        // Число слов без стоп-слов, нужно для нормализации длины в BM25
+        int word_count;
+    };
+
+    struct MemoryCounters {
+        MemoryCounter documents;
+        MemoryCounter dictionary;
+        MemoryCounter postings;
+        MemoryCounter reverse_index;
+        MemoryCounter document_ids;
+        MemoryCounter positions;
+        MemoryCounter attributes;
+        MemoryCounter status_documents;
+        MemoryCounter minus_cache;
+    };
+
+    using StatusDocuments = BasicDocumentBitset<CountingAllocator<uint64_t>>;
+
+    using InvertedIndex = std::map<std::string_view, PostingList, std::less<std::string_view>,
+                                   CountingAllocator<std::pair<const std::string_view, PostingList>>>;
+    using DocumentFrequencies = std::map<std::string_view, double, std::less<std::string_view>,
+                                         CountingAllocator<std::pair<const std::string_view, double>>>;
+    // Только в PostingStorage::EXACT: в COMPACT слова документа берутся из его текста
+    using ForwardIndex = std::map<int, DocumentFrequencies, std::less<int>,
+                                  CountingAllocator<std::pair<const int, DocumentFrequencies>>>;
+    using DocumentMap = std::map<int, DocumentData, std::less<int>,
+                                 CountingAllocator<std::pair<const int, DocumentData>>>;
+    using PositionMap = std::map<std::string_view, EncodedPositions, std::less<std::string_view>,
+                                 CountingAllocator<std::pair<const std::string_view, EncodedPositions>>>;
+    using PositionIndex = std::map<int, PositionMap, std::less<int>,
+                                   CountingAllocator<std::pair<const int, PositionMap>>>;
+
+    struct Phrase {
+        std::vector<std::string_view> words;
+        // Допустимое число слов между словами фразы
+        int slop = 0;
+    };
+
+    struct FuzzyWord {
+        std::string_view word;
+        double weight;
     };
 
     struct Query {
         std::vector<std::string_view> plus_words;
+        // Слова с плюсом (+word) обязательны и также входят в plus_words
+        std::vector<std::string_view> required_words;
         std::vector<std::string_view> minus_words;
+        // Слова фраз также входят в plus_words и ранжируются как обычно
+        std::vector<Phrase> phrases;
+        // Исправления слов из plus_words, ссылаются на словарь сервера
+        std::vector<FuzzyWord> fuzzy_words;
+        // Нормализованные слова запроса, если задан анализатор. Ёмкость резервируется
+        // заранее, а unique_ptr не даёт перемещению Query сдвинуть символы.
+        std::unique_ptr<std::string> normalized_words;
+    };
+
+    struct FuzzyCandidate {
+        std::string_view word;
+        int distance;
+        size_t document_freq;
+    };
+
+    // Вклад слова в релевантность документа. term - номер слова в порядке сложения:
+    // слова запроса идут по алфавиту, как в query.plus_words, затем исправления
+    // опечаток. Обход постингов идёт от редких слов к частым, а вклады каждого
+    // документа складываются по term, поэтому релевантность побитово совпадает
+    // с обходом слов по алфавиту.
+    struct TermContribution {
+        int document_id;
+        uint32_t term;
+        double score;
+    };
+
+    // Слово пакета запросов и номера запросов, в которых оно встречается
+    struct BatchTerm {
+        std::string_view word;
+        std::vector<size_t> query_indexes;
+        // Номер слова по алфавиту среди слов пакета; в каждом запросе его слова
+        // идут в том же порядке, что и в plus_words
+        uint32_t term;
+    };
+
+    // Вклады слов в релевантность для одного запроса пакета в одном диапазоне id.
+    // Дописывать в вектор дешевле, чем вставлять в std::map на каждый постинг.
+    struct BatchAccumulator {
+        std::vector<TermContribution> contributions;
+        std::vector<int> excluded_documents;
+    };
+
+    using BatchRelevance = std::vector<BatchAccumulator>;
+
+    // Слово плана со списком постингов из индекса
+    struct PlannedTerm {
+        std::string_view word;
+        const PostingList *postings;
+        // Множитель вклада: 1 для plus-слов, вес исправления для опечаток
+        double weight;
+        QueryStepKind kind;
+        // Номер слова в порядке сложения вкладов, см. TermContribution
+        uint32_t term;
+    };
+
+    struct ExecutionPlan {
+        QueryStrategy strategy = QueryStrategy::TERM_AT_A_TIME;
+        bool minus_words_first = true;
+        // Обязательного слова нет в индексе
+        bool matches_nothing = false;
+        // Plus-слова от редких к частым, затем исправления опечаток
+        std::vector<PlannedTerm> scored_terms;
+        std::vector<PlannedTerm> minus_terms;
+    };
+
+    // Битовые карты документов минус-слов, общие для всех запросов. Ключи
+    // ссылаются на словарь сервера. Изменение индекса сбрасывает кэш. Узлы
+    // словарей и байты закэшированных карт учитываются в counter.
+    struct MinusWordCache {
+        template <typename Value>
+        using TermMap = std::map<std::string_view, Value, std::less<std::string_view>,
+                                 CountingAllocator<std::pair<const std::string_view, Value>>>;
+
+        explicit MinusWordCache(MemoryCounter &counter);
+
+        void Insert(std::string_view term, std::shared_ptr<const RoaringBitmap> bitmap);
+
+        // Забывает счётчики запросов и карты
+        void Clear();
+
+        // Удаляет карты, возвращая их байты в counter
+        void ClearBitmaps();
+
+        std::mutex mutex;
+        MemoryCounter &counter;
+        uint64_t index_version = 0;
+        TermMap<int> requests;
+        TermMap<std::shared_ptr<const RoaringBitmap>> bitmaps;
     };
 
     struct QueryWord {
         std::string_view data;
         bool is_minus;
+        bool is_required;
+        bool is_prefix;
         bool is_stop;
     };
 
-    std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> docs_id_;
+    // Объявлен первым: аллокаторы контейнеров ниже ссылаются на счётчики,
+    // а unique_ptr сохраняет их адреса при перемещении сервера
+    std::unique_ptr<MemoryCounters> memory_;
+    AnalyzerFunction analyzer_;
+    StopWordSet stop_words_;
+    // Владеет текстом слов индекса: ключи ниже не должны ссылаться на текст
+    // документа, который может быть удалён раньше, чем слово исчезнет из индекса.
+    // Слова из инвертированного индекса не удаляются, поэтому он же служит
+    // отсортированным словарём для поиска по префиксу.
+    TermArena dictionary_;
+    InvertedIndex word_to_document_freqs_;
+    ForwardIndex document_to_word_freqs_;
+    DocumentMap documents_;
+    DocumentIds docs_id_;
+    long long total_word_count_ = 0;
+    // Документы каждого статуса, индекс - static_cast<size_t>(DocumentStatus)
+    std::array<StatusDocuments, DOCUMENT_STATUS_COUNT> status_documents_;
+    AttributeIndex attributes_;
+    PostingStorage posting_storage_ = PostingStorage::EXACT;
+    bool positions_enabled_ = false;
+    FuzzyOptions fuzzy_;
+    PositionIndex document_to_word_positions_;
+    // Отличает снимки индекса этого сервера от снимков других серверов
+    ServerId server_id_;
+    // Увеличивается при каждом добавлении и удалении документа
+    uint64_t index_version_ = 0;
+    // Заполняется из const-методов поиска, поэтому за указателем и под своим мьютексом
+    std::unique_ptr<MinusWordCache> minus_cache_;
+
+    void Swap(SearchServer &other) noexcept;
+
+    IndexSource GetIndexSource() const;
+
+    template <size_t... Statuses>
+    static std::array<StatusDocuments, DOCUMENT_STATUS_COUNT> MakeStatusDocuments(MemoryCounter &counter,
+                                                                                 std::index_sequence<Statuses...>);
 
     bool IsStopWord(const std::string_view word) const;
 
+    std::string_view InternWord(const std::string_view word);
+
     std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
 
+    // Нормализует слова текста на месте и склеивает их через один пробел;
+    // слова, ставшие пустыми, выбрасываются
+    void AnalyzeText(CountedString &text) const;
+
+    std::string_view AnalyzeQueryWord(std::string_view word, Query &query) const;
+
     static int ComputeAverageRating(const std::vector<int> &ratings);
 
     static bool IsValidWord(const std::string_view word);
 
-    QueryWord ParseQueryWord(std::string_view text) const;
+    QueryWord ParseQueryWord(std::string_view text, Query &query) const;
+
+    // Дописывает в words слова словаря с данным префиксом, у которых есть документы,
+    // в лексикографическом порядке, не больше MAX_PREFIX_EXPANSIONS
+    void ExpandPrefix(std::string_view prefix, std::vector<std::string_view> &words) const;
+
+    // Пересекает автомат Левенштейна со словарём: обходит отсортированные слова,
+    // переиспользуя строки динамики общего префикса, и пропускает все слова
+    // с префиксом, после которого расстояние уже не может уложиться в max_edits
+    void CollectFuzzyTerms(std::string_view word, int max_edits, std::vector<FuzzyCandidate> &candidates) const;
+
+    void AddFuzzyWords(Query &query) const;
+
+    // Отрезает закрывающую кавычку и ~N; false, если слово не последнее во фразе
+    static bool ParsePhraseEnd(std::string_view &word, Phrase &phrase);
 
     Query ParseQuery(const std::string_view text) const;
 
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    CollectionStats GetCollectionStats() const;
+
+    // Слияние отсортированных слов запроса с отсортированными словами документа
+    MatchResult MatchQuery(const Query &query, int document_id) const;
+
+    void IndexPositions(int document_id, const std::vector<std::string_view> &words);
+
+    // Записывает доли слов документа в постинги и, в PostingStorage::EXACT, в прямой индекс
+    void IndexTerms(int document_id, const std::vector<std::string_view> &words);
+
+    // Различные слова документа по алфавиту, ссылаются на словарь сервера
+    std::vector<std::string_view> GetDocumentTerms(int document_id) const;
+
+    // Текст документа, подготовленный к вставке в индекс вне основного потока
+    struct PreparedDocument {
+        CountedString text;
+        // Смещение и длина каждого слова в text: string_view не пережил бы
+        // перемещение короткой строки, хранящейся внутри объекта
+        std::vector<std::pair<size_t, size_t>> word_spans;
+    };
+
+    PreparedDocument PrepareDocument(std::string_view document) const;
+
+    // Сохраняет подготовленный документ; id и слова уже проверены
+    void InsertDocument(int document_id, DocumentStatus status, const std::vector<int> &ratings,
+                        PreparedDocument prepared);
+
+    // Проверка id до изменения индекса: неотрицательный, новый и не повторяется в records
+    void CheckNewDocumentIds(const std::vector<DocumentRecord> &records) const;
+
+    template<typename ExecutionPolicy>
+    void AddDocumentsImpl(ExecutionPolicy &&policy, const std::vector<DocumentRecord> &records);
+
+    void EraseDocumentData(int document_id);
+
+    // Выбирает порядок слов и стратегию обхода по частотам слов: оценки стоимости
+    // считаются в числе обращений к постингам и накопителю
+    ExecutionPlan PlanQuery(const Query &query) const;
+
+    static void StartExplanation(const ExecutionPlan &plan, QueryPlan &explanation);
+
+    std::shared_ptr<const RoaringBitmap> GetMinusWordBitmap(std::string_view term, const PostingList &postings) const;
+
+    // Документы, содержащие хотя бы одно минус-слово плана. Строится до обхода
+    // постингов, чтобы исключённые документы не попадали в накопитель; пусто,
+    // если план проверяет минус-слова после подсчёта.
+    std::shared_ptr<const RoaringBitmap> BuildMinusFilter(const ExecutionPlan &plan) const;
+
+    bool IsExcludedByMinusWords(const ExecutionPlan &plan, int document_id, QueryPlan *explanation) const;
+
+    bool ContainsRequiredWords(const Query &query, int document_id) const;
+
+    // Проверяет фразы запроса по позициям кандидата и повышает релевантность
+    // за близость слов. Вызывается только для кандидатов, переживших минус-слова.
+    bool MatchPhrases(const Query &query, int document_id, double &relevance) const;
+
+    static void SelectTopDocuments(std::vector<Document> &matched_documents);
+
+    template<typename ExecutionPolicy>
+    // errors == nullptr - первая ошибка разбора выбрасывается
+    std::vector<std::vector<Document>> ExecuteBatch(ExecutionPolicy &&policy,
+                                                    const std::vector<std::string> &raw_queries,
+                                                    int shard_count,
+                                                    std::vector<std::exception_ptr> *errors) const;
+
+    static std::vector<BatchTerm> GroupBatchTerms(const std::vector<Query> &queries,
+                                                  std::vector<std::string_view> Query::*words);
+
+    // Обрабатывает постинги с id из [first_id, last_id) в том же порядке слов,
+    // что и FindAllDocuments, поэтому суммы релевантности совпадают побитово
+    void AccumulateBatch(const std::vector<Query> &queries,
+                         const std::vector<BatchTerm> &plus_terms,
+                         const std::vector<BatchTerm> &minus_terms,
+                         int first_id,
+                         int last_id,
+                         BatchRelevance &relevance) const;
+
+    // Сортирует вклады по документу и номеру слова и складывает вклады каждого
+    // документа в этом порядке; результат по возрастанию id
+    static std::vector<std::pair<int, double>> SumContributions(std::vector<TermContribution> &contributions);
+
+    // Складывает вклады по документам и добавляет прошедшие минус-слова и фразы
+    void CollectBatchDocuments(const Query &query, BatchAccumulator &accumulator,
+                               std::vector<Document> &matched_documents) const;
+
+    // Фильтры по статусу и AttributeFilter применяются к каждому постингу через
+    // битовые карты, произвольный предикат - только к кандидатам, пережившим минус-слова
+    template<typename Handler>
+    bool PassesStatusFilter(const Handler &lambda, int document_id) const;
+
+    // Документы, выбранные AttributeFilter из индекса атрибутов. nullopt для прочих
+    // фильтров и для запросов, у которых постингов меньше, чем блоков индекса
+    // атрибутов: выборка по блокам стоит O(документов), и такие запросы дешевле
+    // проверяют колонки атрибутов для каждого постинга.
+    template<typename Handler>
+    std::optional<DocumentBitset> SelectAttributeDocuments(const Handler &lambda, const ExecutionPlan &plan) const;
+
+    template<typename Handler>
+    bool PassesPostingFilter(const Handler &lambda, const std::optional<DocumentBitset> &selected_documents, int document_id) const;
 
     template<typename Handler>
-    std::vector<Document> FindAllDocuments(const Query &query, Handler lambda) const;
+    static bool IsAcceptedCandidate(Handler &lambda, int document_id, const DocumentData &data);
+
+    template<typename Scorer>
+    int GetDocumentLength(int document_id) const;
 
-    template<typename Handler, typename ExecutionPolicy>
-    std::vector<Document> FindAllDocuments(ExecutionPolicy &&policy, const Query &query, Handler lambda) const;
+    // Для каждого документа вклады складываются в порядке слов запроса по алфавиту,
+    // затем исправлений опечаток, независимо от порядка обхода плана - все стратегии
+    // и пакетный режим дают побитово одинаковую релевантность.
+    // explanation, если задан, получает план и счётчики шагов. budget, если задан,
+    // ограничивает число прочитанных постингов; минус-слова учитываются целиком.
+    template<typename Scorer, typename Handler>
+    std::vector<Document> FindAllDocuments(const Scorer &scorer, const Query &query, Handler lambda,
+                                           QueryPlan *explanation = nullptr,
+                                           BudgetTracker *budget = nullptr) const;
+
+    template<typename Scorer, typename Handler, typename ExecutionPolicy>
+    std::vector<Document> FindAllDocuments(ExecutionPolicy &&policy, const Scorer &scorer, const Query &query, Handler lambda) const;
+
+    // Переносит счётчики курсоров в шаги explanation. Кандидаты шага - документы,
+    // впервые встреченные на нём или на предыдущих шагах плана.
+    template<typename Cursor>
+    static void FillStepCounters(const std::vector<Cursor> &cursors, const std::vector<size_t> &new_candidates,
+                                 QueryPlan &explanation);
+
+    // Результат по возрастанию id
+    template<typename Scorer, typename Handler>
+    std::vector<std::pair<int, double>> AccumulateDocumentAtATime(const Scorer &scorer,
+                                                                  const CollectionStats &stats,
+                                                                  const ExecutionPlan &plan,
+                                                                  const RoaringBitmap &excluded_documents,
+                                                                  const Handler &lambda,
+                                                                  const std::optional<DocumentBitset> &selected_documents,
+                                                                  QueryPlan *explanation,
+                                                                  BudgetTracker *budget) const;
+
+    // Обходит список самого редкого обязательного слова и ищет каждый его документ
+    // в списках остальных; результат по возрастанию id
+    template<typename Scorer, typename Handler>
+    std::vector<std::pair<int, double>> AccumulateIntersection(const Scorer &scorer,
+                                                               const CollectionStats &stats,
+                                                               const ExecutionPlan &plan,
+                                                               const RoaringBitmap &excluded_documents,
+                                                               const Handler &lambda,
+                                                               const std::optional<DocumentBitset> &selected_documents,
+                                                               QueryPlan *explanation,
+                                                               BudgetTracker *budget) const;
+
+    // Проверяет кандидатов (пары id и релевантности по возрастанию id) минус-словами,
+    // если план откладывает их, предикатом и фразами. По истечении срока budget
+    // остальные кандидаты отбрасываются.
+    template<typename Handler, typename DocumentRelevances>
+    std::vector<Document> CollectCandidates(const Query &query,
+                                            const ExecutionPlan &plan,
+                                            Handler &lambda,
+                                            const DocumentRelevances &document_relevances,
+                                            QueryPlan *explanation,
+                                            BudgetTracker *budget = nullptr) const;
 };
 
+template <size_t... Statuses>
+std::array<SearchServer::StatusDocuments, DOCUMENT_STATUS_COUNT> SearchServer::MakeStatusDocuments(
+        MemoryCounter& counter, std::index_sequence<Statuses...>) {
+    // У карт нет конструктора по умолчанию, поэтому массив перечисляется целиком
+    return {((void) Statuses, StatusDocuments(StatusDocuments::allocator_type(counter)))...};
+}
+
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
-        : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+SearchServer::SearchServer(const StringContainer& stop_words, AnalyzerFunction analyzer)
+        : memory_(std::make_unique<MemoryCounters>()),
+        analyzer_(analyzer),
+
+        dictionary_(memory_->dictionary),
+        word_to_document_freqs_(InvertedIndex::allocator_type(memory_->dictionary)),
+        document_to_word_freqs_(ForwardIndex::allocator_type(memory_->reverse_index)),
+        documents_(DocumentMap::allocator_type(memory_->documents)),
+        docs_id_(DocumentIds::allocator_type(memory_->document_ids)),
+        status_documents_(MakeStatusDocuments(memory_->status_documents,
+                                              std::make_index_sequence<DOCUMENT_STATUS_COUNT>())),
+        attributes_(memory_->attributes),
+        document_to_word_positions_(PositionIndex::allocator_type(memory_->positions)),
+        minus_cache_(std::make_unique<MinusWordCache>(memory_->minus_cache))
 {
     for (const auto& word: stop_words) {
         if (!IsValidWord(word)) {
             throw std::invalid_argument("init stop word - contains an invalid character");
         }
     }
+    std::set<std::string, std::less<>> unique_stop_words = MakeUniqueNonEmptyStrings(stop_words);
+    if (analyzer_) {
+        std::set<std::string, std::less<>> analyzed_stop_words;
+        for (std::string word : unique_stop_words) {
+            word.resize(analyzer_(word.data(), word.size()));
+            if (!word.empty()) {
+                analyzed_stop_words.insert(std::move(word));
+            }
+        }
+        unique_stop_words = std::move(analyzed_stop_words);
+    }
+    stop_words_ = StopWordSet(unique_stop_words);
 }
 
 template<typename Handler>
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, Handler lambda) const {
+    return FindTopDocuments(TfIdfScorer(), raw_query, lambda);
+}
+
+template <typename Handler, typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy>>
+std::vector<Document> SearchServer::FindTopDocuments(
+        ExecutionPolicy&& policy,
+        std::string_view raw_query,
+        Handler lambda) const {
+    return FindTopDocuments(policy, TfIdfScorer(), raw_query, lambda);
+}
+
+template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy>>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy>>
+std::vector<Document>SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus needed_status) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatusFilter{needed_status});
+}
+
+template<typename Scorer, typename Handler, EnableIfScorer<Scorer>>
+std::vector<Document> SearchServer::FindTopDocuments(const Scorer& scorer, const std::string_view raw_query, Handler lambda) const {
     const Query query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(query, lambda);
-
-    sort(matched_documents.begin(), matched_documents.end(),
-         [](const Document& lhs, const Document& rhs) {
-             if (std::abs(lhs.relevance - rhs.relevance) < ACCURACY) {
-                 return lhs.rating > rhs.rating;
-             } else {
-                 return lhs.relevance > rhs.relevance;
-             }
-         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
+    auto matched_documents = FindAllDocuments(scorer, query, lambda);
+
+    TRACE_QUERY_STAGE(QueryStage::TOP_K);
+    SelectTopDocuments(matched_documents);
     return matched_documents;
 }
 
-template <typename Handler, typename ExecutionPolicy>
+template<typename Scorer, EnableIfScorer<Scorer>>
+std::vector<Document> SearchServer::FindTopDocuments(const Scorer& scorer, const std::string_view raw_query) const {
+    return FindTopDocuments(scorer, raw_query, DocumentStatus::ACTUAL);
+}
+
+template<typename Scorer, EnableIfScorer<Scorer>>
+std::vector<Document> SearchServer::FindTopDocuments(const Scorer& scorer, const std::string_view raw_query, DocumentStatus needed_status) const {
+    return FindTopDocuments(scorer, raw_query, DocumentStatusFilter{needed_status});
+}
+
+template <typename ExecutionPolicy, typename Scorer, typename Handler,
+          EnableIfExecutionPolicy<ExecutionPolicy>, EnableIfScorer<Scorer>>
 std::vector<Document> SearchServer::FindTopDocuments(
         ExecutionPolicy&& policy,
+        const Scorer& scorer,
         std::string_view raw_query,
         Handler lambda) const {
     const Query query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(policy, query, lambda);
-
-    sort(policy,
-         matched_documents.begin(),
-         matched_documents.end(),
-         [](const Document& lhs, const Document& rhs)
-         {
-             if (std::abs(lhs.relevance - rhs.relevance) < ACCURACY) {
-                 return lhs.rating > rhs.rating;
-             } else {
-                 return lhs.relevance > rhs.relevance;
-             }
-         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
+    auto matched_documents = FindAllDocuments(policy, scorer, query, lambda);
+
+    TRACE_QUERY_STAGE(QueryStage::TOP_K);
+    SelectTopResults(policy, matched_documents, MAX_RESULT_DOCUMENT_COUNT);
     return matched_documents;
 }
 
-template <typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query) const {
-    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+template <typename ExecutionPolicy, typename Scorer,
+          EnableIfExecutionPolicy<ExecutionPolicy>, EnableIfScorer<Scorer>>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const Scorer& scorer, const std::string_view raw_query) const {
+    return FindTopDocuments(policy, scorer, raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename ExecutionPolicy>
-std::vector<Document>SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus needed_status) const {
-    return FindTopDocuments(policy, raw_query, [needed_status](int _, DocumentStatus status, int rating) {
-        return status == needed_status;
-    });
+template <typename ExecutionPolicy, typename Scorer,
+          EnableIfExecutionPolicy<ExecutionPolicy>, EnableIfScorer<Scorer>>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy,
+                                                     const Scorer& scorer,
+                                                     const std::string_view raw_query,
+                                                     DocumentStatus needed_status) const {
+    return FindTopDocuments(policy, scorer, raw_query, DocumentStatusFilter{needed_status});
+}
+
+template<typename ExecutionPolicy, EnableIfExecutionPolicy<ExecutionPolicy>>
+std::vector<SearchServer::MatchResult> SearchServer::MatchDocuments(ExecutionPolicy&& policy,
+                                                                   const std::string_view raw_query,
+                                                                   const std::vector<int>& document_ids) const {
+    for (const int document_id : document_ids) {
+        if (!docs_id_.count(document_id))
+            throw std::out_of_range("MatchDocuments out_of_range - передан не сущ. id ");
+    }
+
+    const Query query = ParseQuery(raw_query);
+    std::vector<MatchResult> result(document_ids.size());
+    std::transform(policy,
+                   document_ids.cbegin(),
+                   document_ids.cend(),
+                   result.begin(),
+                   [this, &query](int document_id) {
+                       return MatchQuery(query, document_id);
+                   });
+    return result;
 }
 
-template<typename Handler, typename ExecutionPolicy>
+template<typename Scorer, typename Handler, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy&& policy,
+                                                     const Scorer& scorer,
                                                      const Query& query,
                                                      Handler lambda) const {
     ConcurrentMap<int, double> document_to_relevance(20);
+    const CollectionStats stats = GetCollectionStats();
 
-    std::for_each(policy,
-                  query.plus_words.begin(),
-                  query.plus_words.end(),
-                  [this, &lambda, &document_to_relevance](std::string_view word)
-                  {
-                      if (word_to_document_freqs_.count(word)) {
-                          const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                          for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                              const DocumentData& data = documents_.at(document_id);
-                              if (lambda(document_id, data.status, data.rating)) {
-                                  document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+    // Стратегию плана параллельная версия не учитывает: слова всегда обходятся
+    // параллельно, каждое целиком
+    ExecutionPlan plan;
+    {
+        TRACE_QUERY_STAGE(QueryStage::PLAN);
+        plan = PlanQuery(query);
+    }
+    std::shared_ptr<const RoaringBitmap> minus_filter;
+    {
+        TRACE_QUERY_STAGE(QueryStage::MINUS_FILTER);
+        minus_filter = BuildMinusFilter(plan);
+    }
+    const RoaringBitmap& excluded_documents = *minus_filter;
+    const std::optional<DocumentBitset> selected_documents = SelectAttributeDocuments(lambda, plan);
+
+    if (plan.strategy == QueryStrategy::INTERSECTION) {
+        // Пересечение последовательно: каждый шаг зависит от позиций всех списков
+        std::vector<std::pair<int, double>> document_relevances;
+        {
+            TRACE_QUERY_STAGE(QueryStage::POSTINGS);
+            document_relevances = AccumulateIntersection(scorer, stats, plan, excluded_documents,
+                                                         lambda, selected_documents, nullptr, nullptr);
+        }
+        TRACE_QUERY_STAGE(QueryStage::MERGE);
+        return CollectCandidates(query, plan, lambda, document_relevances, nullptr);
+    }
+
+    {
+        TRACE_QUERY_STAGE(QueryStage::POSTINGS);
+        std::for_each(policy,
+                      plan.scored_terms.begin(),
+                      plan.scored_terms.end(),
+                      [this, &scorer, &stats, &lambda, &selected_documents, &excluded_documents, &document_to_relevance](const PlannedTerm& term)
+                      {
+                          const auto term_scorer = scorer.ForTerm(stats, term.postings->size());
+                          RoaringBitmap::SequentialReader excluded(excluded_documents);
+                          for (const auto [document_id, term_freq] : *term.postings) {
+                              if (!excluded.Contains(document_id) && PassesPostingFilter(lambda, selected_documents, document_id)) {
+                                  document_to_relevance[document_id].ref_to_value +=
+                                          term.weight * term_scorer(term_freq, GetDocumentLength<Scorer>(document_id));
                               }
                           }
-                      }
-                  });
-
-    std::for_each(policy,
-                  query.minus_words.begin(),
-                  query.minus_words.end(),
-                  [this, &document_to_relevance](std::string_view word)
-                  {
-                      if (word_to_document_freqs_.count(word)) {
-                          for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                              document_to_relevance.Erase(document_id);
-                          }
-                      }
-                  });
+                      });
+    }
 
-    std::map<int, double> ordinary_document_to_relevance = document_to_relevance.BuildOrdinaryMap();
-    std::vector<Document> matched_documents;
-    matched_documents.reserve(ordinary_document_to_relevance.size());
+    TRACE_QUERY_STAGE(QueryStage::MERGE);
+    // Порядок по id - как у последовательной версии
+    std::vector<std::pair<int, double>> document_relevances;
+    document_relevances.reserve(document_to_relevance.Size());
+    document_to_relevance.ForEach([&document_relevances](int document_id, double relevance) {
+        document_relevances.emplace_back(document_id, relevance);
+    });
+    std::sort(document_relevances.begin(), document_relevances.end());
+    return CollectCandidates(query, plan, lambda, document_relevances, nullptr);
+}
 
-    for (const auto [document_id, relevance] : ordinary_document_to_relevance) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+template<typename Scorer, typename Handler>
+std::vector<Document> SearchServer::FindAllDocuments(const Scorer& scorer, const Query& query, Handler lambda,
+                                                     QueryPlan* explanation, BudgetTracker* budget) const {
+    const CollectionStats stats = GetCollectionStats();
+    ExecutionPlan plan;
+    {
+        TRACE_QUERY_STAGE(QueryStage::PLAN);
+        plan = PlanQuery(query);
     }
-    return matched_documents;
+    std::shared_ptr<const RoaringBitmap> minus_filter;
+    {
+        TRACE_QUERY_STAGE(QueryStage::MINUS_FILTER);
+        minus_filter = BuildMinusFilter(plan);
+    }
+    const std::optional<DocumentBitset> selected_documents = SelectAttributeDocuments(lambda, plan);
+    if (explanation) {
+        StartExplanation(plan, *explanation);
+    }
+    if (budget && plan.minus_words_first) {
+        size_t minus_postings = 0;
+        for (const PlannedTerm& term : plan.minus_terms) {
+            minus_postings += term.postings->size();
+        }
+        budget->Consume(minus_postings);
+    }
+
+    if (plan.strategy != QueryStrategy::TERM_AT_A_TIME) {
+        std::vector<std::pair<int, double>> document_relevances;
+        {
+            TRACE_QUERY_STAGE(QueryStage::POSTINGS);
+            document_relevances = plan.strategy == QueryStrategy::INTERSECTION
+                    ? AccumulateIntersection(scorer, stats, plan, *minus_filter, lambda, selected_documents, explanation, budget)
+                    : AccumulateDocumentAtATime(scorer, stats, plan, *minus_filter, lambda, selected_documents, explanation, budget);
+        }
+        TRACE_QUERY_STAGE(QueryStage::MERGE);
+        return CollectCandidates(query, plan, lambda, document_relevances, explanation, budget);
+    }
+
+    std::vector<TermContribution> contributions;
+    {
+        TRACE_QUERY_STAGE(QueryStage::POSTINGS);
+        // Документы, уже получившие вклад, отмечаются только для счётчиков Explain
+        DocumentBitset candidates;
+        size_t candidate_count = 0;
+        bool exhausted = budget && !budget->Consume(0);
+        for (size_t step = 0; step < plan.scored_terms.size() && !exhausted; ++step) {
+            const PlannedTerm& term = plan.scored_terms[step];
+            const auto term_scorer = scorer.ForTerm(stats, term.postings->size());
+            RoaringBitmap::SequentialReader excluded(*minus_filter);
+            size_t visited = 0;
+            size_t scored = 0;
+            for (const auto [document_id, term_freq] : *term.postings) {
+                ++visited;
+                if (!excluded.Contains(document_id) && PassesPostingFilter(lambda, selected_documents, document_id)) {
+                    contributions.push_back({document_id, term.term,
+                                             term.weight * term_scorer(term_freq, GetDocumentLength<Scorer>(document_id))});
+                    ++scored;
+                    if (explanation && !candidates.Test(document_id)) {
+                        candidates.Set(document_id);
+                        ++candidate_count;
+                    }
+                }
+                if (budget && !budget->Consume()) {
+                    exhausted = true;
+                    break;
+                }
+            }
+            if (explanation) {
+                QueryPlanStep& counters = explanation->steps[step];
+                counters.postings_visited = visited;
+                counters.postings_scored = scored;
+                counters.candidates = candidate_count;
+            }
+        }
+    }
+
+    TRACE_QUERY_STAGE(QueryStage::MERGE);
+    return CollectCandidates(query, plan, lambda, SumContributions(contributions), explanation, budget);
 }
 
-template<typename Handler>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, Handler lambda) const {
-    std::map<int, double> document_to_relevance;
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+template<typename Scorer, typename Handler>
+std::vector<std::pair<int, double>> SearchServer::AccumulateDocumentAtATime(const Scorer& scorer,
+                                                                           const CollectionStats& stats,
+                                                                           const ExecutionPlan& plan,
+                                                                           const RoaringBitmap& excluded_documents,
+                                                                           const Handler& lambda,
+                                                                           const std::optional<DocumentBitset>& selected_documents,
+                                                                           QueryPlan* explanation,
+                                                                           BudgetTracker* budget) const {
+    struct Cursor {
+        PostingList::const_iterator it;
+        PostingList::const_iterator end;
+        decltype(scorer.ForTerm(stats, 0)) term_scorer;
+        double weight;
+        // Номер шага плана
+        size_t step;
+        size_t visited;
+        size_t scored;
+    };
+    std::vector<Cursor> cursors;
+    cursors.reserve(plan.scored_terms.size());
+    for (size_t step = 0; step < plan.scored_terms.size(); ++step) {
+        const PlannedTerm& term = plan.scored_terms[step];
+        cursors.push_back({term.postings->begin(), term.postings->end(),
+                           scorer.ForTerm(stats, term.postings->size()), term.weight, step, 0, 0});
+    }
+    // Курсоры в порядке сложения вкладов, см. TermContribution
+    std::sort(cursors.begin(), cursors.end(), [&plan](const Cursor& lhs, const Cursor& rhs) {
+        return plan.scored_terms[lhs.step].term < plan.scored_terms[rhs.step].term;
+    });
+
+    std::vector<std::pair<int, double>> document_relevances;
+    // Для Explain: сколько кандидатов впервые встретилось на каждом шаге плана
+    std::vector<size_t> new_candidates(explanation ? cursors.size() : 0);
+    RoaringBitmap::SequentialReader excluded(excluded_documents);
+    bool exhausted = budget && !budget->Consume(0);
+    while (!exhausted) {
+        int document_id = std::numeric_limits<int>::max();
+        bool has_postings = false;
+        for (const Cursor& cursor : cursors) {
+            if (cursor.it != cursor.end) {
+                document_id = std::min(document_id, cursor.it->first);
+                has_postings = true;
+            }
+        }
+        if (!has_postings) {
+            break;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            if (lambda(document_id, documents_.at(document_id).status, documents_.at(document_id).rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+
+        const bool accepted = !excluded.Contains(document_id) && PassesPostingFilter(lambda, selected_documents, document_id);
+        const int document_length = accepted ? GetDocumentLength<Scorer>(document_id) : 0;
+        // Вклады складываются в порядке слов, как при обходе по словам,
+        // поэтому суммы совпадают побитово
+        double relevance = 0.0;
+        size_t postings = 0;
+        size_t first_step = cursors.size();
+        for (Cursor& cursor : cursors) {
+            if (cursor.it != cursor.end && cursor.it->first == document_id) {
+                if (accepted) {
+                    relevance += cursor.weight * cursor.term_scorer(cursor.it->second, document_length);
+                    ++cursor.scored;
+                    first_step = std::min(first_step, cursor.step);
+                }
+                ++cursor.it;
+                ++cursor.visited;
+                ++postings;
+            }
+        }
+        if (accepted) {
+            document_relevances.emplace_back(document_id, relevance);
+            if (explanation) {
+                ++new_candidates[first_step];
             }
         }
+        exhausted = budget && !budget->Consume(postings);
+    }
+
+    if (explanation) {
+        FillStepCounters(cursors, new_candidates, *explanation);
     }
+    return document_relevances;
+}
 
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+template<typename Scorer, typename Handler>
+std::vector<std::pair<int, double>> SearchServer::AccumulateIntersection(const Scorer& scorer,
+                                                                        const CollectionStats& stats,
+                                                                        const ExecutionPlan& plan,
+                                                                        const RoaringBitmap& excluded_documents,
+                                                                        const Handler& lambda,
+                                                                        const std::optional<DocumentBitset>& selected_documents,
+                                                                        QueryPlan* explanation,
+                                                                        BudgetTracker* budget) const {
+    struct Cursor {
+        const PostingList* postings;
+        PostingList::const_iterator it;
+        PostingList::const_iterator end;
+        decltype(scorer.ForTerm(stats, 0)) term_scorer;
+        double weight;
+        bool is_required;
+        // Номер шага плана
+        size_t step;
+        size_t visited;
+        size_t scored;
+    };
+    std::vector<Cursor> cursors;
+    std::vector<std::pair<int, double>> document_relevances;
+    if (plan.matches_nothing) {
+        return document_relevances;
+    }
+    cursors.reserve(plan.scored_terms.size());
+    for (size_t step = 0; step < plan.scored_terms.size(); ++step) {
+        const PlannedTerm& term = plan.scored_terms[step];
+        cursors.push_back({term.postings, term.postings->begin(), term.postings->end(), scorer.ForTerm(stats, term.postings->size()),
+                           term.weight, term.kind == QueryStepKind::REQUIRED, step, 0, 0});
+    }
+    // Курсоры в порядке сложения вкладов, см. TermContribution
+    std::sort(cursors.begin(), cursors.end(), [&plan](const Cursor& lhs, const Cursor& rhs) {
+        return plan.scored_terms[lhs.step].term < plan.scored_terms[rhs.step].term;
+    });
+    // Номера обязательных курсоров от редкого к частому, в порядке плана
+    std::vector<size_t> required;
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        if (cursors[i].is_required) {
+            required.push_back(i);
+        }
+    }
+    std::sort(required.begin(), required.end(), [&cursors](size_t lhs, size_t rhs) {
+        return cursors[lhs].step < cursors[rhs].step;
+    });
+
+    // Аналог галопирующего поиска для дерева: несколько шагов вперёд по соседним
+    // узлам, затем lower_bound от корня за O(log n). Позиция только растёт.
+    const auto seek = [](Cursor& cursor, int document_id) {
+        const auto end = cursor.end;
+        for (int step = 0; step < INTERSECTION_LINEAR_STEPS && cursor.it != end && cursor.it->first < document_id; ++step) {
+            ++cursor.it;
+        }
+        if (cursor.it != end && cursor.it->first < document_id) {
+            cursor.it = cursor.postings->lower_bound(document_id);
+        }
+        return cursor.it != end && cursor.it->first == document_id;
+    };
+
+    // Для Explain: сколько кандидатов впервые встретилось на каждом шаге плана
+    std::vector<size_t> new_candidates(explanation ? cursors.size() : 0);
+    Cursor& lead = cursors[required.front()];
+    RoaringBitmap::SequentialReader excluded(excluded_documents);
+    bool exhausted = budget && !budget->Consume(0);
+    while (!exhausted && lead.it != lead.end) {
+        const int document_id = lead.it->first;
+        ++lead.visited;
+        // Документ, на котором остановился отставший список, - следующий кандидат
+        int next_id = document_id;
+        size_t seeks = 1;
+        for (size_t i = 1; i < required.size() && next_id == document_id; ++i) {
+            Cursor& cursor = cursors[required[i]];
+            ++cursor.visited;
+            ++seeks;
+            if (!seek(cursor, document_id)) {
+                next_id = cursor.it == cursor.end ? std::numeric_limits<int>::max() : cursor.it->first;
+            }
+        }
+        exhausted = budget && !budget->Consume(seeks);
+        if (next_id != document_id) {
+            if (next_id == std::numeric_limits<int>::max()) {
+                break;
+            }
+            // Ведущий список тоже перескакивает вперёд
+            seek(lead, next_id);
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+
+        if (!excluded.Contains(document_id) && PassesPostingFilter(lambda, selected_documents, document_id)) {
+            const int document_length = GetDocumentLength<Scorer>(document_id);
+            // Вклады в порядке слов, как при обходе по словам
+            double relevance = 0.0;
+            size_t first_step = cursors.size();
+            for (Cursor& cursor : cursors) {
+                cursor.visited += cursor.is_required ? 0 : 1;
+                if (cursor.is_required || seek(cursor, document_id)) {
+                    relevance += cursor.weight * cursor.term_scorer(cursor.it->second, document_length);
+                    ++cursor.scored;
+                    first_step = std::min(first_step, cursor.step);
+                }
+            }
+            document_relevances.emplace_back(document_id, relevance);
+            if (explanation) {
+                ++new_candidates[first_step];
+            }
         }
+        ++lead.it;
     }
 
+    if (explanation) {
+        FillStepCounters(cursors, new_candidates, *explanation);
+    }
+    return document_relevances;
+}
+
+template<typename Cursor>
+void SearchServer::FillStepCounters(const std::vector<Cursor>& cursors, const std::vector<size_t>& new_candidates,
+                                    QueryPlan& explanation) {
+    for (const Cursor& cursor : cursors) {
+        QueryPlanStep& counters = explanation.steps[cursor.step];
+        counters.postings_visited = cursor.visited;
+        counters.postings_scored = cursor.scored;
+    }
+    size_t candidates = 0;
+    for (size_t step = 0; step < new_candidates.size(); ++step) {
+        candidates += new_candidates[step];
+        explanation.steps[step].candidates = candidates;
+    }
+}
+
+template<typename Handler, typename DocumentRelevances>
+std::vector<Document> SearchServer::CollectCandidates(const Query& query,
+                                                      const ExecutionPlan& plan,
+                                                      Handler& lambda,
+                                                      const DocumentRelevances& document_relevances,
+                                                      QueryPlan* explanation,
+                                                      BudgetTracker* budget) const {
     std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+    for (auto [document_id, relevance] : document_relevances) {
+        if (budget && !budget->Tick()) {
+            break;
+        }
+        if (!plan.minus_words_first && IsExcludedByMinusWords(plan, document_id, explanation)) {
+            continue;
+        }
+        const DocumentData& data = documents_.at(document_id);
+        if (IsAcceptedCandidate(lambda, document_id, data)
+            && (query.phrases.empty() || MatchPhrases(query, document_id, relevance))) {
+            matched_documents.push_back({document_id, relevance, data.rating});
+        }
     }
     return matched_documents;
-}
\ No newline at end of file
+}
+
+template<typename Handler>
+bool SearchServer::PassesStatusFilter(const Handler& lambda, int document_id) const {
+    if constexpr (std::is_same_v<Handler, DocumentStatusFilter>) {
+        return status_documents_[static_cast<size_t>(lambda.status)].Test(document_id);
+    } else {
+        return true;
+    }
+}
+
+template<typename Handler>
+std::optional<DocumentBitset> SearchServer::SelectAttributeDocuments(const Handler& lambda, const ExecutionPlan& plan) const {
+    if constexpr (std::is_same_v<Handler, AttributeFilter>) {
+        size_t posting_count = 0;
+        for (const PlannedTerm& term : plan.scored_terms) {
+            posting_count += term.postings->size();
+        }
+        if (posting_count < attributes_.GetBlockCount()) {
+            return std::nullopt;
+        }
+        TRACE_QUERY_STAGE(QueryStage::ATTRIBUTE_FILTER);
+        return attributes_.Select(lambda);
+    } else {
+        return std::nullopt;
+    }
+}
+
+template<typename Handler>
+bool SearchServer::PassesPostingFilter(const Handler& lambda, const std::optional<DocumentBitset>& selected_documents, int document_id) const {
+    if constexpr (std::is_same_v<Handler, AttributeFilter>) {
+        return selected_documents ? selected_documents->Test(document_id) : attributes_.Matches(lambda, document_id);
+    } else {
+        return PassesStatusFilter(lambda, document_id);
+    }
+}
+
+template<typename Handler>
+bool SearchServer::IsAcceptedCandidate(Handler& lambda, int document_id, const DocumentData& data) {
+    if constexpr (std::is_same_v<Handler, DocumentStatusFilter> || std::is_same_v<Handler, AttributeFilter>) {
+        return true;
+    } else {
+        return lambda(document_id, data.status, data.rating);
+    }
+}
+
+template<typename Scorer>
+int SearchServer::GetDocumentLength(int document_id) const {
+    if constexpr (Scorer::NEEDS_DOCUMENT_LENGTH) {
+        return documents_.at(document_id).word_count;
+    } else {
+        return 0;
+    }
+}
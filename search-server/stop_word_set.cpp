@@ -0,0 +1,85 @@
+#include "stop_word_set.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+// Среднее число слов в корзине; больше - меньше зёрен, но дольше подбор
+const size_t WORDS_PER_BUCKET = 4;
+
+} // namespace
+
+StopWordSet::StopWordSet(const std::set<std::string, std::less<>>& words) {
+    if (words.empty()) {
+        return;
+    }
+
+    const std::vector<std::string_view> keys(words.begin(), words.end());
+    for (const std::string_view key : keys) {
+        length_mask_ |= uint64_t(1) << std::min<size_t>(key.size(), 63);
+    }
+
+    const size_t bucket_count = (keys.size() + WORDS_PER_BUCKET - 1) / WORDS_PER_BUCKET;
+    std::vector<std::vector<size_t>> buckets(bucket_count);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        buckets[Hash(keys[i], 0) % bucket_count].push_back(i);
+    }
+    // Большие корзины раскладываются первыми, пока свободных ячеек много
+    std::vector<size_t> order(bucket_count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&buckets](size_t lhs, size_t rhs) {
+        return buckets[lhs].size() > buckets[rhs].size();
+    });
+
+    std::vector<size_t> slot_keys(keys.size(), keys.size());
+    seeds_.assign(bucket_count, 0);
+    std::vector<size_t> candidate_slots;
+    for (const size_t bucket : order) {
+        if (buckets[bucket].empty()) {
+            break;
+        }
+        // Зерно 0 занято под выбор корзины; для n слов в n ячеек подбор сходится быстро
+        for (uint32_t seed = 1;; ++seed) {
+            candidate_slots.clear();
+            bool is_free = true;
+            for (const size_t key : buckets[bucket]) {
+                const size_t slot = Hash(keys[key], seed) % keys.size();
+                if (slot_keys[slot] != keys.size()
+                    || std::find(candidate_slots.begin(), candidate_slots.end(), slot) != candidate_slots.end()) {
+                    is_free = false;
+                    break;
+                }
+                candidate_slots.push_back(slot);
+            }
+            if (is_free) {
+                seeds_[bucket] = seed;
+                for (size_t i = 0; i < candidate_slots.size(); ++i) {
+                    slot_keys[candidate_slots[i]] = buckets[bucket][i];
+                }
+                break;
+            }
+        }
+    }
+
+    slots_.resize(keys.size());
+    for (size_t slot = 0; slot < keys.size(); ++slot) {
+        const std::string_view key = keys[slot_keys[slot]];
+        slots_[slot] = {static_cast<uint32_t>(text_.size()), static_cast<uint32_t>(key.size())};
+        text_.append(key);
+    }
+}
+
+uint64_t StopWordSet::Hash(std::string_view word, uint32_t seed) {
+    // FNV-1a с зерном и финальным перемешиванием splitmix64
+    uint64_t hash = 0xcbf29ce484222325ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+    for (const char c : word) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+    }
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
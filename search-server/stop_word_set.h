@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Неизменяемое множество стоп-слов на минимальной совершенной хеш-функции
+// (hash and displace): слово сначала попадает в корзину, а зерно корзины,
+// подобранное при построении, разводит её слова по своим ячейкам без коллизий.
+// Проверка - два хеша и одно сравнение строк; слова неподходящей длины
+// отсеиваются по маске длин без хеширования.
+class StopWordSet {
+public:
+    StopWordSet() = default;
+
+    explicit StopWordSet(const std::set<std::string, std::less<>>& words);
+
+    bool Contains(std::string_view word) const {
+        if (slots_.empty() || !HasLength(word.size())) {
+            return false;
+        }
+        const uint64_t hash = Hash(word, 0);
+        const uint32_t seed = seeds_[hash % seeds_.size()];
+        const Slot& slot = slots_[Hash(word, seed) % slots_.size()];
+        return word == std::string_view(text_.data() + slot.offset, slot.size);
+    }
+
+    size_t size() const {
+        return slots_.size();
+    }
+
+    bool empty() const {
+        return slots_.empty();
+    }
+
+private:
+    struct Slot {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+    };
+
+    std::string text_;
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> seeds_;
+    // Бит i - есть слово длины i; бит 63 - есть слова длиннее 62
+    uint64_t length_mask_ = 0;
+
+    bool HasLength(size_t length) const {
+        return (length_mask_ >> std::min<size_t>(length, 63)) & 1;
+    }
+
+    static uint64_t Hash(std::string_view word, uint32_t seed);
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <set>
@@ -8,6 +9,29 @@
 
 #include "document.h"
 
+// Вызывает action для каждого слова текста, не собирая их в вектор
+template <typename Action>
+void ForEachWord(std::string_view text, Action action) {
+    size_t begin = text.find_first_not_of(' ');
+    while (begin != std::string_view::npos) {
+        const size_t end = std::min(text.find(' ', begin), text.size());
+        action(text.substr(begin, end - begin));
+        begin = text.find_first_not_of(' ', end);
+    }
+}
+
+// Вызывает action для каждой полной строки буфера (без '\n');
+// возвращает число обработанных байт - хвост без '\n' остаётся непрочитанным
+template <typename Action>
+size_t ForEachLine(std::string_view buffer, Action action) {
+    size_t begin = 0;
+    for (size_t end = buffer.find('\n'); end != std::string_view::npos; end = buffer.find('\n', begin)) {
+        action(buffer.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return begin;
+}
+
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
 template <typename StringContainer>
@@ -0,0 +1,17 @@
+#include "term_arena.h"
+
+#include <algorithm>
+
+std::string_view TermArena::Store(std::string_view word) {
+    if (blocks_.empty() || blocks_.back().capacity() - blocks_.back().size() < word.size()) {
+        // Слово длиннее блока получает собственный блок точно по размеру
+        Block block(blocks_.get_allocator());
+        block.reserve(std::max(BLOCK_SIZE, word.size()));
+        blocks_.push_back(std::move(block));
+    }
+
+    Block& block = blocks_.back();
+    const size_t offset = block.size();
+    block.insert(block.end(), word.begin(), word.end());
+    return {block.data() + offset, word.size()};
+}
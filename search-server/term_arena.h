@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include "memory_stats.h"
+
+// Хранилище текста слов словаря: слова дописываются подряд в крупные блоки,
+// без отдельного узла и выделения памяти на каждое слово. Блоки не перевыделяются,
+// поэтому string_view на сохранённые слова остаются валидными, пока жива арена.
+// Поиск по словам здесь не нужен - уже сохранённые слова находятся в инвертированном индексе.
+class TermArena {
+public:
+    explicit TermArena(MemoryCounter& counter)
+        : blocks_(Blocks::allocator_type(counter))
+    {}
+
+    std::string_view Store(std::string_view word);
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    using Block = std::vector<char, CountingAllocator<char>>;
+    using Blocks = std::vector<Block, CountingAllocator<Block>>;
+
+    Blocks blocks_;
+};
@@ -0,0 +1,56 @@
+#include "text_analyzer.h"
+
+#include <string_view>
+
+size_t Utf8Lowercase::Apply(char* token, size_t size) {
+    auto* bytes = reinterpret_cast<unsigned char*>(token);
+    for (size_t i = 0; i < size; ++i) {
+        const unsigned char lead = bytes[i];
+        if (lead < 0x80) {
+            token[i] = AsciiLowercase::Map(token[i]);
+            continue;
+        }
+        if (i + 1 == size) {
+            break;
+        }
+        unsigned char& next = bytes[i + 1];
+        if (lead == 0xC3 && next >= 0x80 && next <= 0x9E && next != 0x97) {
+            // À-Þ -> à-þ, кроме знака умножения
+            next += 0x20;
+        } else if (lead == 0xD0 && next >= 0x90 && next <= 0x9F) {
+            // А-П -> а-п
+            next += 0x20;
+        } else if (lead == 0xD0 && next >= 0xA0 && next <= 0xAF) {
+            // Р-Я -> р-я
+            bytes[i] = 0xD1;
+            next -= 0x20;
+        } else if (lead == 0xD0 && next >= 0x80 && next <= 0x8F) {
+            // Ѐ-Џ (в том числе Ё) -> ѐ-џ
+            bytes[i] = 0xD1;
+            next += 0x10;
+        }
+        if (lead >= 0xC0) {
+            ++i;
+        }
+    }
+    return size;
+}
+
+size_t LightStemmer::Apply(char* token, size_t size) {
+    const std::string_view word(token, size);
+    const auto ends_with = [word](std::string_view suffix) {
+        return word.size() >= suffix.size() && word.substr(word.size() - suffix.size()) == suffix;
+    };
+
+    if (size > 3 && ends_with("ies") && !ends_with("eies") && !ends_with("aies")) {
+        token[size - 3] = 'y';
+        return size - 2;
+    }
+    if (size > 2 && ends_with("es") && !ends_with("aes") && !ends_with("ees") && !ends_with("oes")) {
+        return size - 1;
+    }
+    if (size > 1 && ends_with("s") && !ends_with("us") && !ends_with("ss")) {
+        return size - 1;
+    }
+    return size;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+// Нормализация слов перед индексацией и поиском. Анализатор собирается
+// из стадий на этапе компиляции:
+//     TextAnalyzer<Utf8Lowercase, StripPunctuation, LightStemmer>::Analyze
+// Стадии работают на месте и не удлиняют слово, поэтому документ нормализуется
+// прямо в сохранённой копии текста, а запрос - в одном буфере, без выделения
+// памяти на слово.
+//
+// Символьные стадии (CharStageTag) отображают один байт: static char Map(char),
+// '\0' - выбросить байт. Все символьные стадии сливаются в один проход по слову
+// и выполняются до стадий слова (TokenStageTag):
+//     static size_t Apply(char* token, size_t size) - возвращает новую длину.
+struct CharStageTag {};
+struct TokenStageTag {};
+
+template <typename T>
+inline constexpr bool IS_CHAR_STAGE_V = std::is_base_of_v<CharStageTag, T>;
+
+template <typename T>
+inline constexpr bool IS_TOKEN_STAGE_V = std::is_base_of_v<TokenStageTag, T>;
+
+// Указатель на Analyze конкретного анализатора; nullptr - слова не меняются
+using AnalyzerFunction = size_t (*)(char* token, size_t size);
+
+struct AsciiLowercase : CharStageTag {
+    static char Map(char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+};
+
+// Выбрасывает знаки препинания ASCII: "city," и "city" - одно слово
+struct StripPunctuation : CharStageTag {
+    static char Map(char c) {
+        const bool is_punctuation = (c >= '!' && c <= '/') || (c >= ':' && c <= '@')
+                                    || (c >= '[' && c <= '`') || (c >= '{' && c <= '~');
+        return is_punctuation ? '\0' : c;
+    }
+};
+
+// ASCII, Latin-1 Supplement и основная кириллица; длина в байтах при этом не меняется
+struct Utf8Lowercase : TokenStageTag {
+    static size_t Apply(char* token, size_t size);
+};
+
+// S-стеммер Хармана для английского: "ponies" -> "pony", "cats" -> "cat",
+// "bus" и "glass" не меняются
+struct LightStemmer : TokenStageTag {
+    static size_t Apply(char* token, size_t size);
+};
+
+template <typename... Stages>
+struct TextAnalyzer {
+    static_assert(((IS_CHAR_STAGE_V<Stages> || IS_TOKEN_STAGE_V<Stages>) && ...),
+                  "every stage must derive from CharStageTag or TokenStageTag");
+
+    static size_t Analyze(char* token, size_t size) {
+        if constexpr ((IS_CHAR_STAGE_V<Stages> || ...)) {
+            size_t kept = 0;
+            for (size_t i = 0; i < size; ++i) {
+                char c = token[i];
+                if ((MapChar<Stages>(c) && ...)) {
+                    token[kept++] = c;
+                }
+            }
+            size = kept;
+        }
+        ((size = ApplyToken<Stages>(token, size)), ...);
+        return size;
+    }
+
+private:
+    template <typename Stage>
+    static bool MapChar(char& c) {
+        if constexpr (IS_CHAR_STAGE_V<Stage>) {
+            c = Stage::Map(c);
+            return c != '\0';
+        } else {
+            return true;
+        }
+    }
+
+    template <typename Stage>
+    static size_t ApplyToken(char* token, size_t size) {
+        if constexpr (IS_TOKEN_STAGE_V<Stage>) {
+            return Stage::Apply(token, size);
+        } else {
+            return size;
+        }
+    }
+};
+
+using DefaultTextAnalyzer = TextAnalyzer<Utf8Lowercase, StripPunctuation, LightStemmer>;